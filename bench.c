@@ -0,0 +1,983 @@
+/*
+    bench.c times wcmenu.h without a screen, by driving menus through
+    WC_menu_begin/WC_menu_step/WC_menu_render and throwing the frames away,
+    and through WC_menu on the headless recorder.  bench sweep runs only
+    the sweep of item counts, disabled items, widths and footers, and
+    bench queue only the threads streaming into a menu.  It exits 1 if a
+    bench finds the menu got something wrong.
+*/
+#include "wcmenu.h"
+#include <stdio.h>
+#if !(defined(WIN32) || defined(_WIN32) || defined(__WIN32))
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/* most key presses, and most time, each measurement averages over */
+#define BENCH_KEYS              20000
+#define BENCH_TIME              (WC_BILLION/4)
+
+/* set when a bench finds the menu got something wrong */
+int gBenchWrong = 0;
+
+/* a callback that changes nothing, so ENTER costs only what the menu does around it */
+int bench_nothing(MenuItems *menuItems, int selectedItem)
+{
+    return 0;
+}
+
+/* drawBatchFunction that throws the frame away */
+void bench_draw(MenuItems *menuItems, WC_menuSpan *spans, int numSpans)
+{
+}
+
+/* inputFunction, never called since the bench steps the menu itself */
+int bench_input(void)
+{
+    return WC_INPUT_KEY_ESCAPE;
+}
+
+/* fill in a numItems menu, with counts given or left to the 0 terminators */
+void bench_menu(MenuItems *menuItems, char **items, int *states, cbf_ptr *callbacks, int numItems, int explicitCounts)
+{
+    int i;
+
+    for(i=0; i<numItems; i++)
+    {
+        items[i] = "Bench menu item";
+        states[i] = WC_ENABLED;
+        callbacks[i] = bench_nothing;
+    }
+    items[numItems] = 0;
+    states[numItems] = 0;
+    callbacks[numItems] = 0;
+
+    WC_menuInit(menuItems);
+    menuItems->inputFunction = bench_input;
+    menuItems->drawBatchFunction = bench_draw;
+    menuItems->sy = 50;
+    menuItems->sx = 80;
+    menuItems->items = items;
+    menuItems->states = states;
+    menuItems->callbacks = callbacks;
+    menuItems->title = "Bench";
+    if(explicitCounts)
+        menuItems->numItems = menuItems->numStates = menuItems->numCallbacks = numItems;
+}
+
+/* average ns for stepping key and rendering the frame that follows */
+double bench_keys(MenuItems *menuItems, int key)
+{
+    WC_menuState state;
+    WC_time start, now;
+    int i;
+
+    if(WC_menu_begin(menuItems, &state))
+        return -1.0;
+
+    now = start = WC_menu_now();
+    for(i=0; i<BENCH_KEYS && now - start < BENCH_TIME; i++)
+    {
+        WC_menu_step(&state, key, start);
+        WC_menu_render(&state);
+        now = WC_menu_now();
+    }
+
+    WC_menu_end(&state);
+
+    return (double)(now - start) / i;
+}
+
+/* per-keystroke latency as the item count grows, with and without explicit counts */
+void bench_item_counts(void)
+{
+    static const int counts[] = {10, 1000, 10000, 200000, 1000000};
+    int c, explicitCounts;
+
+    printf("keystroke latency (ns per step+render)\n");
+    printf("%10s %10s %12s %12s\n", "items", "counts", "DOWN", "ENTER");
+    for(c=0; c<(int)(sizeof(counts)/sizeof(*counts)); c++)
+    {
+        int numItems = counts[c];
+        char **items = (char**)malloc((numItems+1)*sizeof(char*));
+        int *states = (int*)malloc((numItems+1)*sizeof(int));
+        cbf_ptr *callbacks = (cbf_ptr*)malloc((numItems+1)*sizeof(cbf_ptr));
+
+        for(explicitCounts=0; explicitCounts<2; explicitCounts++)
+        {
+            MenuItems menuItems;
+            double down, enter;
+
+            bench_menu(&menuItems, items, states, callbacks, numItems, explicitCounts);
+            down = bench_keys(&menuItems, WC_INPUT_KEY_DOWN);
+            bench_menu(&menuItems, items, states, callbacks, numItems, explicitCounts);
+            enter = bench_keys(&menuItems, WC_INPUT_KEY_ENTER);
+            printf("%10d %10s %12.0f %12.0f\n", numItems, explicitCounts ? "numItems" : "scanned", down, enter);
+        }
+
+        free(items);
+        free(states);
+        free(callbacks);
+    }
+}
+
+/* DOWN and PAGE_DOWN latency when most items are disabled, in long runs */
+void bench_disabled(void)
+{
+    static const int percents[] = {0, 50, 95, 99};
+    int numItems = 1000000, p, i;
+    char **items = (char**)malloc((numItems+1)*sizeof(char*));
+    int *states = (int*)malloc((numItems+1)*sizeof(int));
+    cbf_ptr *callbacks = (cbf_ptr*)malloc((numItems+1)*sizeof(cbf_ptr));
+
+    printf("\nDOWN and PAGE_DOWN latency with disabled runs, %d items\n", numItems);
+    printf("%10s %12s %12s\n", "disabled", "DOWN", "PAGE_DOWN");
+    for(p=0; p<(int)(sizeof(percents)/sizeof(*percents)); p++)
+    {
+        MenuItems menuItems;
+        double down;
+
+        bench_menu(&menuItems, items, states, callbacks, numItems, 1);
+        /* in every 1000 items, the first percents[p]*10 are disabled */
+        for(i=0; i<numItems; i++)
+            states[i] = i % 1000 < percents[p] * 10 ? WC_DISABLED : WC_ENABLED;
+        down = bench_keys(&menuItems, WC_INPUT_KEY_DOWN);
+        bench_menu(&menuItems, items, states, callbacks, numItems, 1);
+        for(i=0; i<numItems; i++)
+            states[i] = i % 1000 < percents[p] * 10 ? WC_DISABLED : WC_ENABLED;
+        printf("%9d%% %12.0f %12.0f\n", percents[p], down, bench_keys(&menuItems, WC_INPUT_KEY_PAGE_DOWN));
+    }
+
+    free(items);
+    free(states);
+    free(callbacks);
+}
+
+/* how long WC_menu_begin takes to size a menu to its widest item */
+void bench_startup(void)
+{
+    static const int counts[] = {1000, 100000, 1000000, 10000000};
+    static char *labels[] = {"Short", "A somewhat longer label", "The longest label of all the ones here"};
+    int c, i;
+
+    printf("\nWC_menu_begin with width WC_NONE\n");
+    printf("%10s %12s\n", "items", "ms");
+    for(c=0; c<(int)(sizeof(counts)/sizeof(*counts)); c++)
+    {
+        int numItems = counts[c];
+        char **items = (char**)malloc((numItems+1)*sizeof(char*));
+        MenuItems menuItems;
+        WC_menuState state;
+        WC_time start;
+
+        for(i=0; i<numItems; i++)
+            items[i] = labels[i % 3];
+        items[numItems] = 0;
+
+        WC_menuInit(&menuItems);
+        menuItems.drawBatchFunction = bench_draw;
+        menuItems.sy = 50;
+        menuItems.sx = 80;
+        menuItems.items = items;
+        menuItems.numItems = numItems;
+
+        start = WC_menu_now();
+        WC_menu_begin(&menuItems, &state);
+        printf("%10d %12.2f\n", numItems, (WC_menu_now() - start) / 1E6);
+        WC_menu_end(&state);
+        free(items);
+    }
+}
+
+/* type-ahead filtering: the first key sorts the items, later ones narrow what the last one found */
+void bench_filter(void)
+{
+    static const int counts[] = {10000, 200000, 1000000};
+    static const char *typed = "web-1";
+    int c, i;
+
+    printf("\nprefix filter, typing \"%s\" then backspacing it (us per key)\n", typed);
+    printf("%10s %12s %12s %12s\n", "items", "first key", "next keys", "backspace");
+    for(c=0; c<(int)(sizeof(counts)/sizeof(*counts)); c++)
+    {
+        int numItems = counts[c], length = (int)strlen(typed);
+        char **items = (char**)malloc((numItems+1)*sizeof(char*));
+        char *text = (char*)malloc(numItems*16);
+        MenuItems menuItems;
+        WC_menuState state;
+        WC_time start, first, next;
+
+        /* host names with a handful of roles */
+        for(i=0; i<numItems; i++)
+        {
+            static const char *roles[] = {"web", "db", "cache", "queue", "mail", "dns", "log", "auth"};
+            items[i] = &text[i*16];
+            sprintf(items[i], "%s-%d", roles[i % 8], i / 8);
+        }
+        items[numItems] = 0;
+
+        WC_menuInit(&menuItems);
+        menuItems.drawBatchFunction = bench_draw;
+        menuItems.sy = 50;
+        menuItems.sx = 80;
+        menuItems.width = 20;
+        menuItems.items = items;
+        menuItems.numItems = numItems;
+        menuItems.filterMode = WC_FILTER_PREFIX;
+        WC_menu_begin(&menuItems, &state);
+
+        start = WC_menu_now();
+        WC_menu_step(&state, WC_INPUT_CHAR(typed[0]), start);
+        WC_menu_render(&state);
+        first = WC_menu_now();
+        for(i=1; i<length; i++)
+        {
+            WC_menu_step(&state, WC_INPUT_CHAR(typed[i]), start);
+            WC_menu_render(&state);
+        }
+        next = WC_menu_now();
+        for(i=0; i<length; i++)
+        {
+            WC_menu_step(&state, WC_INPUT_KEY_BACKSPACE, start);
+            WC_menu_render(&state);
+        }
+        printf("%10d %12.1f %12.1f %12.1f\n", numItems, (first - start) / 1E3,
+               (next - first) / 1E3 / (length - 1), (WC_menu_now() - next) / 1E3 / length);
+
+        WC_menu_end(&state);
+        free(items);
+        free(text);
+    }
+}
+
+/* fuzzy ranking: how soon the first matches show, and how long ranking everything takes */
+void bench_fuzzy(void)
+{
+    static const int counts[] = {10000, 200000, 1000000};
+    static const char *typed = "wb12";
+    int c, i, k;
+
+    printf("\nfuzzy filter, typing \"%s\" (us per key, %d thread%s)\n", typed, WC_MENU_WORKERS, WC_MENU_WORKERS > 1 ? "s" : "");
+    printf("%10s %12s %12s\n", "items", "first step", "all ranked");
+    for(c=0; c<(int)(sizeof(counts)/sizeof(*counts)); c++)
+    {
+        int numItems = counts[c], length = (int)strlen(typed);
+        char **items = (char**)malloc((numItems+1)*sizeof(char*));
+        char *text = (char*)malloc(numItems*16);
+        double firstStep = 0, allRanked = 0;
+        MenuItems menuItems;
+        WC_menuState state;
+
+        for(i=0; i<numItems; i++)
+        {
+            static const char *roles[] = {"web", "db", "cache", "queue", "mail", "dns", "log", "auth"};
+            items[i] = &text[i*16];
+            sprintf(items[i], "%s-%d", roles[i % 8], i / 8);
+        }
+        items[numItems] = 0;
+
+        WC_menuInit(&menuItems);
+        menuItems.drawBatchFunction = bench_draw;
+        menuItems.sy = 50;
+        menuItems.sx = 80;
+        menuItems.width = 20;
+        menuItems.items = items;
+        menuItems.numItems = numItems;
+        menuItems.filterMode = WC_FILTER_FUZZY;
+        WC_menu_begin(&menuItems, &state);
+
+        /* each key gets one step (and a frame) then steps until the ranking's done */
+        for(k=0; k<length; k++)
+        {
+            WC_time start = WC_menu_now();
+
+            WC_menu_step(&state, WC_INPUT_CHAR(typed[k]), start);
+            WC_menu_render(&state);
+            firstStep += WC_menu_now() - start;
+            while(state.rankNext < state.numMenuItems)
+            {
+                WC_menu_step(&state, 0, start);
+                WC_menu_render(&state);
+            }
+            allRanked += WC_menu_now() - start;
+        }
+        printf("%10d %12.1f %12.1f\n", numItems, firstStep / 1E3 / length, allRanked / 1E3 / length);
+
+        WC_menu_end(&state);
+        free(items);
+        free(text);
+    }
+}
+
+/* mallocFunction etc. that count calls, so the bench can show how few there are */
+static long bench_allocs;
+
+void *bench_malloc(void *context, size_t size)
+{
+    bench_allocs++;
+    return malloc(size);
+}
+
+void *bench_realloc(void *context, void *ptr, size_t size)
+{
+    bench_allocs++;
+    return realloc(ptr, size);
+}
+
+void bench_free(void *context, void *ptr)
+{
+    bench_allocs++;
+    free(ptr);
+}
+
+/* a callback's first edit, copying the arrays, a lot of edits and appends, and freeing it all */
+void bench_ownership(void)
+{
+    static const int counts[] = {1000, 100000, 1000000};
+    int c, i;
+
+    printf("\nfirst WC_menu_set_item, WC_menu_own_arrays, %d edits and appends, WC_menu_cleanup (ms, allocator calls)\n", 10000);
+    printf("%10s %10s %10s %10s %10s %10s\n", "items", "first", "take", "edit", "cleanup", "calls");
+    for(c=0; c<(int)(sizeof(counts)/sizeof(*counts)); c++)
+    {
+        int numItems = counts[c];
+        char **items = (char**)malloc((numItems+1)*sizeof(char*));
+        int *states = (int*)malloc((numItems+1)*sizeof(int));
+        cbf_ptr *callbacks = (cbf_ptr*)malloc((numItems+1)*sizeof(cbf_ptr));
+        MenuItems menuItems;
+        WC_time start, first, took, edited;
+        char buffer[32];
+
+        bench_menu(&menuItems, items, states, callbacks, numItems, 1);
+        menuItems.mallocFunction = bench_malloc;
+        menuItems.reallocFunction = bench_realloc;
+        menuItems.freeFunction = bench_free;
+        bench_allocs = 0;
+
+        /* what demo.c's change, increment and append callbacks do */
+        start = WC_menu_now();
+        WC_menu_set_item(&menuItems, 0, "1");
+        first = WC_menu_now();
+        WC_menu_own_arrays(&menuItems);
+        took = WC_menu_now();
+        for(i=0; i<10000; i++)
+        {
+            int length = numItems + i;
+
+            sprintf(buffer, "Value: %d", i);
+            WC_menu_set_item(&menuItems, i % numItems, buffer);
+            sprintf(buffer, "New Item %d", length);
+            WC_menu_insert_item(&menuItems, length, buffer, WC_ENABLED, WC_NO_CALLBACK);
+        }
+        edited = WC_menu_now();
+        WC_menu_cleanup(&menuItems);
+        printf("%10d %10.2f %10.2f %10.2f %10.2f %10ld\n", numItems, (first - start) / 1E6, (took - first) / 1E6,
+               (edited - took) / 1E6, (WC_menu_now() - edited) / 1E6, bench_allocs);
+
+        free(items);
+        free(states);
+        free(callbacks);
+    }
+}
+
+/* inserting and removing items in a running menu that's as wide as its longest item */
+void bench_mutation(void)
+{
+    static const int counts[] = {1000, 100000, 1000000};
+    static char *bulk[10000];
+    int c, i;
+
+    for(i=0; i<10000; i++)
+        bulk[i] = "A bulk inserted item";
+
+    printf("\nediting a running auto-width menu (us per item, ms for one bulk insert of 10000)\n");
+    printf("%10s %10s %10s %10s %10s\n", "items", "insert", "remove", "longest", "bulk");
+    for(c=0; c<(int)(sizeof(counts)/sizeof(*counts)); c++)
+    {
+        int numItems = counts[c], edits = 1000;
+        char **items = (char**)malloc((numItems+1)*sizeof(char*));
+        int *states = (int*)malloc((numItems+1)*sizeof(int));
+        cbf_ptr *callbacks = (cbf_ptr*)malloc((numItems+1)*sizeof(cbf_ptr));
+        MenuItems menuItems;
+        WC_menuState state;
+        WC_time start, inserted, removed, longest;
+
+        bench_menu(&menuItems, items, states, callbacks, numItems, 1);
+        /* one item longer than the rest, so removing it narrows the menu */
+        items[numItems / 2] = "The one item that's longer than all the others";
+        WC_menu_begin(&menuItems, &state);
+        WC_menu_render(&state);
+
+        start = WC_menu_now();
+        for(i=0; i<edits; i++)
+            WC_menu_insert_item(&menuItems, (i * 7919) % menuItems.numItems, "Inserted item", WC_ENABLED, bench_nothing);
+        inserted = WC_menu_now();
+        for(i=0; i<edits; i++)
+            WC_menu_remove_item(&menuItems, (i * 7919) % (menuItems.numItems - 1) + 1);
+        removed = WC_menu_now();
+        for(i=0; i<menuItems.numItems && strlen(menuItems.items[i]) < 30; i++)
+            ;
+        WC_menu_remove_item(&menuItems, i);
+        longest = WC_menu_now();
+        WC_menu_insert_items(&menuItems, 0, bulk, 0, 0, 10000);
+        printf("%10d %10.1f %10.1f %10.1f %10.2f\n", numItems, (inserted - start) / 1E3 / edits,
+               (removed - inserted) / 1E3 / edits, (longest - removed) / 1E3, (WC_menu_now() - longest) / 1E6);
+
+        WC_menu_end(&state);
+        WC_menu_cleanup(&menuItems);
+        free(items);
+        free(states);
+        free(callbacks);
+    }
+}
+
+/* bytes in a menu's arena */
+size_t bench_arena_bytes(MenuItems *menuItems)
+{
+    WC_menuArena *chunk;
+    size_t bytes = 0;
+
+    for(chunk = menuItems->arena; chunk; chunk = chunk->next)
+        bytes += chunk->used;
+
+    return bytes;
+}
+
+/* building a menu of a few labels repeated, copying each or sharing them through an intern pool */
+void bench_intern(void)
+{
+    static char *labels[] = {"Enabled", "Disabled", "Back", "web server", "database", "cache", "1", "0"};
+    int numItems = 1000000, shared, i;
+    char **items = (char**)malloc(numItems*sizeof(char*));
+
+    for(i=0; i<numItems; i++)
+        items[i] = labels[i % 8];
+
+    printf("\ninserting %d items of 8 labels (ms, MB of text and arrays)\n", numItems);
+    printf("%10s %10s %10s %10s %10s\n", "text", "insert", "MB", "hit rate", "MB saved");
+    for(shared=0; shared<2; shared++)
+    {
+        static char *none[] = {0};
+        MenuItems menuItems;
+        WC_menuIntern pool;
+        WC_time start;
+        double insert;
+
+        WC_menuInit(&menuItems);
+        WC_menu_intern_init(&pool);
+        menuItems.items = none;
+        if(shared)
+            menuItems.intern = &pool;
+
+        start = WC_menu_now();
+        WC_menu_insert_items(&menuItems, 0, items, 0, 0, numItems);
+        insert = (WC_menu_now() - start) / 1E6;
+        printf("%10s %10.2f %10.2f %9.1f%% %10.2f\n", shared ? "interned" : "copied", insert,
+               (bench_arena_bytes(&menuItems) + pool.bytes) / 1E6,
+               pool.lookups ? 100.0 * pool.hits / pool.lookups : 0.0, pool.bytesSaved / 1E6);
+
+        WC_menu_cleanup(&menuItems);
+        WC_menu_intern_free(&pool);
+    }
+
+    free(items);
+}
+
+/* getItem for a menu of live values, counting how often it's asked */
+static long bench_fetches;
+
+int bench_value_item(void *userData, int index, char *buffer, int capacity)
+{
+    bench_fetches++;
+    return snprintf(buffer, capacity, "Value %d: %d", index, ((int*)userData)[index]);
+}
+
+/* a callback that bumps its item's value and says so */
+int bench_value_enter(MenuItems *menuItems, int selectedItem)
+{
+    ((int*)menuItems->userData_ptr)[selectedItem]++;
+    WC_menu_invalidate(menuItems, selectedItem, selectedItem);
+    return 0;
+}
+
+/* ENTER on "live value" menus: a callback that changes its own row, and one that changes nothing while filtered */
+void bench_live(void)
+{
+    int numItems = 1000000, i;
+    int *values = (int*)calloc(numItems, sizeof(int));
+    char **items = (char**)malloc((numItems+1)*sizeof(char*));
+    char *text = (char*)malloc(numItems*16);
+    int *states = (int*)malloc((numItems+1)*sizeof(int));
+    cbf_ptr *callbacks = (cbf_ptr*)malloc((numItems+1)*sizeof(cbf_ptr));
+    MenuItems menuItems;
+    WC_menuState state;
+    WC_time start;
+
+    printf("\nENTER on a live value, %d items (us per step+render, getItem calls per ENTER)\n", numItems);
+    printf("%24s %10s %10s\n", "menu", "ENTER", "fetches");
+
+    for(i=0; i<numItems; i++)
+        callbacks[i] = bench_value_enter;
+    WC_menuInit(&menuItems);
+    menuItems.drawBatchFunction = bench_draw;
+    menuItems.sy = 50;
+    menuItems.sx = 80;
+    menuItems.getItem = bench_value_item;
+    menuItems.userData_ptr = values;
+    menuItems.numItems = menuItems.numCallbacks = numItems;
+    menuItems.callbacks = callbacks;
+    WC_menu_begin(&menuItems, &state);
+    WC_menu_render(&state);
+    bench_fetches = 0;
+    start = WC_menu_now();
+    for(i=0; i<BENCH_KEYS; i++)
+    {
+        WC_menu_step(&state, WC_INPUT_KEY_ENTER, start);
+        WC_menu_render(&state);
+    }
+    printf("%24s %10.2f %10.1f\n", "getItem, 1 row changes", (WC_menu_now() - start) / 1E3 / BENCH_KEYS, (double)bench_fetches / BENCH_KEYS);
+    WC_menu_end(&state);
+
+    /* the filter's index is there to be kept up to date, but nothing changes */
+    bench_menu(&menuItems, items, states, callbacks, numItems, 1);
+    for(i=0; i<numItems; i++)
+    {
+        items[i] = &text[i*16];
+        sprintf(items[i], "web-%d", i);
+    }
+    menuItems.filterMode = WC_FILTER_PREFIX;
+    WC_menu_begin(&menuItems, &state);
+    WC_menu_step(&state, WC_INPUT_CHAR('w'), WC_menu_now());
+    start = WC_menu_now();
+    for(i=0; i<BENCH_KEYS/10; i++)
+    {
+        WC_menu_step(&state, WC_INPUT_KEY_ENTER, start);
+        WC_menu_render(&state);
+    }
+    printf("%24s %10.2f %10s\n", "filtered, nothing", (WC_menu_now() - start) / 1E3 / (BENCH_KEYS/10), "-");
+    WC_menu_end(&state);
+
+    free(values);
+    free(items);
+    free(text);
+    free(states);
+    free(callbacks);
+}
+
+/* key repeat: bursts of keys coming in between frames, taken one a frame or all at once */
+#define BENCH_BURSTS            2000
+
+typedef struct tagBenchRepeat
+{
+        int burst;              /* keys in a burst */
+        int waiting;            /* keys of the burst not handed over yet */
+        int last;               /* 1 = the burst's last key has been handed over, so the next frame shows it */
+        int bursts;             /* bursts shown */
+        int frames;             /* frames drawn */
+        WC_time arrived;        /* when the burst came in */
+        WC_time total;          /* from bursts coming in to the frames showing their last keys */
+} BenchRepeat;
+
+BenchRepeat gBenchRepeat;
+char gBenchTerminal[64*1024];
+
+/* drawBatchFunction that encodes the frame as a terminal backend would, then drops it */
+void bench_terminal_draw(MenuItems *menuItems, WC_menuSpan *spans, int numSpans)
+{
+    int i, used = 0;
+
+    for(i=0; i<numSpans && used < (int)sizeof(gBenchTerminal) - 512; i++)
+    {
+        WC_menuSpan *span = &spans[i];
+
+        used += sprintf(&gBenchTerminal[used], "\x1b[%d;%dH\x1b[%dm%-*.*s", span->y + 1, span->x + 1, 30 + span->color, span->length, span->length, span->string);
+    }
+}
+
+/* showFunction: a frame's done, and if it shows a burst's last key, how long that took is known */
+void bench_repeat_show(void)
+{
+    gBenchRepeat.frames++;
+    if(gBenchRepeat.last)
+    {
+        gBenchRepeat.total += WC_menu_now() - gBenchRepeat.arrived;
+        gBenchRepeat.bursts++;
+        gBenchRepeat.last = 0;
+    }
+}
+
+/* inputFunction: the next key, a new burst coming in once the last has been shown */
+int bench_repeat_key(void)
+{
+    BenchRepeat *repeat = &gBenchRepeat;
+
+    if(!repeat->waiting)
+    {
+        if(repeat->bursts >= BENCH_BURSTS)
+            return WC_INPUT_KEY_ESCAPE;
+        repeat->waiting = repeat->burst;
+        repeat->arrived = WC_menu_now();
+    }
+    if(!--repeat->waiting)
+        repeat->last = 1;
+
+    return WC_INPUT_KEY_DOWN;
+}
+
+/* readEvents: all of the burst's keys */
+int bench_repeat_events(int *keys, int max)
+{
+    int numKeys = 0;
+
+    do
+    {
+        keys[numKeys++] = bench_repeat_key();
+    } while(numKeys < max && gBenchRepeat.waiting);
+
+    return numKeys;
+}
+
+/* us from a burst of burst DOWNs coming in to the frame showing the last of them, through WC_menu */
+double bench_repeat_run(MenuItems *menuItems, int burst, int batched, double *framesPerBurst)
+{
+    memset(&gBenchRepeat, 0, sizeof(gBenchRepeat));
+    gBenchRepeat.burst = burst;
+    menuItems->inputFunction = bench_repeat_key;
+    menuItems->readEvents = batched ? bench_repeat_events : 0;
+    WC_menu(menuItems);
+    *framesPerBurst = (double)gBenchRepeat.frames / WC_menu_max(1, gBenchRepeat.bursts);
+
+    return gBenchRepeat.total / 1E3 / WC_menu_max(1, gBenchRepeat.bursts);
+}
+
+/* navigation latency under key repeat (or a paste, or a remote terminal's batch), one key a frame against all at once */
+void bench_repeat(void)
+{
+    static const int bursts[] = {1, 2, 4, 16, 64};
+    int numItems = 10000, b;
+    char **items = (char**)malloc((numItems+1)*sizeof(char*));
+    int *states = (int*)malloc((numItems+1)*sizeof(int));
+    cbf_ptr *callbacks = (cbf_ptr*)malloc((numItems+1)*sizeof(cbf_ptr));
+
+    printf("\nkey repeat, %d items (us from a burst of DOWNs coming in to the frame showing the last, frames a burst)\n", numItems);
+    printf("%10s %14s %8s %14s %8s\n", "burst", "one a frame", "frames", "all at once", "frames");
+    for(b=0; b<(int)(sizeof(bursts)/sizeof(*bursts)); b++)
+    {
+        MenuItems menuItems;
+        double single, batched, singleFrames, batchedFrames;
+
+        bench_menu(&menuItems, items, states, callbacks, numItems, 1);
+        menuItems.drawBatchFunction = bench_terminal_draw;
+        menuItems.showFunction = bench_repeat_show;
+        menuItems.useBackBuffer = 1;
+        single = bench_repeat_run(&menuItems, bursts[b], 0, &singleFrames);
+        batched = bench_repeat_run(&menuItems, bursts[b], 1, &batchedFrames);
+        printf("%10d %14.2f %8.1f %14.2f %8.1f\n", bursts[b], single, singleFrames, batched, batchedFrames);
+    }
+
+    free(items);
+    free(states);
+    free(callbacks);
+}
+
+/* the keys each sweep run presses, a frame each: moving a line and a page at a time, jumping to the ends, and a frame with none */
+#define BENCH_SWEEP_KEYS        4000
+#define BENCH_SWEEP_ITEMS_MAX   10000000
+
+const int gBenchSweepPattern[] =
+{
+    WC_INPUT_KEY_DOWN, WC_INPUT_KEY_DOWN, WC_INPUT_KEY_DOWN, WC_INPUT_KEY_DOWN, WC_INPUT_KEY_DOWN,
+    WC_INPUT_KEY_DOWN, WC_INPUT_KEY_DOWN, WC_INPUT_KEY_DOWN, WC_INPUT_KEY_PAGE_DOWN, WC_INPUT_KEY_PAGE_DOWN,
+    WC_INPUT_KEY_UP, WC_INPUT_KEY_UP, WC_INPUT_KEY_UP, WC_INPUT_KEY_PAGE_UP, WC_INPUT_KEY_END,
+    WC_INPUT_KEY_UP, WC_INPUT_KEY_UP, WC_INPUT_KEY_HOME, WC_INPUT_KEY_DOWN, 0
+};
+int gBenchSweepScript[BENCH_SWEEP_KEYS];
+
+/* runs WC_menu through the script on the recorder and prints a row: time to the first frame, frames/s after it, spans and cells a frame, key to frame latency */
+void bench_sweep_run(const char *label, char **items, int *states, int numItems, int disabledPercent, int width, int footerLength)
+{
+    static const char phrase[] = "Type to narrow the list, arrows to move, ENTER to choose, ESC to leave.  ";
+    static char footer[4096];
+    char *terminator = items[numItems];
+    MenuItems menuItems;
+    WC_menuRecorder rec;
+    WC_time start, elapsed;
+    int i;
+
+    /* in every 100 items, the first disabledPercent are disabled */
+    items[numItems] = 0;
+    for(i=0; i<numItems; i++)
+        states[i] = i % 100 < disabledPercent ? WC_DISABLED : WC_ENABLED;
+    for(i=0; i<footerLength && i<(int)sizeof(footer)-1; i++)
+        footer[i] = phrase[i % (sizeof(phrase) - 1)];
+    footer[i] = 0;
+
+    WC_menuInit(&menuItems);
+    menuItems.sy = 50;
+    menuItems.sx = 80;
+    menuItems.items = items;
+    menuItems.states = states;
+    menuItems.numItems = menuItems.numStates = numItems;
+    menuItems.title = "Bench";
+    menuItems.footer = footerLength ? footer : 0;
+    menuItems.width = width;
+    menuItems.useBackBuffer = 1;
+    if(WC_menu_record_begin(&rec, &menuItems, gBenchSweepScript, BENCH_SWEEP_KEYS))
+        return;
+    WC_menu_record_use(&rec);
+
+    start = WC_menu_now();
+    WC_menu(&menuItems);
+    elapsed = WC_menu_now() - rec.firstFrame;
+
+    printf("%-18s %8.2f %10.0f %8.1f %8.1f %10.2f %10.2f\n", label, (rec.firstFrame - start) / 1E6,
+           (rec.frames - 1) / (elapsed / 1E9), (double)rec.spans / WC_menu_max(1, rec.frames), (double)rec.cells / WC_menu_max(1, rec.frames),
+           rec.latency / 1E3 / WC_menu_max(1, rec.keys), rec.latencyMax / 1E3);
+
+    WC_menu_record_end(&rec);
+    WC_menu_cleanup(&menuItems);
+    items[numItems] = terminator;
+}
+
+/* WC_menu end to end on the headless recorder, one thing changed at a time from 100000 items, none disabled, sized to fit and a 40 character footer */
+void bench_sweep(void)
+{
+    static const int counts[] = {10, 1000, 100000, 1000000, BENCH_SWEEP_ITEMS_MAX};
+    static const int percents[] = {0, 50, 90, 99};
+    static const int widths[] = {WC_NONE, 10, 40, 78};
+    static const int footers[] = {0, 40, 400, 4000};
+    static char *labels[] = {"Short", "A somewhat longer label", "The longest label of all the ones here, and then some more"};
+    char **items = (char**)malloc((BENCH_SWEEP_ITEMS_MAX+1)*sizeof(char*));
+    int *states = (int*)malloc((BENCH_SWEEP_ITEMS_MAX+1)*sizeof(int));
+    char label[32];
+    int i;
+
+    if(!items || !states)
+        return;
+    for(i=0; i<BENCH_SWEEP_ITEMS_MAX; i++)
+        items[i] = labels[i % 3];
+    items[BENCH_SWEEP_ITEMS_MAX] = 0;
+    for(i=0; i<BENCH_SWEEP_KEYS; i++)
+        gBenchSweepScript[i] = gBenchSweepPattern[i % (sizeof(gBenchSweepPattern) / sizeof(*gBenchSweepPattern))];
+
+    printf("\nWC_menu on the headless recorder, %d frames (ms to the first, frames/s, spans and cells drawn a frame, us from a key to its frame)\n", BENCH_SWEEP_KEYS);
+    printf("%-18s %8s %10s %8s %8s %10s %10s\n", "", "first", "frames/s", "spans", "cells", "latency", "max");
+    for(i=0; i<(int)(sizeof(counts)/sizeof(*counts)); i++)
+    {
+        sprintf(label, "%d items", counts[i]);
+        bench_sweep_run(label, items, states, counts[i], 0, WC_NONE, 40);
+    }
+    for(i=0; i<(int)(sizeof(percents)/sizeof(*percents)); i++)
+    {
+        sprintf(label, "%d%% disabled", percents[i]);
+        bench_sweep_run(label, items, states, 100000, percents[i], WC_NONE, 40);
+    }
+    for(i=0; i<(int)(sizeof(widths)/sizeof(*widths)); i++)
+    {
+        if(WC_NONE == widths[i])
+            sprintf(label, "width to fit");
+        else
+            sprintf(label, "width %d", widths[i]);
+        bench_sweep_run(label, items, states, 100000, 0, widths[i], 40);
+    }
+    for(i=0; i<(int)(sizeof(footers)/sizeof(*footers)); i++)
+    {
+        sprintf(label, "footer %d", footers[i]);
+        bench_sweep_run(label, items, states, 100000, 0, WC_NONE, footers[i]);
+    }
+
+    free(items);
+    free(states);
+}
+
+#if !(defined(WIN32) || defined(_WIN32) || defined(__WIN32))
+/* threads streaming events into a running menu */
+#define BENCH_PRODUCERS         4
+#define BENCH_EVENTS            250000  /* per producer */
+
+typedef struct tagBenchProducer
+{
+        pthread_t thread;
+        WC_menuQueue *queue;
+        int number;             /* which producer, and which "Slot" item it updates */
+        WC_time start;
+        WC_time interval;       /* between its events, 0 = as fast as it can */
+        long refused;           /* pushes refused because the queue was full */
+        char last[32];          /* the text it last gave its slot */
+        int lastState;          /* and the state */
+} BenchProducer;
+
+/* appends its own numbered items, every 8th event renaming its slot and every 16th toggling it */
+void *bench_producer(void *arg)
+{
+    BenchProducer *producer = (BenchProducer*)arg;
+    int i, numAppends = 0, type;
+    char text[32];
+
+    producer->lastState = WC_ENABLED;
+
+    for(i=0; i<BENCH_EVENTS; i++)
+    {
+        while(producer->interval && WC_menu_now() < producer->start + i * producer->interval)
+            sched_yield();
+
+        if(i % 16 == 15)
+        {
+            type = WC_EVENT_STATE;
+            producer->lastState = WC_DISABLED == producer->lastState ? WC_ENABLED : WC_DISABLED;
+        }
+        else if(i % 8 == 7)
+        {
+            type = WC_EVENT_UPDATE;
+            sprintf(producer->last, "Slot %d at %d", producer->number, i);
+            strcpy(text, producer->last);
+        }
+        else
+        {
+            type = WC_EVENT_APPEND;
+            sprintf(text, "Producer %d item %d", producer->number, numAppends++);
+        }
+        while(!WC_menu_queue_push(producer->queue, type, 1 + producer->number, text, WC_EVENT_STATE == type ? producer->lastState : WC_ENABLED))
+        {
+            producer->refused++;
+            sched_yield();
+        }
+    }
+
+    return 0;
+}
+
+/* one run: producers at rate events/s between them (0 = flat out) while the menu steps and renders */
+void bench_stream(const char *name, double rate)
+{
+    char *items[BENCH_PRODUCERS + 2];
+    int states[BENCH_PRODUCERS + 2];
+    char slots[BENCH_PRODUCERS][16];
+    int numAppends = BENCH_EVENTS - BENCH_EVENTS / 8, next[BENCH_PRODUCERS], i, errors = 0;
+    BenchProducer producers[BENCH_PRODUCERS];
+    MenuItems menuItems;
+    WC_menuQueue queue;
+    WC_menuState state;
+    WC_time start, frameStart, frameWorst = 0, elapsed;
+    long frames = 0, refused = 0, numEvents = (long)BENCH_PRODUCERS * BENCH_EVENTS;
+
+    /* a menu that starts as the producers' slots, and grows */
+    items[0] = "Scanning...";
+    for(i=0; i<BENCH_PRODUCERS; i++)
+    {
+        sprintf(slots[i], "Slot %d", i);
+        items[1 + i] = slots[i];
+    }
+    for(i=0; i<BENCH_PRODUCERS + 1; i++)
+        states[i] = WC_ENABLED;
+    items[BENCH_PRODUCERS + 1] = 0;
+    states[BENCH_PRODUCERS + 1] = 0;
+    WC_menuInit(&menuItems);
+    WC_menu_queue_init(&queue, &menuItems, 4096);
+    menuItems.inputFunction = bench_input;
+    menuItems.drawBatchFunction = bench_draw;
+    menuItems.sy = 50;
+    menuItems.sx = 80;
+    menuItems.items = items;
+    menuItems.states = states;
+    menuItems.numItems = menuItems.numStates = BENCH_PRODUCERS + 1;
+    menuItems.queue = &queue;
+    WC_menu_begin(&menuItems, &state);
+    WC_menu_render(&state);
+
+    start = WC_menu_now();
+    for(i=0; i<BENCH_PRODUCERS; i++)
+    {
+        producers[i].queue = &queue;
+        producers[i].number = i;
+        producers[i].start = start;
+        producers[i].interval = rate > 0 ? (WC_time)(BENCH_PRODUCERS * 1E9 / rate) : 0;
+        producers[i].refused = 0;
+        pthread_create(&producers[i].thread, NULL, bench_producer, &producers[i]);
+    }
+    /* the menu's thread does nothing but run the menu */
+    while(queue.taken < numEvents)
+    {
+        frameStart = WC_menu_now();
+        WC_menu_step(&state, 0, frameStart);
+        WC_menu_render(&state);
+        frames++;
+        frameWorst = WC_menu_max(frameWorst, WC_menu_now() - frameStart);
+        sched_yield();
+    }
+    elapsed = WC_menu_now() - start;
+    for(i=0; i<BENCH_PRODUCERS; i++)
+    {
+        pthread_join(producers[i].thread, NULL);
+        refused += producers[i].refused;
+    }
+
+    /* every event arrived, each producer's in the order it pushed them */
+    if(state.numMenuItems != 1 + BENCH_PRODUCERS + BENCH_PRODUCERS * numAppends)
+        errors++;
+    for(i=0; i<BENCH_PRODUCERS; i++)
+    {
+        next[i] = 0;
+        if(strcmp(menuItems.items[1 + i], producers[i].last) || menuItems.states[1 + i] != producers[i].lastState)
+            errors++;
+    }
+    for(i=1+BENCH_PRODUCERS; i<state.numMenuItems; i++)
+    {
+        int number, item;
+
+        if(2 != sscanf(menuItems.items[i], "Producer %d item %d", &number, &item) || item != next[number]++)
+            errors++;
+    }
+
+    printf("%10s %10ld %10.3f %10.2f %10ld %10.2f %10ld %10s\n", name, numEvents, elapsed / 1E9, numEvents / (elapsed / 1E3),
+           frames, frameWorst / 1E6, refused, errors ? "WRONG" : "ok");
+    if(errors)
+        gBenchWrong = 1;
+
+    WC_menu_end(&state);
+    WC_menu_cleanup(&menuItems);
+    WC_menu_queue_free(&queue);
+}
+
+/* producer threads pushing to a running menu's queue, paced at 1M events/s and flat out */
+void bench_queue(void)
+{
+    printf("\n%d threads streaming appends, renames and state changes into a running menu\n", BENCH_PRODUCERS);
+    printf("%10s %10s %10s %10s %10s %10s %10s %10s\n", "rate", "events", "seconds", "Mevents/s", "frames", "worst ms", "refused", "check");
+    bench_stream("1M/s", 1E6);
+    bench_stream("flat out", 0);
+}
+#endif
+
+int main(int argc, char **argv)
+{
+    if(argc > 1 && !strcmp(argv[1], "sweep"))
+    {
+        bench_sweep();
+        return 0;
+    }
+#if !(defined(WIN32) || defined(_WIN32) || defined(__WIN32))
+    if(argc > 1 && !strcmp(argv[1], "queue"))
+    {
+        bench_queue();
+        return gBenchWrong;
+    }
+#endif
+
+    bench_item_counts();
+    bench_disabled();
+    bench_startup();
+    bench_filter();
+    bench_fuzzy();
+    bench_ownership();
+    bench_mutation();
+    bench_intern();
+    bench_live();
+    bench_repeat();
+    bench_sweep();
+#if !(defined(WIN32) || defined(_WIN32) || defined(__WIN32))
+    bench_queue();
+#endif
+
+    return gBenchWrong;
+}
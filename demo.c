@@ -2,6 +2,7 @@
     demo.c uses wcmenu.h to implement a curses menu
     by Stefan Wessels, February 2017.
 */
+#define WC_MENU_CURSES
 #include "wcmenu.h"
 #include <curses.h>
 
@@ -20,67 +21,38 @@ typedef struct tagUserData
     int length;
 } UserData;
 
-/* make a buffer and use printf style formatting to put a string in the buffer */
-char *makeString(char *format, ... )
-{
-    int size;
-    char *buffer = 0;
-    va_list args;
-
-    va_start(args, format);
-    size = vsnprintf(NULL, 0, format, args);
-    va_end(args);
-
-    if(size)
-    {
-        buffer = (char*)malloc(size+1);
-        va_start(args, format);
-        vsnprintf(buffer, size+1, format, args);
-        va_end(args);
-    }
-    return buffer;
-}
-
 /* toggle a menu item between 1 (on) and 0 (off) and turn on/off other menu option based on the toggle */
 int change(MenuItems *menuItems, int selectedItem)
 {
-    int i, value = 1 - atoi(menuItems->items[selectedItem]);
-
-    /* if you know the menu will be changed, it's easier to "clone" the memory */
-    /* before calling menu, otherwise this needs to be in every callback */
-    if(!menuItems->selfOwnsMemory)
-        WC_menu_take_ownership(menuItems);
+    int value = 1 - atoi(menuItems->items[selectedItem]);
+    char buffer[16];
 
-    free(menuItems->items[selectedItem]);
-    menuItems->items[selectedItem] = makeString("%ld", value);
-    for(i=selectedItem+1; i<selectedItem+3; i++)
-        menuItems->states[i] = value ? WC_ENABLED : WC_DISABLED;
+    /* these copy just what they change, so the menu's text and arrays stay the app's */
+    sprintf(buffer, "%d", value);
+    WC_menu_set_item(menuItems, selectedItem, buffer);
+    WC_menu_set_states(menuItems, selectedItem+1, selectedItem+2, value ? WC_ENABLED : WC_DISABLED);
     return WC_INPUT_KEY_DOWN;
 }
 
 /* update a variable stored in the menuItens class based on selecting the option */
 int increment(MenuItems *menuItems, int selectedItem)
 {
-    if(!menuItems->selfOwnsMemory)
-        WC_menu_take_ownership(menuItems);
+    char buffer[32];
 
-    free(menuItems->items[selectedItem]);
-    menuItems->items[selectedItem] = makeString("Value: %d", ++((UserData*)menuItems->userData_ptr)->value);
+    sprintf(buffer, "Value: %d", ++((UserData*)menuItems->userData_ptr)->value);
+    WC_menu_set_item(menuItems, selectedItem, buffer);
     return 0;
 }
 
 /* add more options to the menu */
 int append(MenuItems *menuItems, int selectedItem)
 {
-    int length;
-
-    if(!menuItems->selfOwnsMemory)
-        WC_menu_take_ownership(menuItems);
+    int length = WC_menu_len(menuItems->items);
+    char buffer[32];
 
-    length = WC_menu_len(menuItems->items);
-    menuItems->items = realloc(menuItems->items,(length+2)*sizeof(char*));
-    menuItems->items[length] = makeString("New Item %d",length);
-    menuItems->items[length+1] = 0;
+    /* copies the text, and keeps the states and callbacks in step */
+    sprintf(buffer, "New Item %d", length);
+    WC_menu_insert_item(menuItems, length, buffer, WC_ENABLED, WC_NO_CALLBACK);
 
     return 0;
 }
@@ -90,22 +62,15 @@ int delete(MenuItems *menuItems, int selectedItem)
 {
     int length = WC_menu_len(menuItems->items);
 
-    if(!menuItems->selfOwnsMemory)
-        WC_menu_take_ownership(menuItems);
-
     if(length > ((UserData*)menuItems->userData_ptr)->length)
-    {
-        free(menuItems->items[length-1]);
-        menuItems->items = realloc(menuItems->items,length*sizeof(char*));
-        menuItems->items[length-1] = 0;
-    }
+        WC_menu_remove_item(menuItems, length-1);
     return 0;
 }
 
-/* map key presses from curses to wc_input defines */
-int demo_input(void)
+/* map a key press from curses to wc_input defines */
+int demo_key(int c)
 {
-    switch(getch())
+    switch(c)
     {
         case 27:
             return WC_INPUT_KEY_ESCAPE;
@@ -113,26 +78,48 @@ int demo_input(void)
             return WC_INPUT_KEY_UP;
         case KEY_DOWN:
             return WC_INPUT_KEY_DOWN;
+        case KEY_PPAGE:
+            return WC_INPUT_KEY_PAGE_UP;
+        case KEY_NPAGE:
+            return WC_INPUT_KEY_PAGE_DOWN;
+        case KEY_HOME:
+            return WC_INPUT_KEY_HOME;
+        case KEY_END:
+            return WC_INPUT_KEY_END;
         case KEY_ENTER:
         case 13:
         case 10:
             return WC_INPUT_KEY_ENTER;
+        case KEY_BACKSPACE:
+        case 127:
+        case 8:
+            return WC_INPUT_KEY_BACKSPACE;
         default:
+            /* typing filters the menu */
+            if(c >= ' ' && c < 127)
+                return WC_INPUT_CHAR(c);
             return 0;
     }
 }
 
-/* drawing function using curses */
-void demo_draw(int y, int x, char *string, int length, int color)
+/* inputFunction: the next key */
+int demo_input(void)
 {
-    attron(COLOR_PAIR(color));
-    mvprintw(y, x, "%-*.*s", length, length, string);
+    return demo_key(getch());
 }
 
-/* make all prior demo_draw calls visible if needed */
-void demo_show(void)
+/* readEvents: every key waiting (getch doesn't wait, see timeout(0)), so held keys don't lag */
+int demo_read_events(int *keys, int max)
 {
-    refresh();
+    int c, numKeys = 0;
+
+    while(numKeys < max && ERR != (c = getch()))
+    {
+        if((keys[numKeys] = demo_key(c)))
+            numKeys++;
+    }
+
+    return numKeys;
 }
 
 /* sets up the colours for curses, the background colour and clears the screen */
@@ -161,6 +148,7 @@ void initScr(void)
 int main()
 {
     MenuItems menuItems;
+    WC_menuIntern labels;
     UserData userData;
     int item, sx, sy;
 
@@ -195,16 +183,19 @@ int main()
     /* create the MenuItems class with some tunable parameters */
     WC_menuInit(&menuItems);
 
-    /* These must be provided */
+    /* These must be provided (wcmenu.h's curses drawFunction and showFunction do the drawing) */
     menuItems.inputFunction = demo_input;
-    menuItems.drawFunction = demo_draw;
+    WC_menu_curses_use(&menuItems);
     menuItems.sy = sy;
     menuItems.sx = sx;
     menuItems.items = items;
 
     /* These are all optional */
     /* comment out anything here to see how it affects the menu */
-    menuItems.showFunction = demo_show;
+    /* sleep between keys and scroll steps rather than spin on getch */
+    menuItems.waitFunction = WC_menu_wait_input;
+    /* act on all the keys that came in since the last frame, then draw one */
+    menuItems.readEvents = demo_read_events;
 
     /*menuItems.y=2; */
     menuItems.x=2;
@@ -217,6 +208,11 @@ int main()
     menuItems.footer_height=0;
     menuItems.callbacks = callbacks;
     menuItems.userData_ptr = (void*)&userData;
+    /* share the text callbacks set, so toggling "1"/"0" allocates nothing after the 1st time */
+    WC_menu_intern_init(&labels);
+    menuItems.intern = &labels;
+    /* type to show only the items starting with what's typed, ESC shows them all again */
+    menuItems.filterMode = WC_FILTER_PREFIX;
 
     /* add the tunable variable to the class */
     userData.value = 10;
@@ -234,6 +230,7 @@ int main()
     item = WC_menu(&menuItems);
     /* clean up the self-owned memory if needed */
     WC_menu_cleanup(&menuItems);
+    WC_menu_intern_free(&labels);
     /* show the cursor */
     curs_set(1);
 
@@ -0,0 +1,187 @@
+/*
+    fbdemo.c draws a menu into framebuffers in memory with wcfb.h, with no
+    screen.  It presses keys, checks that drawing only the cells that
+    changed leaves the same pixels as drawing every cell, and prints the
+    frames' hashes and what a frame costs, at 32, 16 and 8 bits a pixel.
+    fbdemo [file.ppm] also saves the last 32 bit frame as a picture.  It
+    exits 1 if any frames differ or a last frame isn't the one expected.
+*/
+#include "wcfb.h"
+#include <stdio.h>
+
+#define FB_WIDTH                640
+#define FB_HEIGHT               400
+#define FB_ITEMS                300
+#define FB_FRAMES               5000
+
+/* the last frame's hash at 32, 16 and 8 bits a pixel, when the menu draws as it should */
+#define FB_HASH_32              0x27bf3bebUL
+#define FB_HASH_16              0xfb11cff4UL
+#define FB_HASH_8               0x1af17bd5UL
+
+/* the keys pressed, one a frame, over and over: moving, and narrowing the list and widening it again */
+int gKeys[] =
+{
+    WC_INPUT_KEY_DOWN, WC_INPUT_KEY_DOWN, WC_INPUT_KEY_PAGE_DOWN, WC_INPUT_CHAR('h'), WC_INPUT_CHAR('o'),
+    WC_INPUT_KEY_DOWN, WC_INPUT_KEY_BACKSPACE, WC_INPUT_KEY_END, WC_INPUT_KEY_UP, WC_INPUT_KEY_BACKSPACE,
+    WC_INPUT_KEY_PAGE_UP, WC_INPUT_KEY_HOME, 0, 0
+};
+#define FB_NUM_KEYS             (sizeof(gKeys) / sizeof(gKeys[0]))
+
+char gItemNames[FB_ITEMS][48];
+char *gItems[FB_ITEMS + 1];
+int gStates[FB_ITEMS + 1];
+WC_fb gEvery;
+
+/* inputFunction, never called since the demo steps the menu itself */
+int fb_input(void)
+{
+    return WC_INPUT_KEY_ESCAPE;
+}
+
+/* drawBatchFunction for the menu that has every cell drawn, each frame */
+void fb_draw_every(MenuItems *menuItems, WC_menuSpan *spans, int numSpans)
+{
+    WC_fb_spans(&gEvery, spans, numSpans);
+}
+
+/* the menu both framebuffers show */
+void fb_menu(MenuItems *menuItems)
+{
+    WC_menuInit(menuItems);
+    menuItems->inputFunction = fb_input;
+    menuItems->items = gItems;
+    menuItems->states = gStates;
+    menuItems->numItems = menuItems->numStates = FB_ITEMS;
+    menuItems->filterMode = WC_FILTER_PREFIX;
+    menuItems->title = "Pick a host";
+    menuItems->footer = "Type to narrow the list, arrows to move, ENTER to connect, ESC to leave.";
+    menuItems->width = 40;
+}
+
+/* saves fb (32 bit) as a binary PPM */
+void fb_save(WC_fb *fb, const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    int x, y;
+
+    if(!file)
+    {
+        printf("Can't write %s\n", path);
+        return;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", fb->width, fb->height);
+    for(y=0; y<fb->height; y++)
+    {
+        for(x=0; x<fb->width; x++)
+        {
+            unsigned int pixel;
+
+            memcpy(&pixel, &fb->pixels[y * fb->pitch + x * 4], 4);
+            fputc((pixel >> 16) & 255, file);
+            fputc((pixel >> 8) & 255, file);
+            fputc(pixel & 255, file);
+        }
+    }
+    fclose(file);
+}
+
+/* runs the two menus side by side at bytesPerPixel and prints how it went; 1 if they went wrong */
+int fb_run(int bytesPerPixel, const char *path)
+{
+    unsigned char *changedPixels = (unsigned char*)malloc(FB_WIDTH * FB_HEIGHT * bytesPerPixel);
+    unsigned char *everyPixels = (unsigned char*)malloc(FB_WIDTH * FB_HEIGHT * bytesPerPixel);
+    MenuItems changedMenu, everyMenu;
+    WC_menuState changed, every;
+    WC_fb changedFb;
+    WC_time changedStart, everyStart, changedTime = 0, everyTime = 0, start;
+    long changedCells, mismatched = 0;
+    unsigned long hash = 0, expected = 4 == bytesPerPixel ? FB_HASH_32 : 2 == bytesPerPixel ? FB_HASH_16 : FB_HASH_8;
+    int i;
+
+    /* one draws only the cells that changed, the other every cell, each frame */
+    fb_menu(&changedMenu);
+    fb_menu(&everyMenu);
+    if(!changedPixels || !everyPixels
+       || WC_fb_begin(&changedFb, &changedMenu, changedPixels, FB_WIDTH, FB_HEIGHT, FB_WIDTH * bytesPerPixel, bytesPerPixel)
+       || WC_fb_begin(&gEvery, &everyMenu, everyPixels, FB_WIDTH, FB_HEIGHT, FB_WIDTH * bytesPerPixel, bytesPerPixel))
+    {
+        printf("Can't set up %d bit framebuffers\n", bytesPerPixel * 8);
+        return 1;
+    }
+    WC_fb_use(&changedFb);
+    everyMenu.drawBatchFunction = fb_draw_every;
+    WC_fb_clear(&changedFb, 0);
+    WC_fb_clear(&gEvery, 0);
+    if(WC_menu_begin(&changedMenu, &changed) || WC_menu_begin(&everyMenu, &every))
+    {
+        printf("Can't begin the menus\n");
+        return 1;
+    }
+
+    /* time goes by half a scroll step a frame, the same for both, so the footer scrolls as the keys are pressed */
+    changedStart = changed.startTime;
+    everyStart = every.startTime;
+    for(i=0; i<FB_FRAMES; i++)
+    {
+        int key = gKeys[i % FB_NUM_KEYS];
+        WC_time offset = (WC_time)i * (WC_SCROLL_SPEED / 2);
+
+        start = WC_menu_now();
+        WC_menu_step(&changed, key, changedStart + offset);
+        WC_menu_render(&changed);
+        changedTime += WC_menu_now() - start;
+
+        start = WC_menu_now();
+        WC_menu_step(&every, key, everyStart + offset);
+        WC_menu_render(&every);
+        everyTime += WC_menu_now() - start;
+
+        hash = WC_fb_hash(&changedFb);
+        if(hash != WC_fb_hash(&gEvery))
+            mismatched++;
+    }
+    changedCells = changedFb.cells;
+
+    printf("%2d bit: last frame's hash %08lx, %ld of %d frames differ\n", bytesPerPixel * 8, hash, mismatched, FB_FRAMES);
+    printf("        changed cells %6.2fus a frame (%ld cells), every cell %6.2fus (%ld cells)\n",
+           changedTime / 1e3 / FB_FRAMES, changedCells / FB_FRAMES,
+           everyTime / 1e3 / FB_FRAMES, gEvery.cells / FB_FRAMES);
+    if(hash != expected)
+        printf("        WRONG: the last frame's hash should be %08lx\n", expected);
+    if(path && 4 == bytesPerPixel)
+        fb_save(&changedFb, path);
+
+    WC_menu_end(&changed);
+    WC_menu_end(&every);
+    WC_fb_end(&changedFb);
+    WC_fb_end(&gEvery);
+    WC_menu_cleanup(&changedMenu);
+    WC_menu_cleanup(&everyMenu);
+    free(changedPixels);
+    free(everyPixels);
+
+    return mismatched || hash != expected;
+}
+
+/* fb demo (main) program */
+int main(int argc, char **argv)
+{
+    int i, wrong = 0;
+
+    for(i=0; i<FB_ITEMS; i++)
+    {
+        sprintf(gItemNames[i], "%s-%03d%s", i & 1 ? "host" : "other", i, i % 7 ? "" : " (a longer name than fits)");
+        gItems[i] = gItemNames[i];
+        gStates[i] = i % 5 ? WC_ENABLED : WC_DISABLED;
+    }
+    gItems[FB_ITEMS] = 0;
+    gStates[FB_ITEMS] = 0;
+
+    printf("%d frames of a %d item menu in a %dx%d framebuffer, one key a frame\n", FB_FRAMES, FB_ITEMS, FB_WIDTH, FB_HEIGHT);
+    wrong |= fb_run(4, argc > 1 ? argv[1] : 0);
+    wrong |= fb_run(2, 0);
+    wrong |= fb_run(1, 0);
+
+    return wrong;
+}
@@ -0,0 +1,296 @@
+/*
+    loadtest.c opens thousands of local ptys, serves a menu on each with
+    wcserver.h and types into them all, timing each key from being written
+    to the frame that shows it arriving back.  Linux only.
+    loadtest [sessions] [keys per session] [threads] [keys/s per session]
+*/
+#define _GNU_SOURCE
+#include "wcserver.h"
+#include <signal.h>
+#include <sys/resource.h>
+
+#define LOAD_ITEMS              200
+#define LOAD_EVENTS             256
+#define LOAD_START_TIME         (30 * WC_BILLION)
+
+/* what each pty's tester side knows */
+typedef struct tagLoadSession
+{
+        int master;             /* the tester's end of the pty */
+        int marker;             /* bytes of WC_SERVER_FRAME_END matched so far */
+        int frames;             /* frames seen */
+        int keys;               /* keys sent */
+        WC_time sent;           /* when the key waiting for its frame went, 0 if none is */
+} LoadSession;
+
+/* the keys typed, over and over: moving, and narrowing the list and widening it again */
+const char *gKeys[] = { "\x1b[B", "\x1b[B", "\x1b[A", "\x1b[6~", "h", "o", "\x7f", "\x7f", "\x1b[H" };
+#define LOAD_NUM_KEYS           (sizeof(gKeys) / sizeof(gKeys[0]))
+
+char gItemNames[LOAD_ITEMS][16];
+char *gItems[LOAD_ITEMS + 1];
+WC_server gServer;
+long gMemoryPeak, gMemoryTotal, gSessionsEnded;
+
+/* each session's menu, the same one for all */
+int load_begin(WC_serverSession *session)
+{
+    MenuItems *menuItems = &session->menuItems;
+
+    /* no footer: its scrolling would send frames of its own, and a key would be timed to one of those */
+    menuItems->title = "Load test";
+    menuItems->items = gItems;
+    menuItems->numItems = LOAD_ITEMS;
+    menuItems->filterMode = WC_FILTER_PREFIX;
+
+    return 1;
+}
+
+/* adds up what sessions' menus used */
+void load_end(WC_serverSession *session)
+{
+    gMemoryTotal += session->memoryPeak;
+    if((long)session->memoryPeak > gMemoryPeak)
+        gMemoryPeak = session->memoryPeak;
+    gSessionsEnded++;
+}
+
+/* runs the server on its own threads */
+void *load_server(void *arg)
+{
+    WC_server_run(&gServer);
+
+    return 0;
+}
+
+/* sorts latencies */
+int load_compare(const void *a, const void *b)
+{
+    WC_time x = *(const WC_time*)a, y = *(const WC_time*)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* opens a pty for a session, giving the server the slave end; the master, or -1 */
+int load_open(void)
+{
+    struct winsize size;
+    int master, slave;
+
+    master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if(master < 0)
+        return -1;
+    if(grantpt(master) || unlockpt(master))
+    {
+        close(master);
+        return -1;
+    }
+    memset(&size, 0, sizeof(size));
+    size.ws_row = 24;
+    size.ws_col = 80;
+    ioctl(master, TIOCSWINSZ, &size);
+    slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    if(slave < 0 || !WC_server_add(&gServer, slave))
+    {
+        if(slave >= 0)
+            close(slave);
+        close(master);
+        return -1;
+    }
+
+    return master;
+}
+
+/* reads what the server sent a session, counting frames; 1 if a frame ended */
+int load_read(LoadSession *session)
+{
+    char bytes[4096];
+    ssize_t length;
+    int ended = 0;
+
+    while((length = read(session->master, bytes, sizeof(bytes))) > 0)
+    {
+        ssize_t i;
+
+        /* WC_SERVER_FRAME_END may be split over reads */
+        for(i=0; i<length; i++)
+        {
+            if(bytes[i] == WC_SERVER_FRAME_END[session->marker])
+            {
+                if(!WC_SERVER_FRAME_END[++session->marker])
+                {
+                    session->marker = 0;
+                    session->frames++;
+                    ended = 1;
+                }
+            }
+            else
+            {
+                session->marker = bytes[i] == WC_SERVER_FRAME_END[0];
+            }
+        }
+    }
+
+    return ended;
+}
+
+/* load test (main) program */
+int main(int argc, char **argv)
+{
+    int numSessions = argc > 1 ? atoi(argv[1]) : 2000;
+    int keysEach = argc > 2 ? atoi(argv[2]) : 20;
+    int numShards = argc > 3 ? atoi(argv[3]) : 1;
+    double rate = argc > 4 ? atof(argv[4]) : 5.0;
+    struct epoll_event events[LOAD_EVENTS];
+    LoadSession *sessions;
+    WC_time *latencies, start, now, nextKey, interval, elapsed;
+    long numLatencies = 0, total, started = 0;
+    int i, epoll, cursor = 0, outstanding = 0;
+    struct rlimit limit;
+    pthread_t thread;
+
+    /* two descriptors a session, and then some */
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    signal(SIGPIPE, SIG_IGN);
+
+    for(i=0; i<LOAD_ITEMS; i++)
+    {
+        sprintf(gItemNames[i], "%s-%03d", i & 1 ? "host" : "other", i);
+        gItems[i] = gItemNames[i];
+    }
+    gItems[LOAD_ITEMS] = 0;
+
+    if(!WC_server_init(&gServer, numShards))
+        return 1;
+    gServer.sessionBegin = load_begin;
+    gServer.sessionEnd = load_end;
+    pthread_create(&thread, NULL, load_server, NULL);
+
+    sessions = (LoadSession*)calloc(numSessions, sizeof(LoadSession));
+    latencies = (WC_time*)malloc((size_t)numSessions * keysEach * sizeof(WC_time));
+    if(!sessions || !latencies)
+    {
+        printf("Out of memory for %d sessions\n", numSessions);
+        return 1;
+    }
+    epoll = epoll_create1(0);
+    for(i=0; i<numSessions; i++)
+    {
+        struct epoll_event event;
+
+        sessions[i].master = load_open();
+        if(sessions[i].master < 0)
+        {
+            printf("Only %d ptys could be opened\n", i);
+            numSessions = i;
+            break;
+        }
+        event.events = EPOLLIN;
+        event.data.u32 = i;
+        epoll_ctl(epoll, EPOLL_CTL_ADD, sessions[i].master, &event);
+    }
+    total = (long)numSessions * keysEach;
+
+    /* every menu shows its first frame before any typing (the pty is raw by then) */
+    start = WC_menu_now();
+    while(started < numSessions && WC_menu_now() - start < LOAD_START_TIME)
+    {
+        int numEvents = epoll_wait(epoll, events, LOAD_EVENTS, 100);
+
+        for(i=0; i<numEvents; i++)
+        {
+            LoadSession *session = &sessions[events[i].data.u32];
+
+            if(!session->frames && load_read(session))
+                started++;
+            else
+                load_read(session);
+        }
+    }
+    printf("%ld sessions up in %.2fs, %d thread(s)\n", started, (WC_menu_now() - start) / 1e9, gServer.numShards);
+
+    /* keys go out evenly spaced, at rate a second from each session, one waiting at a time per session */
+    interval = (WC_time)(WC_BILLION / (rate * WC_menu_max(1, numSessions)));
+    start = nextKey = WC_menu_now();
+    while(numLatencies < total)
+    {
+        int numEvents, timeout;
+
+        now = WC_menu_now();
+        /* behind by more than a second, it's overloaded: don't try to catch up in a burst */
+        if(now - nextKey > WC_BILLION)
+            nextKey = now;
+        while(nextKey <= now && outstanding < numSessions)
+        {
+            LoadSession *session;
+            int tries = 0;
+
+            do
+            {
+                session = &sessions[cursor];
+                cursor = (cursor + 1) % numSessions;
+            } while((session->sent || session->keys >= keysEach) && ++tries < numSessions);
+            if(session->sent || session->keys >= keysEach)
+                break;
+
+            session->sent = WC_menu_now();
+            if(write(session->master, gKeys[session->keys % LOAD_NUM_KEYS], strlen(gKeys[session->keys % LOAD_NUM_KEYS])) < 0)
+            {
+                printf("write failed: %s\n", strerror(errno));
+                return 1;
+            }
+            session->keys++;
+            outstanding++;
+            nextKey += interval;
+        }
+
+        timeout = nextKey > now ? (int)((nextKey - now) / 1000000) : 0;
+        numEvents = epoll_wait(epoll, events, LOAD_EVENTS, outstanding < numSessions ? timeout : 100);
+        now = WC_menu_now();
+        for(i=0; i<numEvents; i++)
+        {
+            LoadSession *session = &sessions[events[i].data.u32];
+
+            if(load_read(session) && session->sent)
+            {
+                latencies[numLatencies++] = now - session->sent;
+                session->sent = 0;
+                outstanding--;
+            }
+        }
+        if(!numEvents && outstanding && now - start > LOAD_START_TIME + (WC_time)(keysEach / rate * WC_BILLION))
+        {
+            printf("%d keys never showed up\n", outstanding);
+            break;
+        }
+    }
+    elapsed = WC_menu_now() - start;
+
+    /* done: stop the server, which ends every session */
+    WC_server_stop(&gServer);
+    pthread_join(thread, NULL);
+    WC_server_free(&gServer);
+    for(i=0; i<numSessions; i++)
+        close(sessions[i].master);
+
+    if(numLatencies)
+    {
+        qsort(latencies, numLatencies, sizeof(WC_time), load_compare);
+        printf("%ld keys in %.2fs (%.0f keys/s)\n", numLatencies, elapsed / 1e9, numLatencies / (elapsed / 1e9));
+        printf("key to frame: p50 %.3fms  p99 %.3fms  max %.3fms\n",
+               latencies[numLatencies / 2] / 1e6,
+               latencies[(numLatencies * 99) / 100] / 1e6,
+               latencies[numLatencies - 1] / 1e6);
+    }
+    if(gSessionsEnded)
+        printf("menu memory a session: %ld bytes on average, %ld at most (cap %ld)\n",
+               gMemoryTotal / gSessionsEnded, gMemoryPeak, (long)WC_SERVER_MEMORY);
+
+    free(latencies);
+    free(sessions);
+    close(epoll);
+
+    return 0;
+}
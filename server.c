@@ -0,0 +1,79 @@
+/*
+    server.c serves a menu to everyone who connects to a Unix socket, using
+    wcserver.h.  Linux only.  Connect with:
+    socat -,raw,echo=0 UNIX-CONNECT:/tmp/wcmenu.sock
+*/
+#include "wcserver.h"
+#include <signal.h>
+
+#define SERVER_HOSTS            1000
+
+char gHostNames[SERVER_HOSTS][16];
+char *gHosts[SERVER_HOSTS + 1];
+WC_server gServer;
+
+/* sets up each connection's menu; the items are shared, only the menu state is the session's */
+int server_begin(WC_serverSession *session)
+{
+    MenuItems *menuItems = &session->menuItems;
+
+    menuItems->title = "Pick a host";
+    menuItems->footer = "Type to narrow the list, arrows to move, ENTER to connect, ESC to leave.";
+    menuItems->items = gHosts;
+    menuItems->numItems = SERVER_HOSTS;
+    menuItems->filterMode = WC_FILTER_PREFIX;
+
+    return 1;
+}
+
+/* reports what each connection chose */
+void server_end(WC_serverSession *session)
+{
+    if(session->state.result >= 0)
+        printf("session on %d chose %s\n", session->fd, gHosts[session->state.result]);
+}
+
+/* ctrl-c stops the server */
+void server_interrupt(int signal)
+{
+    WC_server_stop(&gServer);
+}
+
+/* demo (main) program */
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "/tmp/wcmenu.sock";
+    int i, numShards = argc > 2 ? atoi(argv[2]) : 1;
+
+    for(i=0; i<SERVER_HOSTS; i++)
+    {
+        sprintf(gHostNames[i], "host-%04d", i);
+        gHosts[i] = gHostNames[i];
+    }
+    gHosts[SERVER_HOSTS] = 0;
+
+    if(!WC_server_init(&gServer, numShards))
+    {
+        printf("Can't set up the server\n");
+        return 1;
+    }
+    gServer.sessionBegin = server_begin;
+    gServer.sessionEnd = server_end;
+    if(!WC_server_listen(&gServer, path))
+    {
+        printf("Can't listen on %s\n", path);
+        WC_server_free(&gServer);
+        return 1;
+    }
+
+    signal(SIGINT, server_interrupt);
+    signal(SIGPIPE, SIG_IGN);
+    printf("Serving menus on %s with %d thread(s)\n", path, gServer.numShards);
+    WC_server_run(&gServer);
+
+    printf("%ld sessions served\n", gServer.numClosed);
+    WC_server_free(&gServer);
+    unlink(path);
+
+    return 0;
+}
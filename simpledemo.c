@@ -2,16 +2,18 @@
     simpledemo.c uses wcmenu.h to implement a simple curses menu
     by Stefan Wessels, February 2017.
 */
+#define WC_MENU_CURSES
 #include "wcmenu.h"
 #include <curses.h>
 
 /* colour pairs the application (demo) uses */
-#define DEMO_BLUE_CYAN          6               /* 1 - 5 are WC_CLR defines */
+#define DEMO_BLUE_CYAN          7               /* 1 - 6 are WC_CLR defines */
 #define DEMO_YELLOW_BLUE        WC_CLR_DISABLED /* use menu colours directly */
 #define DEMO_GREEN_BLUE         WC_CLR_TITLE    /* for drawing menu elements */
 #define DEMO_WHITE_BLUE         WC_CLR_ITEMS
 #define DEMO_WHITE_GREEN        WC_CLR_SELECT
 #define DEMO_CYAN_BLUE          WC_CLR_FOOTER
+#define DEMO_BLACK_YELLOW       WC_CLR_BUSY
 
 
 /* map key presses from curses to wc_input defines */
@@ -34,13 +36,6 @@ int demo_input(void)
     }
 }
 
-/* drawing function using curses */
-void demo_draw(int y, int x, char *string, int length, int color)
-{
-    attron(COLOR_PAIR(color));
-    mvprintw(y, x, "%-*.*s", length, length, string);
-}
-
 /* sets up the colours for curses, the background colour and clears the screen */
 void initScr(void)
 {
@@ -60,6 +55,7 @@ void initScr(void)
         init_pair(DEMO_WHITE_BLUE, COLOR_WHITE, COLOR_BLUE);
         init_pair(DEMO_WHITE_GREEN, COLOR_WHITE, COLOR_GREEN);
         init_pair(DEMO_CYAN_BLUE, COLOR_CYAN, COLOR_BLUE);
+        init_pair(DEMO_BLACK_YELLOW, COLOR_BLACK, COLOR_YELLOW);
     }
 }
 
@@ -89,21 +85,17 @@ int main()
 
     /* these must be provided */
     menuItems.inputFunction = demo_input;
-    menuItems.drawFunction = demo_draw;
     menuItems.sy = sy;
     menuItems.sx = sx;
     menuItems.items = items;
     /* 
-       if nothing is shown, add a demo_show function and hook it
-       up to menuItems.showFunction.  in demo_show, call refresh()
-       i.e.
+       draw with wcmenu.h's curses functions (WC_MENU_CURSES is defined
+       above); a program drawing its own way sets drawFunction, and
+       showFunction if nothing is shown, i.e.
+        menuItems.drawFunction = demo_draw;
         menuItems.showFunction = demo_show;
-       with the function somewhere before main:
-        void demo_show(void)
-        {
-            refresh();
-        }
     */
+    WC_menu_curses_use(&menuItems);
 
     /* set a background colour and clear the screen */
     wbkgd(stdscr, COLOR_PAIR(DEMO_BLUE_CYAN));
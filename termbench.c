@@ -0,0 +1,267 @@
+/*
+    termbench.c draws the same menu on a pty through curses (with
+    mvprintw, as the demos used to, and with wcmenu.h's curses functions)
+    and through wcmenu.h's own terminal backend, and prints what each costs
+    a frame in bytes and write calls (as /proc/thread-self/io counts them)
+    and in time, all told and for the drawing alone.  Linux only.
+    termbench [frames]
+*/
+#define _GNU_SOURCE
+#define WC_MENU_TERMINAL
+#define WC_MENU_CURSES
+#include "wcmenu.h"
+#include <curses.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TERM_ITEMS              200
+
+/* what this thread has written so far */
+typedef struct tagTermIO
+{
+    long bytes;                 /* wchar */
+    long writes;                /* syscw */
+} TermIO;
+
+/* the keys pressed, one a frame, over and over: moving, and narrowing the list and widening it again */
+int gKeys[] =
+{
+    WC_INPUT_KEY_DOWN, WC_INPUT_KEY_DOWN, WC_INPUT_KEY_UP, WC_INPUT_KEY_PAGE_DOWN,
+    WC_INPUT_CHAR('h'), WC_INPUT_CHAR('o'), WC_INPUT_KEY_BACKSPACE, WC_INPUT_KEY_BACKSPACE, WC_INPUT_KEY_HOME
+};
+#define TERM_NUM_KEYS           (sizeof(gKeys) / sizeof(gKeys[0]))
+
+char gItemNames[TERM_ITEMS][16];
+char *gItems[TERM_ITEMS + 1];
+WC_menuState gState;
+int gMaster, gStop;
+
+/* reads the counters for the calling thread */
+void term_io(TermIO *io)
+{
+    char line[64];
+    FILE *file = fopen("/proc/thread-self/io", "r");
+
+    io->bytes = io->writes = 0;
+    if(!file)
+        return;
+    while(fgets(line, sizeof(line), file))
+    {
+        if(!strncmp(line, "wchar: ", 7))
+            io->bytes = atol(&line[7]);
+        else if(!strncmp(line, "syscw: ", 7))
+            io->writes = atol(&line[7]);
+    }
+    fclose(file);
+}
+
+/* plays the terminal: reads and drops whatever's drawn, so writes never wait */
+void *term_drain(void *arg)
+{
+    char bytes[65536];
+    struct pollfd poller;
+
+    poller.fd = gMaster;
+    poller.events = POLLIN;
+    while(!__atomic_load_n(&gStop, __ATOMIC_RELAXED))
+    {
+        if(poll(&poller, 1, 20) > 0 && read(gMaster, bytes, sizeof(bytes)) < 0)
+            break;
+    }
+
+    return 0;
+}
+
+/* inputFunction, never called since the bench steps the menu itself */
+int term_input(void)
+{
+    return WC_INPUT_KEY_ESCAPE;
+}
+
+/* drawFunction, as demo.c's was before WC_menu_curses_draw */
+void term_printw_draw(int y, int x, char *string, int length, int color)
+{
+    attron(COLOR_PAIR(color));
+    mvprintw(y, x, "%-*.*s", length, length, string);
+}
+
+/* showFunction, as demo.c's was */
+void term_printw_show(void)
+{
+    refresh();
+}
+
+/* showMenuFunction for timing the drawing alone: curses keeps the frame in stdscr */
+void term_curses_keep(MenuItems *menuItems)
+{
+}
+
+/* showMenuFunction for timing the drawing alone: the encoded frame is thrown away */
+void term_builtin_drop(MenuItems *menuItems)
+{
+    ((WC_menuTerminal*)menuItems->drawContext)->used = 0;
+}
+
+/* the menu every run draws */
+void term_menu(MenuItems *menuItems)
+{
+    WC_menuInit(menuItems);
+    menuItems->inputFunction = term_input;
+    menuItems->sy = 24;
+    menuItems->sx = 80;
+    menuItems->items = gItems;
+    menuItems->numItems = TERM_ITEMS;
+    menuItems->filterMode = WC_FILTER_PREFIX;
+    menuItems->title = "Pick a host";
+    menuItems->footer = "Type to narrow, ESC to leave";
+}
+
+/* draws frames of the menu, one key each, and prints what the first and the rest cost; then again with drop as the showMenuFunction */
+void term_run(const char *name, MenuItems *menuItems, int frames, void (*drop)(MenuItems *menuItems))
+{
+    TermIO start, first, end;
+    WC_time began, ended, drawn;
+    int i;
+
+    if(WC_menu_begin(menuItems, &gState))
+        return;
+
+    term_io(&start);
+    WC_menu_render(&gState);
+    term_io(&first);
+    began = WC_menu_now();
+    for(i=0; i<frames; i++)
+    {
+        WC_menu_step(&gState, gKeys[i % TERM_NUM_KEYS], began);
+        WC_menu_render(&gState);
+    }
+    ended = WC_menu_now();
+    term_io(&end);
+    WC_menu_end(&gState);
+
+    /* the same frames, drawn but never shown */
+    menuItems->showMenuFunction = drop;
+    if(WC_menu_begin(menuItems, &gState))
+        return;
+    drawn = WC_menu_now();
+    for(i=0; i<frames; i++)
+    {
+        WC_menu_step(&gState, gKeys[i % TERM_NUM_KEYS], drawn);
+        WC_menu_render(&gState);
+    }
+    drawn = WC_menu_now() - drawn;
+    WC_menu_end(&gState);
+
+    printf("%-28s %7ld %7ld %10.1f %8.2f %10.2f %10.2f\n", name,
+           first.bytes - start.bytes, first.writes - start.writes,
+           (end.bytes - first.bytes) / (double)frames, (end.writes - first.writes) / (double)frames,
+           (ended - began) / 1e3 / frames, drawn / 1e3 / frames);
+}
+
+/* curses on the pty's slave, drawing every cell (as demo.c does) or only those that changed, with mvprintw or WC_menu_curses_draw */
+void term_curses(const char *name, int slave, int frames, int changedOnly, int printw)
+{
+    FILE *output = fdopen(dup(slave), "w"), *input = fdopen(dup(slave), "r");
+    SCREEN *screen;
+    MenuItems menuItems;
+
+    if(!output || !input)
+        return;
+    screen = newterm("xterm", output, input);
+    if(!screen)
+        return;
+    set_term(screen);
+    nonl();
+    cbreak();
+    noecho();
+    start_color();
+    init_pair(WC_CLR_TITLE, COLOR_GREEN, COLOR_BLUE);
+    init_pair(WC_CLR_ITEMS, COLOR_WHITE, COLOR_BLUE);
+    init_pair(WC_CLR_FOOTER, COLOR_CYAN, COLOR_BLUE);
+    init_pair(WC_CLR_SELECT, COLOR_WHITE, COLOR_GREEN);
+    init_pair(WC_CLR_DISABLED, COLOR_YELLOW, COLOR_BLUE);
+    init_pair(WC_CLR_BUSY, COLOR_BLACK, COLOR_YELLOW);
+
+    term_menu(&menuItems);
+    WC_menu_curses_use(&menuItems);
+    if(printw)
+    {
+        menuItems.drawFunction = term_printw_draw;
+        menuItems.showFunction = term_printw_show;
+    }
+    menuItems.useBackBuffer = changedOnly;
+    term_run(name, &menuItems, frames, term_curses_keep);
+
+    endwin();
+    delscreen(screen);
+    fclose(output);
+    fclose(input);
+    WC_menu_cleanup(&menuItems);
+}
+
+/* wcmenu.h's terminal backend on the pty's slave */
+void term_builtin(int slave, int frames)
+{
+    WC_menuTerminal terminal;
+    MenuItems menuItems;
+
+    term_menu(&menuItems);
+    if(WC_menu_term_begin(&terminal, &menuItems, slave))
+        return;
+    WC_menu_term_use(&terminal);
+    term_run("WC_menu_term", &menuItems, frames, term_builtin_drop);
+    WC_menu_term_end(&terminal);
+    WC_menu_cleanup(&menuItems);
+}
+
+/* term bench (main) program */
+int main(int argc, char **argv)
+{
+    int i, slave, frames = argc > 1 ? atoi(argv[1]) : 20000;
+    struct winsize size;
+    pthread_t thread;
+
+    for(i=0; i<TERM_ITEMS; i++)
+    {
+        sprintf(gItemNames[i], "%s-%03d", i & 1 ? "host" : "other", i);
+        gItems[i] = gItemNames[i];
+    }
+    gItems[TERM_ITEMS] = 0;
+
+    gMaster = posix_openpt(O_RDWR | O_NOCTTY);
+    if(gMaster < 0 || grantpt(gMaster) || unlockpt(gMaster))
+    {
+        printf("No pty\n");
+        return 1;
+    }
+    memset(&size, 0, sizeof(size));
+    size.ws_row = 24;
+    size.ws_col = 80;
+    ioctl(gMaster, TIOCSWINSZ, &size);
+    slave = open(ptsname(gMaster), O_RDWR | O_NOCTTY);
+    if(slave < 0)
+    {
+        printf("No pty\n");
+        return 1;
+    }
+    pthread_create(&thread, NULL, term_drain, NULL);
+
+    printf("%d frames of a %d item menu on a 24x80 pty, one key a frame\n", frames, TERM_ITEMS);
+    printf("%-28s %7s %7s %10s %8s %10s %10s\n", "", "first", "writes", "bytes/frm", "wr/frm", "us/frm", "draw us");
+    fflush(stdout);
+    term_curses("mvprintw, every cell", slave, frames, 0, 1);
+    term_curses("mvprintw, changed cells", slave, frames, 1, 1);
+    term_curses("WC_menu_curses, every cell", slave, frames, 0, 0);
+    term_curses("WC_menu_curses, changed", slave, frames, 1, 0);
+    term_builtin(slave, frames);
+
+    __atomic_store_n(&gStop, 1, __ATOMIC_RELAXED);
+    pthread_join(thread, NULL);
+    close(slave);
+    close(gMaster);
+
+    return 0;
+}
@@ -0,0 +1,464 @@
+/*
+    wcfb.h draws wcmenu.h menus into a framebuffer in memory (32, 16 or 8
+    bits a pixel) with a built-in 8x8 font, for programs that put the
+    pixels on a screen themselves: SDL, KMS, VNC and the like.  Every glyph
+    is drawn in every colour up front, so a frame is only copies, and
+    nothing is allocated once it's begun.  Include it where wcmenu.h would
+    be included.
+*/
+
+#ifndef WCFB_H_
+#define WCFB_H_
+
+#include "wcmenu.h"
+
+/* a character cell's width and height in pixels */
+#define WC_FB_GLYPH          8
+
+/* the characters the font has, ' ' to '~'; any other is drawn as '?' */
+#define WC_FB_FIRST          32
+#define WC_FB_GLYPHS         95
+
+/* most cells of a span copied row by row in one pass */
+#define WC_FB_RUN            64
+
+/* a framebuffer menus are drawn into */
+typedef struct tagWC_fb
+{
+        MenuItems *menuItems;   /* the menu, whose allocator the atlas comes from */
+        unsigned char *pixels;  /* the program's framebuffer */
+        int width;              /* its size in pixels */
+        int height;
+        int pitch;              /* bytes from one row of pixels to the next */
+        int bytesPerPixel;      /* 4 (0xAARRGGBB), 2 (RGB565) or 1 (an index into 8 colours, as ANSI numbers them) */
+        unsigned long colors[WC_CLR_BUSY+1][2]; /* foreground and background pixel for each WC_CLR_ colour */
+        unsigned char *atlas;   /* every glyph in every colour, as pixels: [colour][glyph][row][WC_FB_GLYPH] */
+        int dirtyTop;           /* the pixels drawn since WC_fb_dirty last asked, none if dirtyBottom is 0 */
+        int dirtyLeft;
+        int dirtyBottom;
+        int dirtyRight;
+        long frames;            /* frames drawn */
+        long cells;             /* character cells drawn */
+} WC_fb;
+
+/*--------------------------------------------------------------------------*\
+  internal functions used by the framebuffer backend
+\*--------------------------------------------------------------------------*/
+/* stores pixel at to, in bytesPerPixel bytes */
+WC_INTERNAL void WC_fb_store(unsigned char *to, unsigned long pixel, int bytesPerPixel);
+/* copies one row of count glyphs to to, side by side */
+WC_INTERNAL void WC_fb_copy_row(unsigned char *to, const unsigned char **glyphs, int count, int row, int bytesPerPixel);
+/* adds the rectangle to what's been drawn since WC_fb_dirty last asked */
+WC_INTERNAL void WC_fb_touch(WC_fb *fb, int top, int left, int bottom, int right);
+
+/*--------------------------------------------------------------------------*\
+  user callable functions
+\*--------------------------------------------------------------------------*/
+/*
+   sets up fb to draw menuItems' menu into pixels, width by height pixels
+   of bytesPerPixel (4, 2 or 1) with pitch bytes from one row to the next.
+   Unless sy and sx are set already, the menu is sized to the cells that
+   fit.  The colours start as the curses demos have them; the atlas is
+   allocated with menuItems' allocator, so set that (if any) first.
+   Returns 0, or -1 if the format isn't one of these or there's no memory
+*/
+WC_GLOBAL int WC_fb_begin(WC_fb *fb, MenuItems *menuItems, void *pixels, int width, int height, int pitch, int bytesPerPixel);
+/* frees the atlas */
+WC_GLOBAL void WC_fb_end(WC_fb *fb);
+/* the pixel for r, g, b (0 to 255) in fb's format; the nearest of the 8 colours if it's indexed */
+WC_GLOBAL unsigned long WC_fb_rgb(WC_fb *fb, int r, int g, int b);
+/* sets a WC_CLR_ colour's foreground and background pixels, and draws its glyphs again */
+WC_GLOBAL void WC_fb_set_color(WC_fb *fb, int color, unsigned long foreground, unsigned long background);
+/* fills the whole framebuffer with color's background */
+WC_GLOBAL void WC_fb_clear(WC_fb *fb, int color);
+/*
+   makes the menu draw into fb, by setting its drawContext to fb, and its
+   drawBatchFunction and useBackBuffer so only cells that changed are
+   drawn.  The program's showFunction puts the pixels on the screen (see
+   WC_fb_dirty); a showMenuFunction finds fb in the menu's drawContext.
+   Each menu finds its own fb, so any number can be drawn at once
+*/
+WC_GLOBAL void WC_fb_use(WC_fb *fb);
+/* draws spans into fb */
+WC_GLOBAL void WC_fb_spans(WC_fb *fb, WC_menuSpan *spans, int numSpans);
+/*
+   gives the rectangle of pixels drawn since the last call, and returns 1,
+   or returns 0 if nothing has been
+*/
+WC_GLOBAL int WC_fb_dirty(WC_fb *fb, int *x, int *y, int *width, int *height);
+/* a hash (32 bit FNV-1a) of the framebuffer's pixels, to check frames against without a screen */
+WC_GLOBAL unsigned long WC_fb_hash(WC_fb *fb);
+/* the drawBatchFunction WC_fb_use sets */
+WC_GLOBAL void WC_fb_draw(MenuItems *menuItems, WC_menuSpan *spans, int numSpans);
+
+/*--------------------------------------------------------------------------*\
+  implementation
+\*--------------------------------------------------------------------------*/
+
+/* the 8 colours, 0xRRGGBB, numbered as ANSI numbers them */
+WC_CONSTANT unsigned long WC_gFbPalette[8] =
+{
+    0x000000, 0xAA0000, 0x00AA00, 0xAA5500, 0x0000AA, 0xAA00AA, 0x00AAAA, 0xAAAAAA
+};
+
+/* foreground and background of each WC_CLR_ colour, from WC_gFbPalette, as the curses demos pair them */
+WC_CONSTANT int WC_gFbColors[WC_CLR_BUSY+1][2] =
+{
+    {4, 6},                     /* 0, the background */
+    {2, 4},                     /* WC_CLR_TITLE */
+    {7, 4},                     /* WC_CLR_ITEMS */
+    {6, 4},                     /* WC_CLR_FOOTER */
+    {7, 2},                     /* WC_CLR_SELECT */
+    {3, 4},                     /* WC_CLR_DISABLED */
+    {0, 3},                     /* WC_CLR_BUSY */
+};
+
+/* the font, ' ' to '~', a byte a row with the leftmost pixel in bit 0 (the public domain font8x8) */
+WC_CONSTANT unsigned char WC_gFbFont[WC_FB_GLYPHS][WC_FB_GLYPH] =
+{
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, /* space */
+    {0x18, 0x3C, 0x3C, 0x18, 0x18, 0x00, 0x18, 0x00}, /* ! */
+    {0x36, 0x36, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, /* " */
+    {0x36, 0x36, 0x7F, 0x36, 0x7F, 0x36, 0x36, 0x00}, /* # */
+    {0x0C, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x0C, 0x00}, /* $ */
+    {0x00, 0x63, 0x33, 0x18, 0x0C, 0x66, 0x63, 0x00}, /* % */
+    {0x1C, 0x36, 0x1C, 0x6E, 0x3B, 0x33, 0x6E, 0x00}, /* & */
+    {0x06, 0x06, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00}, /* ' */
+    {0x18, 0x0C, 0x06, 0x06, 0x06, 0x0C, 0x18, 0x00}, /* ( */
+    {0x06, 0x0C, 0x18, 0x18, 0x18, 0x0C, 0x06, 0x00}, /* ) */
+    {0x00, 0x66, 0x3C, 0xFF, 0x3C, 0x66, 0x00, 0x00}, /* * */
+    {0x00, 0x0C, 0x0C, 0x3F, 0x0C, 0x0C, 0x00, 0x00}, /* + */
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x06}, /* , */
+    {0x00, 0x00, 0x00, 0x3F, 0x00, 0x00, 0x00, 0x00}, /* - */
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x00}, /* . */
+    {0x60, 0x30, 0x18, 0x0C, 0x06, 0x03, 0x01, 0x00}, /* / */
+    {0x3E, 0x63, 0x73, 0x7B, 0x6F, 0x67, 0x3E, 0x00}, /* 0 */
+    {0x0C, 0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x3F, 0x00}, /* 1 */
+    {0x1E, 0x33, 0x30, 0x1C, 0x06, 0x33, 0x3F, 0x00}, /* 2 */
+    {0x1E, 0x33, 0x30, 0x1C, 0x30, 0x33, 0x1E, 0x00}, /* 3 */
+    {0x38, 0x3C, 0x36, 0x33, 0x7F, 0x30, 0x78, 0x00}, /* 4 */
+    {0x3F, 0x03, 0x1F, 0x30, 0x30, 0x33, 0x1E, 0x00}, /* 5 */
+    {0x1C, 0x06, 0x03, 0x1F, 0x33, 0x33, 0x1E, 0x00}, /* 6 */
+    {0x3F, 0x33, 0x30, 0x18, 0x0C, 0x0C, 0x0C, 0x00}, /* 7 */
+    {0x1E, 0x33, 0x33, 0x1E, 0x33, 0x33, 0x1E, 0x00}, /* 8 */
+    {0x1E, 0x33, 0x33, 0x3E, 0x30, 0x18, 0x0E, 0x00}, /* 9 */
+    {0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x00}, /* : */
+    {0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x06}, /* ; */
+    {0x18, 0x0C, 0x06, 0x03, 0x06, 0x0C, 0x18, 0x00}, /* < */
+    {0x00, 0x00, 0x3F, 0x00, 0x00, 0x3F, 0x00, 0x00}, /* = */
+    {0x06, 0x0C, 0x18, 0x30, 0x18, 0x0C, 0x06, 0x00}, /* > */
+    {0x1E, 0x33, 0x30, 0x18, 0x0C, 0x00, 0x0C, 0x00}, /* ? */
+    {0x3E, 0x63, 0x7B, 0x7B, 0x7B, 0x03, 0x1E, 0x00}, /* @ */
+    {0x0C, 0x1E, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x00}, /* A */
+    {0x3F, 0x66, 0x66, 0x3E, 0x66, 0x66, 0x3F, 0x00}, /* B */
+    {0x3C, 0x66, 0x03, 0x03, 0x03, 0x66, 0x3C, 0x00}, /* C */
+    {0x1F, 0x36, 0x66, 0x66, 0x66, 0x36, 0x1F, 0x00}, /* D */
+    {0x7F, 0x46, 0x16, 0x1E, 0x16, 0x46, 0x7F, 0x00}, /* E */
+    {0x7F, 0x46, 0x16, 0x1E, 0x16, 0x06, 0x0F, 0x00}, /* F */
+    {0x3C, 0x66, 0x03, 0x03, 0x73, 0x66, 0x7C, 0x00}, /* G */
+    {0x33, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x33, 0x00}, /* H */
+    {0x1E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00}, /* I */
+    {0x78, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E, 0x00}, /* J */
+    {0x67, 0x66, 0x36, 0x1E, 0x36, 0x66, 0x67, 0x00}, /* K */
+    {0x0F, 0x06, 0x06, 0x06, 0x46, 0x66, 0x7F, 0x00}, /* L */
+    {0x63, 0x77, 0x7F, 0x7F, 0x6B, 0x63, 0x63, 0x00}, /* M */
+    {0x63, 0x67, 0x6F, 0x7B, 0x73, 0x63, 0x63, 0x00}, /* N */
+    {0x1C, 0x36, 0x63, 0x63, 0x63, 0x36, 0x1C, 0x00}, /* O */
+    {0x3F, 0x66, 0x66, 0x3E, 0x06, 0x06, 0x0F, 0x00}, /* P */
+    {0x1E, 0x33, 0x33, 0x33, 0x3B, 0x1E, 0x38, 0x00}, /* Q */
+    {0x3F, 0x66, 0x66, 0x3E, 0x36, 0x66, 0x67, 0x00}, /* R */
+    {0x1E, 0x33, 0x07, 0x0E, 0x38, 0x33, 0x1E, 0x00}, /* S */
+    {0x3F, 0x2D, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00}, /* T */
+    {0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x3F, 0x00}, /* U */
+    {0x33, 0x33, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00}, /* V */
+    {0x63, 0x63, 0x63, 0x6B, 0x7F, 0x77, 0x63, 0x00}, /* W */
+    {0x63, 0x63, 0x36, 0x1C, 0x1C, 0x36, 0x63, 0x00}, /* X */
+    {0x33, 0x33, 0x33, 0x1E, 0x0C, 0x0C, 0x1E, 0x00}, /* Y */
+    {0x7F, 0x63, 0x31, 0x18, 0x4C, 0x66, 0x7F, 0x00}, /* Z */
+    {0x1E, 0x06, 0x06, 0x06, 0x06, 0x06, 0x1E, 0x00}, /* [ */
+    {0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x40, 0x00}, /* backslash */
+    {0x1E, 0x18, 0x18, 0x18, 0x18, 0x18, 0x1E, 0x00}, /* ] */
+    {0x08, 0x1C, 0x36, 0x63, 0x00, 0x00, 0x00, 0x00}, /* ^ */
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF}, /* _ */
+    {0x0C, 0x0C, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00}, /* ` */
+    {0x00, 0x00, 0x1E, 0x30, 0x3E, 0x33, 0x6E, 0x00}, /* a */
+    {0x07, 0x06, 0x06, 0x3E, 0x66, 0x66, 0x3B, 0x00}, /* b */
+    {0x00, 0x00, 0x1E, 0x33, 0x03, 0x33, 0x1E, 0x00}, /* c */
+    {0x38, 0x30, 0x30, 0x3E, 0x33, 0x33, 0x6E, 0x00}, /* d */
+    {0x00, 0x00, 0x1E, 0x33, 0x3F, 0x03, 0x1E, 0x00}, /* e */
+    {0x1C, 0x36, 0x06, 0x0F, 0x06, 0x06, 0x0F, 0x00}, /* f */
+    {0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x1F}, /* g */
+    {0x07, 0x06, 0x36, 0x6E, 0x66, 0x66, 0x67, 0x00}, /* h */
+    {0x0C, 0x00, 0x0E, 0x0C, 0x0C, 0x0C, 0x1E, 0x00}, /* i */
+    {0x30, 0x00, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E}, /* j */
+    {0x07, 0x06, 0x66, 0x36, 0x1E, 0x36, 0x67, 0x00}, /* k */
+    {0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00}, /* l */
+    {0x00, 0x00, 0x33, 0x7F, 0x7F, 0x6B, 0x63, 0x00}, /* m */
+    {0x00, 0x00, 0x1F, 0x33, 0x33, 0x33, 0x33, 0x00}, /* n */
+    {0x00, 0x00, 0x1E, 0x33, 0x33, 0x33, 0x1E, 0x00}, /* o */
+    {0x00, 0x00, 0x3B, 0x66, 0x66, 0x3E, 0x06, 0x0F}, /* p */
+    {0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x78}, /* q */
+    {0x00, 0x00, 0x3B, 0x6E, 0x66, 0x06, 0x0F, 0x00}, /* r */
+    {0x00, 0x00, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x00}, /* s */
+    {0x08, 0x0C, 0x3E, 0x0C, 0x0C, 0x2C, 0x18, 0x00}, /* t */
+    {0x00, 0x00, 0x33, 0x33, 0x33, 0x33, 0x6E, 0x00}, /* u */
+    {0x00, 0x00, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00}, /* v */
+    {0x00, 0x00, 0x63, 0x6B, 0x7F, 0x7F, 0x36, 0x00}, /* w */
+    {0x00, 0x00, 0x63, 0x36, 0x1C, 0x36, 0x63, 0x00}, /* x */
+    {0x00, 0x00, 0x33, 0x33, 0x33, 0x3E, 0x30, 0x1F}, /* y */
+    {0x00, 0x00, 0x3F, 0x19, 0x0C, 0x26, 0x3F, 0x00}, /* z */
+    {0x38, 0x0C, 0x0C, 0x07, 0x0C, 0x0C, 0x38, 0x00}, /* { */
+    {0x18, 0x18, 0x18, 0x00, 0x18, 0x18, 0x18, 0x00}, /* | */
+    {0x07, 0x0C, 0x0C, 0x38, 0x0C, 0x0C, 0x07, 0x00}, /* } */
+    {0x6E, 0x3B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, /* ~ */
+};
+
+/* stores pixel at to, in bytesPerPixel bytes */
+WC_INTERNAL void WC_fb_store(unsigned char *to, unsigned long pixel, int bytesPerPixel)
+{
+    unsigned int wide = (unsigned int)pixel;
+    unsigned short narrow = (unsigned short)pixel;
+
+    if(4 == bytesPerPixel)
+        memcpy(to, &wide, 4);
+    else if(2 == bytesPerPixel)
+        memcpy(to, &narrow, 2);
+    else
+        *to = (unsigned char)pixel;
+}
+
+/* copies one row of count glyphs to to, side by side.  Each copy is a fixed size, so the compiler does it in a register or two (SIMD ones where it can) */
+WC_INTERNAL void WC_fb_copy_row(unsigned char *to, const unsigned char **glyphs, int count, int row, int bytesPerPixel)
+{
+    int i;
+
+    switch(bytesPerPixel)
+    {
+        case 4:
+            row *= WC_FB_GLYPH * 4;
+            for(i=0; i<count; i++, to += WC_FB_GLYPH * 4)
+                memcpy(to, glyphs[i] + row, WC_FB_GLYPH * 4);
+            break;
+        case 2:
+            row *= WC_FB_GLYPH * 2;
+            for(i=0; i<count; i++, to += WC_FB_GLYPH * 2)
+                memcpy(to, glyphs[i] + row, WC_FB_GLYPH * 2);
+            break;
+        default:
+            row *= WC_FB_GLYPH;
+            for(i=0; i<count; i++, to += WC_FB_GLYPH)
+                memcpy(to, glyphs[i] + row, WC_FB_GLYPH);
+            break;
+    }
+}
+
+/* adds the rectangle to what's been drawn since WC_fb_dirty last asked */
+WC_INTERNAL void WC_fb_touch(WC_fb *fb, int top, int left, int bottom, int right)
+{
+    if(!fb->dirtyBottom)
+    {
+        fb->dirtyTop = top;
+        fb->dirtyLeft = left;
+        fb->dirtyBottom = bottom;
+        fb->dirtyRight = right;
+        return;
+    }
+    fb->dirtyTop = WC_menu_min(fb->dirtyTop, top);
+    fb->dirtyLeft = WC_menu_min(fb->dirtyLeft, left);
+    fb->dirtyBottom = WC_menu_max(fb->dirtyBottom, bottom);
+    fb->dirtyRight = WC_menu_max(fb->dirtyRight, right);
+}
+
+WC_GLOBAL int WC_fb_begin(WC_fb *fb, MenuItems *menuItems, void *pixels, int width, int height, int pitch, int bytesPerPixel)
+{
+    int i;
+
+    memset(fb, 0, sizeof(WC_fb));
+    if((4 != bytesPerPixel && 2 != bytesPerPixel && 1 != bytesPerPixel) || width < WC_FB_GLYPH || height < WC_FB_GLYPH || pitch < width * bytesPerPixel)
+        return -1;
+    fb->menuItems = menuItems;
+    fb->pixels = (unsigned char*)pixels;
+    fb->width = width;
+    fb->height = height;
+    fb->pitch = pitch;
+    fb->bytesPerPixel = bytesPerPixel;
+
+    fb->atlas = (unsigned char*)WC_menu_heap_alloc(menuItems, (size_t)(WC_CLR_BUSY + 1) * WC_FB_GLYPHS * WC_FB_GLYPH * WC_FB_GLYPH * bytesPerPixel);
+    if(!fb->atlas)
+        return -1;
+    for(i=0; i<=WC_CLR_BUSY; i++)
+    {
+        unsigned long foreground = WC_gFbPalette[WC_gFbColors[i][0]], background = WC_gFbPalette[WC_gFbColors[i][1]];
+
+        WC_fb_set_color(fb, i,
+                        WC_fb_rgb(fb, (int)(foreground >> 16), (int)(foreground >> 8) & 255, (int)foreground & 255),
+                        WC_fb_rgb(fb, (int)(background >> 16), (int)(background >> 8) & 255, (int)background & 255));
+    }
+
+    if(WC_NONE == menuItems->sy && WC_NONE == menuItems->sx)
+    {
+        menuItems->sy = height / WC_FB_GLYPH;
+        menuItems->sx = width / WC_FB_GLYPH;
+    }
+
+    return 0;
+}
+
+WC_GLOBAL void WC_fb_end(WC_fb *fb)
+{
+    if(fb->menuItems && fb->menuItems->drawContext == fb)
+        fb->menuItems->drawContext = 0;
+    WC_menu_heap_free(fb->menuItems, fb->atlas);
+    fb->atlas = 0;
+}
+
+WC_GLOBAL unsigned long WC_fb_rgb(WC_fb *fb, int r, int g, int b)
+{
+    unsigned long best = 0, bestDistance = (unsigned long)-1;
+    int i;
+
+    if(4 == fb->bytesPerPixel)
+        return 0xFF000000UL | ((unsigned long)r << 16) | ((unsigned long)g << 8) | (unsigned long)b;
+    if(2 == fb->bytesPerPixel)
+        return ((unsigned long)(r >> 3) << 11) | ((unsigned long)(g >> 2) << 5) | (unsigned long)(b >> 3);
+
+    for(i=0; i<8; i++)
+    {
+        long dr = (long)(WC_gFbPalette[i] >> 16) - r, dg = (long)((WC_gFbPalette[i] >> 8) & 255) - g, db = (long)(WC_gFbPalette[i] & 255) - b;
+        unsigned long distance = (unsigned long)(dr * dr + dg * dg + db * db);
+
+        if(distance < bestDistance)
+        {
+            best = i;
+            bestDistance = distance;
+        }
+    }
+
+    return best;
+}
+
+WC_GLOBAL void WC_fb_set_color(WC_fb *fb, int color, unsigned long foreground, unsigned long background)
+{
+    int glyph, row, column, bytesPerPixel = fb->bytesPerPixel;
+    unsigned char *to;
+
+    if(color < 0 || color > WC_CLR_BUSY)
+        return;
+    fb->colors[color][0] = foreground;
+    fb->colors[color][1] = background;
+
+    to = &fb->atlas[(size_t)color * WC_FB_GLYPHS * WC_FB_GLYPH * WC_FB_GLYPH * bytesPerPixel];
+    for(glyph=0; glyph<WC_FB_GLYPHS; glyph++)
+    {
+        for(row=0; row<WC_FB_GLYPH; row++)
+        {
+            for(column=0; column<WC_FB_GLYPH; column++, to += bytesPerPixel)
+                WC_fb_store(to, (WC_gFbFont[glyph][row] >> column) & 1 ? foreground : background, bytesPerPixel);
+        }
+    }
+}
+
+WC_GLOBAL void WC_fb_clear(WC_fb *fb, int color)
+{
+    int x, y;
+
+    if(color < 0 || color > WC_CLR_BUSY)
+        color = 0;
+    /* the first row is filled a pixel at a time, and copied to the rest */
+    for(x=0; x<fb->width; x++)
+        WC_fb_store(&fb->pixels[x * fb->bytesPerPixel], fb->colors[color][1], fb->bytesPerPixel);
+    for(y=1; y<fb->height; y++)
+        memcpy(&fb->pixels[(size_t)y * fb->pitch], fb->pixels, (size_t)fb->width * fb->bytesPerPixel);
+    WC_fb_touch(fb, 0, 0, fb->height, fb->width);
+}
+
+WC_GLOBAL void WC_fb_use(WC_fb *fb)
+{
+    fb->menuItems->drawContext = fb;
+    fb->menuItems->drawBatchFunction = WC_fb_draw;
+    fb->menuItems->useBackBuffer = 1;
+}
+
+WC_GLOBAL void WC_fb_spans(WC_fb *fb, WC_menuSpan *spans, int numSpans)
+{
+    const unsigned char *glyphs[WC_FB_RUN];
+    size_t glyphBytes = (size_t)WC_FB_GLYPH * WC_FB_GLYPH * fb->bytesPerPixel;
+    int i, columns = fb->width / WC_FB_GLYPH, rows = fb->height / WC_FB_GLYPH;
+
+    for(i=0; i<numSpans; i++)
+    {
+        WC_menuSpan *span = &spans[i];
+        int color = span->color >= 0 && span->color <= WC_CLR_BUSY ? span->color : 0;
+        const unsigned char *atlas = &fb->atlas[(size_t)color * WC_FB_GLYPHS * glyphBytes];
+        int length = WC_menu_min(span->length, columns - span->x), ended = 0, done = 0;
+
+        if(span->y < 0 || span->y >= rows || span->x < 0 || length <= 0)
+            continue;
+        WC_fb_touch(fb, span->y * WC_FB_GLYPH, span->x * WC_FB_GLYPH, (span->y + 1) * WC_FB_GLYPH, (span->x + length) * WC_FB_GLYPH);
+
+        /* a run of cells at a time: find their glyphs, then copy them a row of pixels at a time */
+        while(done < length)
+        {
+            int run = WC_menu_min(length - done, WC_FB_RUN), j, row;
+            unsigned char *to = &fb->pixels[(size_t)span->y * WC_FB_GLYPH * fb->pitch + (size_t)(span->x + done) * WC_FB_GLYPH * fb->bytesPerPixel];
+
+            for(j=0; j<run; j++)
+            {
+                int c = ' ';
+
+                /* the text, padded with spaces once it ends */
+                if(!ended && span->string[done + j])
+                    c = (unsigned char)span->string[done + j];
+                else
+                    ended = 1;
+                if(c < WC_FB_FIRST || c >= WC_FB_FIRST + WC_FB_GLYPHS)
+                    c = '?';
+                glyphs[j] = &atlas[(c - WC_FB_FIRST) * glyphBytes];
+            }
+            for(row=0; row<WC_FB_GLYPH; row++, to += fb->pitch)
+                WC_fb_copy_row(to, glyphs, run, row, fb->bytesPerPixel);
+            done += run;
+        }
+        fb->cells += length;
+    }
+    fb->frames++;
+}
+
+WC_GLOBAL int WC_fb_dirty(WC_fb *fb, int *x, int *y, int *width, int *height)
+{
+    if(!fb->dirtyBottom)
+        return 0;
+    *x = fb->dirtyLeft;
+    *y = fb->dirtyTop;
+    *width = fb->dirtyRight - fb->dirtyLeft;
+    *height = fb->dirtyBottom - fb->dirtyTop;
+    fb->dirtyBottom = 0;
+
+    return 1;
+}
+
+WC_GLOBAL unsigned long WC_fb_hash(WC_fb *fb)
+{
+    unsigned long hash = 2166136261UL;
+    size_t rowBytes = (size_t)fb->width * fb->bytesPerPixel, i;
+    int y;
+
+    for(y=0; y<fb->height; y++)
+    {
+        const unsigned char *row = &fb->pixels[(size_t)y * fb->pitch];
+
+        for(i=0; i<rowBytes; i++)
+            hash = ((hash ^ row[i]) * 16777619UL) & 0xFFFFFFFFUL;
+    }
+
+    return hash;
+}
+
+/* drawBatchFunction for the fb WC_fb_use set up */
+WC_GLOBAL void WC_fb_draw(MenuItems *menuItems, WC_menuSpan *spans, int numSpans)
+{
+    if(menuItems->drawContext)
+        WC_fb_spans((WC_fb*)menuItems->drawContext, spans, numSpans);
+}
+
+#endif /* WCFB_H_ */
@@ -18,12 +18,20 @@ extern "C" {
 #define WC_ERROR_WINDOW_SMALL -2  /*the window is too small to show a menu */
 #define WC_ERROR_CANCEL       -1  /*ESC key pressed to leave menu */
 
+/* WC_menu_step return values, besides the errors above */
+#define WC_MENU_RUNNING       0   /* still going, keep stepping */
+#define WC_MENU_SELECTED      1   /* an item was chosen, see state->result */
+#define WC_MENU_CANCEL        WC_ERROR_CANCEL
+/* state->result while the menu runs, unlike any item or error, so choosing item 0 ends it */
+#define WC_MENU_PENDING       (-100)
+
 /* colours to use when draing the menu */
 #define WC_CLR_TITLE          1
 #define WC_CLR_ITEMS          2
 #define WC_CLR_FOOTER         3
 #define WC_CLR_SELECT         4
 #define WC_CLR_DISABLED       5
+#define WC_CLR_BUSY           6   /* an item whose async callback is still running, unless menuItems->busyColor says otherwise */
 
 /* array sentinels/placeholders */
 #define WC_ENABLED           (1)
@@ -41,18 +49,148 @@ extern "C" {
 /* number of nanoseconds in a second */
 #define WC_BILLION           (1E9)
 
+/* how many bytes of an item a getItem provider can fill in */
+#ifndef WC_MENU_ROW_CAPACITY
+#define WC_MENU_ROW_CAPACITY 256
+#endif
+
+/* the smallest and (unless one allocation needs more) largest chunk an owned menu's memory comes in */
+#ifndef WC_MENU_ARENA_CHUNK
+#define WC_MENU_ARENA_CHUNK  4096
+#endif
+#ifndef WC_MENU_ARENA_CHUNK_MAX
+#define WC_MENU_ARENA_CHUNK_MAX (1024*1024)
+#endif
+
+/* free lists for given back arena blocks: list n holds blocks of 2^n to 2^(n+1)-1 block headers' worth, the last any bigger */
+#define WC_MENU_ARENA_BINS   20
+
+/* how many bytes of a queued event's text are kept, including the 0 on the end */
+#ifndef WC_MENU_EVENT_TEXT
+#define WC_MENU_EVENT_TEXT   64
+#endif
+
+/* most keys WC_menu takes from readEvents before drawing a frame */
+#ifndef WC_MENU_EVENTS
+#define WC_MENU_EVENTS       64
+#endif
+
+/* timeout for the waitFunction when nothing on-screen animates */
+#define WC_WAIT_FOREVER      (-1)
+
 /* how fast the footer and too long menu items scroll */
 #define WC_SCROLL_SPEED      (WC_BILLION/8)
 
+/* how often a menu with a queue wakes up to take the events pushed to it */
+#ifndef WC_MENU_QUEUE_POLL
+#define WC_MENU_QUEUE_POLL   (WC_BILLION/60)
+#endif
+/* most appends from a queue that go into the menu in one insert */
+#define WC_QUEUE_BATCH       256
+
+/* most async callbacks a menu runs at once, the threads they run on, */
+/* and how many changes each can have waiting (a power of 2) */
+#ifndef WC_MENU_JOBS
+#define WC_MENU_JOBS         8
+#endif
+#ifndef WC_MENU_JOB_THREADS
+#define WC_MENU_JOB_THREADS  2
+#endif
+#ifndef WC_MENU_JOB_EVENTS
+#define WC_MENU_JOB_EVENTS   64
+#endif
+
 /*menu key handling */
 #define WC_INPUT_KEY_UP      1
 #define WC_INPUT_KEY_DOWN    2
 #define WC_INPUT_KEY_ENTER   4
 #define WC_INPUT_KEY_ESCAPE  8
 
+#define WC_INPUT_KEY_CHAR    16  /* a typed character, in bits 16-23 - see WC_INPUT_CHAR */
+#define WC_INPUT_KEY_BACKSPACE 32
+#define WC_INPUT_KEY_PAGE_UP 64
+#define WC_INPUT_KEY_PAGE_DOWN 128
+#define WC_INPUT_KEY_HOME    256
+#define WC_INPUT_KEY_END     512
+#define WC_INPUT_KEY_JUMP    1024 /* to menuItems->jumpItem - see WC_menu_jump */
+
 #define WC_INPUT_MOTION      (WC_INPUT_KEY_UP | WC_INPUT_KEY_DOWN)
 #define WC_INPUT_SELECT      WC_INPUT_KEY_ENTER
 #define WC_INPUT_BACKUP      WC_INPUT_KEY_ESCAPE
+#define WC_INPUT_FILTER      (WC_INPUT_KEY_CHAR | WC_INPUT_KEY_BACKSPACE)
+#define WC_INPUT_PAGING      (WC_INPUT_KEY_PAGE_UP | WC_INPUT_KEY_PAGE_DOWN | WC_INPUT_KEY_HOME | WC_INPUT_KEY_END | WC_INPUT_KEY_JUMP)
+
+/* the key for typing character c, and the character in such a key */
+#define WC_INPUT_CHAR(c)     (WC_INPUT_KEY_CHAR | (((c) & 0xff) << 16))
+#define WC_INPUT_CHAR_OF(key) (((key) >> 16) & 0xff)
+
+/* filterMode values */
+#define WC_FILTER_NONE       0   /* typed characters are ignored */
+#define WC_FILTER_PREFIX     1   /* typed characters narrow the list to items starting with them */
+#define WC_FILTER_FUZZY      2   /* typed characters rank items containing them in order, best first */
+
+/* events other threads can push to a menu's queue */
+#define WC_EVENT_APPEND      1   /* add an item with text and state after the last one */
+#define WC_EVENT_UPDATE      2   /* give item index new text */
+#define WC_EVENT_STATE       3   /* set the state of item index */
+
+/* where an async callback's job is */
+#define WC_JOB_FREE          0   /* not in use */
+#define WC_JOB_QUEUED        1   /* waiting for a thread */
+#define WC_JOB_RUNNING       2   /* the callback's running */
+#define WC_JOB_DONE          3   /* it returned, and the menu hasn't taken in what it did yet */
+
+/* which of its position and size WC_menu_begin worked out for a menu, so they follow the items as they change */
+#define WC_AUTO_Y            1
+#define WC_AUTO_X            2
+#define WC_AUTO_HEIGHT       4
+#define WC_AUTO_WIDTH        8
+
+/* how many characters can be typed into a filter, including the 0 on the end */
+#ifndef WC_MENU_FILTER_CAPACITY
+#define WC_MENU_FILTER_CAPACITY 64
+#endif
+
+/* how many of the best fuzzy matches are listed */
+#ifndef WC_MENU_FUZZY_TOP
+#define WC_MENU_FUZZY_TOP    1000
+#endif
+
+/* fuzzy ranking runs in steps of this many items (per thread), */
+/* for up to this long each WC_menu_step, so the menu keeps drawing */
+#ifndef WC_MENU_RANK_CHUNK
+#define WC_MENU_RANK_CHUNK   16384
+#endif
+#ifndef WC_MENU_RANK_TIME
+#define WC_MENU_RANK_TIME    (WC_BILLION/250)
+#endif
+
+/* define WC_MENU_THREADS as a number of threads to help with fuzzy ranking (needs pthreads) */
+#if defined(WC_MENU_THREADS) && !(defined(WIN32) || defined(_WIN32) || defined(__WIN32))
+#define WC_MENU_WORKERS      (WC_MENU_THREADS + 1)
+#else
+#undef WC_MENU_THREADS
+#define WC_MENU_WORKERS      1
+#endif
+
+/* define WC_MENU_TERMINAL for the built-in ANSI/VT terminal backend (not on Windows), see WC_menu_term_begin */
+#if defined(WC_MENU_TERMINAL) && (defined(WIN32) || defined(_WIN32) || defined(__WIN32))
+#undef WC_MENU_TERMINAL
+#endif
+
+/* define WC_MENU_CURSES for a curses drawFunction and showFunction, see WC_menu_curses_use */
+
+/* bytes the terminal backend's frame buffer starts at; it grows as frames need */
+#ifndef WC_MENU_TERM_OUTPUT
+#define WC_MENU_TERM_OUTPUT  4096
+#endif
+
+/* define WC_MENU_STATS for counters and timings of what a menu does, see WC_menu_get_stats */
+
+/* buckets in the stats' histograms: bucket n counts times under 2^n microseconds (and at least half that), the last any longer */
+#ifndef WC_MENU_STATS_BUCKETS
+#define WC_MENU_STATS_BUCKETS 20
+#endif
 
 /* define/include timespec struct */
 #if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
@@ -70,14 +208,34 @@ WC_GLOBAL LARGE_INTEGER WC_gCountsPerSec;
 #else /* !Windows */
 
 #include <time.h>
+#include <poll.h>
+#ifdef WC_MENU_THREADS
+#include <pthread.h>
+#endif
+#ifdef WC_MENU_TERMINAL
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#endif
 
 #endif /* !Windows */
 
 /* other needed includes */
 #include <stdlib.h>
 #include <string.h>
+#ifdef WC_MENU_CURSES
+#include <curses.h>
+#endif
+#ifdef WC_MENU_STATS
+#include <stdio.h>
+#endif
+
+/* time in nanoseconds */
+typedef long long WC_time;
 
-WC_INTERNAL unsigned long WC_menu_elapsedTime(struct timespec start, struct timespec end);
+WC_INTERNAL WC_time WC_menu_elapsedTime(struct timespec start, struct timespec end);
 
 /* prototype for callback function */
 struct tagMenuItems;
@@ -86,6 +244,122 @@ typedef int (*cbf_ptr)(struct tagMenuItems *, int);
 /* prototype for draw function */
 typedef void (*WC_menu_draw)(int y, int x, char *string, int length, int color);
 
+/* one drawFunction call, recorded so a whole frame can be handed over at once */
+typedef struct tagWC_menuSpan
+{
+        int y;                  /* row */
+        int x;                  /* column */
+        char *string;           /* text, only valid until the next frame */
+        int length;             /* width to draw; string is padded with spaces */
+        int color;              /* WC_CLR_* colour */
+} WC_menuSpan;
+
+/* prototype for batched draw function - spans arrive top to bottom, left to right */
+typedef void (*WC_menu_draw_batch)(struct tagMenuItems *menuItems, WC_menuSpan *spans, int numSpans);
+
+/* the spans making up one frame */
+typedef struct tagWC_menuFrame
+{
+        struct tagMenuItems *menuItems; /* the menu, whose allocator the frame uses */
+        WC_menuSpan *spans;     /* recorded draw calls */
+        int numSpans;           /* spans used this frame */
+        int maxSpans;           /* spans allocated */
+
+        /* back-buffer, only used when menuItems->useBackBuffer is set */
+        char *cells;            /* sy*sx characters drawn this frame */
+        unsigned char *colors;  /* sy*sx colours drawn this frame, 0 = not drawn */
+        char *screenCells;      /* sy*sx characters the program has been given */
+        unsigned char *screenColors; /* sy*sx colours the program has been given, 0 = unknown */
+        int top, bottom;        /* rows touched this frame */
+        int left, right;        /* columns touched this frame */
+} WC_menuFrame;
+
+/* what's in front of each block of an owned menu's memory; a union so blocks stay aligned */
+typedef union tagWC_menuArenaBlock
+{
+        size_t capacity;        /* bytes in the block, which may be more than were asked for */
+        void *alignPointer;
+        double alignDouble;
+        long long alignLong;
+} WC_menuArenaBlock;
+
+/* a chunk of an owned menu's memory, handed out in blocks from the front */
+typedef struct tagWC_menuArena
+{
+        struct tagWC_menuArena *next; /* the chunk filled before this one */
+        size_t size;            /* bytes for blocks, after this header */
+        size_t used;            /* bytes handed out */
+        WC_menuArenaBlock first;/* where the blocks start */
+} WC_menuArena;
+
+/* one copy of each label, shared by the menus that use it */
+typedef struct tagWC_menuIntern
+{
+        char **table;           /* the text, at its hash (or the next free slot after), 0 = free */
+        unsigned int *hashes;   /* the hash of each entry in table */
+        int capacity;           /* slots in table, a power of 2 */
+        int count;              /* slots used */
+        WC_menuArena *text;     /* where the text is kept, newest chunk first */
+        long lookups;           /* strings interned */
+        long hits;              /* ... that were in the pool already */
+        size_t bytes;           /* bytes of text in the pool */
+        size_t bytesSaved;      /* bytes the hits would have taken as copies */
+        void *(*mallocFunction)(void *context, size_t size); /* if set, with the next, used in place of malloc */
+        void (*freeFunction)(void *context, void *ptr); /* ... and free */
+        void *allocContext;     /* passed to those as context */
+} WC_menuIntern;
+
+/* a change pushed to a menu's queue */
+typedef struct tagWC_menuEvent
+{
+        volatile unsigned long sequence; /* the position the slot can be pushed to, +1 once it has been */
+        int type;               /* WC_EVENT_* */
+        int index;              /* the item, for WC_EVENT_UPDATE and WC_EVENT_STATE */
+        int state;              /* the state, for WC_EVENT_APPEND and WC_EVENT_STATE */
+        char text[WC_MENU_EVENT_TEXT]; /* the text, for WC_EVENT_APPEND and WC_EVENT_UPDATE */
+} WC_menuEvent;
+
+/* a ring of events that any number of threads push to and the menu takes from, without locks */
+typedef struct tagWC_menuQueue
+{
+        WC_menuEvent *events;   /* capacity slots, each used by every capacity'th position */
+        unsigned long capacity; /* a power of 2 */
+        volatile unsigned long pushPosition; /* next position a pushing thread claims */
+        char pad[64];           /* keeps the pushers' position and the menu's on different cache lines */
+        unsigned long takePosition; /* next position the menu takes from */
+        long taken;             /* events the menu has applied */
+        struct tagWC_menuJob *job; /* set while a job's callback runs on the menu's thread, which applies the queue when it's full */
+        struct tagMenuItems *menuItems; /* whose allocator the events came from, 0 for malloc */
+} WC_menuQueue;
+
+#ifdef WC_MENU_STATS
+/* what a menu has done, counted as it runs; times are in nanoseconds */
+typedef struct tagWC_menuStats
+{
+        long frames;            /* frames rendered */
+        long spans;             /* drawFunction calls (spans, with a drawBatchFunction) in them all */
+        long cells;             /* characters drawn in them all */
+        int lastSpans;          /* spans in the last frame */
+        int lastCells;          /* characters in the last frame */
+        long steps;             /* WC_menu_step calls */
+        long keys;              /* keys they were given */
+        long moves;             /* of those, up and down */
+        long pages;             /* page up and down, home, end and jumps */
+        long filterKeys;        /* typing and backspace */
+        long selects;           /* ENTER */
+        long cancels;           /* ESC */
+        long callbacks;         /* callbacks run on the menu's thread */
+        WC_time renderTime;     /* in WC_menu_render, drawing included */
+        WC_time drawTime;       /* in drawFunction or drawBatchFunction, and showFunction */
+        WC_time inputTime;      /* in inputFunction or readEvents, as WC_menu calls them */
+        WC_time waitTime;       /* in waitFunction, as WC_menu calls it */
+        WC_time callbackTime;   /* in callbacks */
+        WC_time pressed;        /* when the oldest key not yet shown was given to WC_menu_step, 0 if none */
+        long frameTimes[WC_MENU_STATS_BUCKETS]; /* how long each WC_menu_render took */
+        long latencies[WC_MENU_STATS_BUCKETS];  /* from the oldest key each frame shows to the end of that frame */
+} WC_menuStats;
+#endif
+
 /* contains all elements to make/draw a menu */
 typedef struct tagMenuItems
 {
@@ -109,27 +383,438 @@ typedef struct tagMenuItems
         cbf_ptr *callbacks;     /* callbakcs for selecting items */
         void *userData_ptr;     /* pointer to any user defined data */
         void (*showFunction)(void); /* called at the end of each frame */
+        int numItems;           /* items in items, WC_NONE = count up to the 0 terminator */
+        int numStates;          /* entries in states, WC_NONE = count up to the 0 terminator */
+        int numCallbacks;       /* entries in callbacks, WC_NONE = count up to the 0 terminator */
+        int (*getItem)(void *userData, int index, char *buffer, int capacity); /* if set, fills in item text instead of items */
+        int (*getState)(void *userData, int index); /* if set with getItem, gives states instead of states */
+        WC_menu_draw_batch drawBatchFunction; /* if set, gets each frame in one call instead of drawFunction */
+        void (*waitFunction)(WC_time timeout); /* if set, called to block until input or timeout ns pass */
+        int useBackBuffer;      /* 1 = only draw the cells that changed since the last frame */
+        int cellsChanged;       /* with useBackBuffer, how many cells the last frame drew */
+        int filterMode;         /* WC_FILTER_PREFIX = type to narrow the list (items array only) */
+        int jumpItem;           /* the item WC_INPUT_KEY_JUMP moves to */
+        void *(*mallocFunction)(void *context, size_t size); /* if set, with the next two, used in place of malloc */
+        void *(*reallocFunction)(void *context, void *ptr, size_t size); /* ... realloc */
+        void (*freeFunction)(void *context, void *ptr); /* ... and free */
+        void *allocContext;     /* passed to those as context */
+        WC_menuIntern *intern;  /* if set, text the menu copies comes from (and is shared through) this pool */
+        WC_menuQueue *queue;    /* if set, events pushed to this are applied each WC_menu_step */
+        cbf_ptr *asyncCallbacks;/* callbacks that run in the background, see WC_menu_cancelled */
+        int numAsyncCallbacks;  /* entries in asyncCallbacks */
+        int (*readEvents)(int *keys, int max); /* if set, used instead of inputFunction: fills in up to max waiting keys, returns how many */
+        void *drawContext;      /* for the functions drawing the menu, which find it through the menu (see WC_menu_term_use) */
+        int (*inputMenuFunction)(struct tagMenuItems *menuItems); /* if set, used instead of inputFunction, and given the menu */
+        int (*readMenuEvents)(struct tagMenuItems *menuItems, int *keys, int max); /* ... instead of readEvents */
+        void (*waitMenuFunction)(struct tagMenuItems *menuItems, WC_time timeout); /* ... instead of waitFunction */
+        void (*showMenuFunction)(struct tagMenuItems *menuItems); /* ... instead of showFunction */
+        int busyColor;          /* colour busy items are drawn in, WC_CLR_BUSY unless set */
         
         /* internal */
-        int  selfOwnsMemory;    /* 1 = call free on elements; 0 = don't */
+        int  selfOwnsMemory;    /* 1 = the menu has an arena for copies of (some of) its arrays and text */
+        int  selfOwnsHeap;      /* 1 = WC_menu_take_ownership's heap copies, and text not from the arena, are freed by WC_menu_cleanup */
+        WC_menuArena *arena;    /* where owned memory comes from, newest chunk first */
+        WC_menuArena **chunks;  /* the chunks before the newest, by address, so finding ptr's is a binary search */
+        int numChunks;          /* chunks in chunks */
+        int chunksCapacity;     /* room in chunks */
+        void *freeBlocks[WC_MENU_ARENA_BINS]; /* arena blocks given back, by size, each starting with the next */
+        struct tagWC_menuState *runningState; /* the state running this menu, if any */
+        struct tagWC_menuJob *job; /* in the stand-in an async callback is given, its job */
+#ifdef WC_MENU_STATS
+        WC_menuStats stats;     /* see WC_menu_get_stats */
+#endif
 } MenuItems;
 
+/* an async callback's run */
+typedef struct tagWC_menuJob
+{
+        MenuItems menuItems;    /* the stand-in the callback gets: userData_ptr, and queue for its changes */
+        WC_menuQueue changes;   /* what the callback pushed, applied by the menu as it comes */
+        cbf_ptr callback;       /* what runs */
+        struct tagWC_menuState *state; /* the menu it's for */
+        int item;               /* the item chosen, which the callback is given */
+        int index;              /* where that item is now, as items come and go; WC_NONE once it's gone */
+        int key;                /* what the callback returned */
+        volatile unsigned long status; /* WC_JOB_* */
+        volatile unsigned long cancelled; /* 1 = ESC was pressed, or the menu ended */
+} WC_menuJob;
+
+/* an item's text from getItem, kept while it's on-screen */
+typedef struct tagWC_menuRow
+{
+        int index;              /* the item, WC_NONE if the row is empty */
+        unsigned int used;      /* frame the row was last used in, oldest gets reused */
+        char *text;             /* WC_MENU_ROW_CAPACITY bytes */
+} WC_menuRow;
+
+/* word of a bitset */
+typedef unsigned long long WC_bits;
+#define WC_BITS_PER_WORD     64
+#define WC_BITS_WORD(index)  ((index) >> 6)
+#define WC_BITS_BIT(index)   ((WC_bits)1 << ((index) & 63))
+
+/* a fuzzy match, kept in a heap of the best ones */
+typedef struct tagWC_menuMatch
+{
+        int score;              /* higher is better */
+        int item;               /* the item that matched */
+} WC_menuMatch;
+
+#ifdef WC_MENU_THREADS
+/* threads that rank part of each chunk while the menu's thread does the rest */
+typedef struct tagWC_menuPool
+{
+        pthread_t threads[WC_MENU_THREADS];
+        pthread_mutex_t lock;
+        pthread_cond_t start;   /* signalled when there's a new chunk */
+        pthread_cond_t done;    /* signalled when the last thread finishes it */
+        struct tagWC_menuState *state; /* whose items the chunk is */
+        int first, last;        /* the chunk, split between the threads */
+        unsigned int job;       /* counts chunks, so threads can tell there's a new one */
+        int busy;               /* threads still on the chunk */
+        int numThreads;         /* threads started */
+        int numJoined;          /* threads that have picked a part number */
+        int quit;               /* 1 = threads exit */
+} WC_menuPool;
+#endif
+
+/* a menu's async callbacks, and the threads running them */
+typedef struct tagWC_menuJobs
+{
+        WC_menuJob jobs[WC_MENU_JOBS];
+        int numBusy;            /* jobs that aren't WC_JOB_FREE */
+#ifdef WC_MENU_THREADS
+        pthread_t threads[WC_MENU_JOB_THREADS];
+        pthread_mutex_t lock;
+        pthread_cond_t start;   /* signalled when a job is queued */
+        int numThreads;         /* threads started */
+        int quit;               /* 1 = threads exit */
+#endif
+} WC_menuJobs;
+
+/* everything a running menu keeps between frames */
+typedef struct tagWC_menuState
+{
+        MenuItems *menuItems;   /* the menu being run */
+        WC_menuFrame frame;     /* draw calls (and back-buffer) for the frame */
+        int numMenuItems;       /* items in menuItems->items */
+        int numMenuHeaders;     /* rows for the title and its padding */
+        int numMenuFooters;     /* rows of padding above the footer */
+        int numMenuStates;      /* entries in menuItems->states */
+        int numMenuCallbacks;   /* entries in menuItems->callbacks */
+        int numVisibleItems;    /* rows for items */
+        int titleLength;        /* strlen of the title */
+        int footerLength;       /* strlen of the footer */
+        int selectedItem;       /* item with the cursor on it, WC_NONE if nothing listed is enabled */
+        int selectedRow;        /* where selectedItem is in the list (the same unless filtering) */
+        int topItem;            /* row of the list on the 1st item row */
+        int itemOffset;         /* how far a too-wide selected item has scrolled */
+        int itemDirection;      /* which way it's scrolling, 0 = holding at an end */
+        int footerOffset;       /* how far the footer has scrolled */
+        WC_time startTime;      /* when the current scroll step started */
+        int result;             /* WC_MENU_PENDING, or what WC_menu returns once done */
+        WC_bits *enabled;       /* bit per item, set if the item is enabled */
+        WC_bits *enabledSummary;/* bit per word of enabled, set if the word has any bit set */
+        int numEnabledWords;    /* words in enabled */
+        WC_menuRow *rows;       /* with getItem, the recently drawn items */
+        int numRows;            /* entries in rows */
+        unsigned int frameNumber; /* frames rendered, to age rows */
+        int *lengths;           /* strlen of each item in items, WC_NONE until needed */
+        char **measured;        /* the text each of lengths was measured from */
+        int numLengths;         /* entries in lengths and measured */
+        int *sorted;            /* items in case-insensitive text order, 0 until a filter needs it */
+        char **indexed;         /* the text each item was sorted by */
+        int numSorted;          /* entries in sorted and indexed */
+        int *view;              /* while filtering, the items that match - in menu order, or best first if fuzzy */
+        int numView;            /* entries used in view */
+        int maxView;            /* entries allocated in view */
+        char filterText[WC_MENU_FILTER_CAPACITY]; /* what's been typed */
+        int filterLength;       /* strlen of filterText, 0 = not filtering */
+        int filterFirst[WC_MENU_FILTER_CAPACITY]; /* for each length typed, the matches are */
+        int filterLast[WC_MENU_FILTER_CAPACITY];  /* sorted[filterFirst] up to sorted[filterLast-1] */
+        char filterLower[WC_MENU_FILTER_CAPACITY]; /* filterText in lower case, for fuzzy matching */
+        WC_bits filterClasses;  /* WC_menu_char_classes of filterText */
+        WC_bits *classes;       /* WC_menu_char_classes of each item, to skip ones that can't match */
+        char **classified;      /* the text each of classes was worked out from */
+        int numClassified;      /* entries in classes and classified */
+        WC_menuMatch *matches;  /* a heap of the best matches for each worker, then room to sort them */
+        int numMatches[WC_MENU_WORKERS]; /* entries in each worker's heap */
+        int rankNext;           /* next item to rank, numMenuItems when done */
+        int rankFollow;         /* 1 = keep the cursor on the best match while ranking */
+        int autoSize;           /* WC_AUTO_ flags for what WC_menu_begin worked out */
+        int *widths;            /* with WC_AUTO_WIDTH, how many items are each length (up to sx), 0 until items change */
+        int numWidths;          /* entries in widths */
+        int maxLength;          /* the longest length counted in widths */
+        int inCallback;         /* 1 while a callback runs, which brings the menu up to date after it returns */
+        int itemsMoved;         /* 1 = items were inserted or removed, so the cursor's item has a new index */
+        unsigned int generation;/* counts changes made through the WC_menu_ functions (and WC_menu_invalidate) */
+        unsigned int refreshed; /* the generation the menu was last brought up to date with */
+        int dirtyFirst;         /* items changed since then are dirtyFirst to dirtyLast, */
+        int dirtyLast;          /* none if dirtyFirst > dirtyLast */
+        char **knownItems;      /* the items array as of then, so a callback that swaps it is noticed */
+#ifdef WC_MENU_THREADS
+        WC_menuPool *pool;      /* the ranking threads, 0 until needed */
+#endif
+        WC_menuJobs *jobs;      /* async callbacks, 0 until the first */
+} WC_menuState;
+
+/* a headless backend: plays a script of keys into the menu and records what its frames draw, see WC_menu_record_begin */
+typedef struct tagWC_menuRecorder
+{
+        MenuItems *menuItems;   /* the menu recorded, whose allocator the screen comes from */
+        const int *script;      /* keys pressed a frame at a time, 0 for a frame with none; ESC once it runs out */
+        int scriptLength;
+        int position;           /* the next key of the script */
+        char *screen;           /* sy by sx characters, as the frames have drawn them */
+        unsigned char *colors;  /* and their WC_CLR_ colours */
+        int sy, sx;
+        long frames;            /* frames shown */
+        WC_time firstFrame;     /* when the first was shown */
+        long spans;             /* spans drawn (drawFunction calls, without a drawBatchFunction) in them all */
+        long cells;             /* cells drawn in them all */
+        long keys;              /* keys pressed */
+        WC_time pressed;        /* when the last key was pressed, 0 once a frame has shown it */
+        WC_time latency;        /* from each key being pressed to the frame that shows it, added up */
+        WC_time latencyMax;     /* the longest of those */
+        unsigned long hash;     /* a hash (32 bit FNV-1a) of every span drawn, to tell runs apart */
+} WC_menuRecorder;
+
+#ifdef WC_MENU_TERMINAL
+/* a terminal the built-in backend draws on and reads keys from, see WC_menu_term_begin */
+typedef struct tagWC_menuTerminal
+{
+        int fd;                 /* the terminal, -1 to only encode frames into output */
+        MenuItems *menuItems;   /* the menu drawn, whose allocator output comes from */
+        int colors[WC_CLR_BUSY+1][2]; /* SGR foreground and background for each WC_CLR_ colour */
+        char *output;           /* the frame encoded so far */
+        int used;               /* bytes in output */
+        int capacity;           /* bytes output can hold */
+        int y, x;               /* where the cursor is, WC_NONE if not known */
+        int foreground;         /* SGR colours last set, WC_NONE if not known */
+        int background;
+        unsigned char pending[8]; /* the start of an escape sequence the next read finishes */
+        int numPending;         /* bytes in pending */
+        int isRaw;              /* 1 = saved holds the settings to put back */
+        struct termios saved;   /* the terminal's settings before WC_menu_term_begin */
+        long frames;            /* frames written */
+        long bytes;             /* bytes written */
+        long writes;            /* write calls made for them */
+        long dropped;           /* bytes left out because output couldn't grow */
+} WC_menuTerminal;
+#endif
+
 /* not the right way to do min/max but works for the menu */
 #define WC_menu_max(a,b) ((a) > (b) ? (a) : (b))
 #define WC_menu_min(a,b) ((a) < (b) ? (a) : (b))
+/* size rounded up to whole arena blocks, so the next block stays aligned */
+#define WC_menu_arena_round(size) (((size) + sizeof(WC_menuArenaBlock) - 1) / sizeof(WC_menuArenaBlock) * sizeof(WC_menuArenaBlock))
+/* lower case for ASCII, so filtering doesn't depend on the locale */
+#define WC_menu_lower(c) ((c) >= 'A' && (c) <= 'Z' ? (c) - 'A' + 'a' : (c))
+/* a bit for the class of (lower case) character c: each letter and digit, the rest share 28 bits */
+#define WC_menu_char_class(c) ((WC_bits)1 << ((c) >= 'a' && (c) <= 'z' ? (c) - 'a' : (c) >= '0' && (c) <= '9' ? (c) - '0' + 26 : 36 + (c) % 28))
     
 /*--------------------------------------------------------------------------*\
   internal functions used by the menu system
 \*--------------------------------------------------------------------------*/
-/* gets lenth of longest item in array "items" */
-WC_INTERNAL int WC_menu_maxItemLength(char **items);
+/* gets lenth of longest of the first numItems items */
+WC_INTERNAL int WC_menu_maxItemLength(WC_menuState *state, int numItems);
+/* the text of item index, from items or getItem */
+WC_INTERNAL char *WC_menu_item_text(WC_menuState *state, int index);
+/* 1 if item index is enabled */
+WC_INTERNAL int WC_menu_item_enabled(WC_menuState *state, int index);
+/* forgets getItem text of items first to last, for when they may have changed */
+WC_INTERNAL void WC_menu_forget_rows(WC_menuState *state, int first, int last);
+/* strlen of item index, from the lengths cache */
+WC_INTERNAL int WC_menu_item_length(WC_menuState *state, int index);
+/* forgets cached lengths of items first to last, and makes room for all the items */
+WC_INTERNAL void WC_menu_forget_lengths(WC_menuState *state, int first, int last);
 /* counts the number of pointers in a 0 terminated array (of pointer sized elements) */
 WC_INTERNAL int WC_menu_len(void *array);
 /* counts the number of int's in a null-terminated array (of int-sized elements) */
 WC_INTERNAL int WC_menu_count(void *array);
+/* how many items/states/callbacks there are, from numItems etc. or else by counting */
+WC_INTERNAL int WC_menu_num_items(MenuItems *menuItems);
+WC_INTERNAL int WC_menu_num_states(MenuItems *menuItems);
+WC_INTERNAL int WC_menu_num_callbacks(MenuItems *menuItems);
+/* refreshes the item/state/callback counts the running menu works with */
+WC_INTERNAL void WC_menu_recount(WC_menuState *state);
+/* index of the lowest/highest set bit in a non-zero word */
+WC_INTERNAL int WC_menu_lowest_bit(WC_bits bits);
+WC_INTERNAL int WC_menu_highest_bit(WC_bits bits);
+/* (re)builds the enabled bitset from the states array */
+WC_INTERNAL void WC_menu_build_enabled(WC_menuState *state);
+/* sets or clears bits first to last in the enabled bitset and keeps the summary right */
+WC_INTERNAL void WC_menu_set_enabled(WC_menuState *state, int first, int last, int enabled);
 /* finds the next item in "status" that has a 1 from selectedItem in direction (1 or -1) */
-/* returns -1 or len(menuItems->states) if it runs off the end of the list */
-WC_INTERNAL int WC_menu_next_item(MenuItems *menuItems, int selectedItem, int direction);
+/* returns -1 or the number of items if it runs off the end of the list */
+WC_INTERNAL int WC_menu_next_item(WC_menuState *state, int selectedItem, int direction);
+/* records a draw call in the frame, to be handed to the program by WC_menu_flush */
+WC_INTERNAL void WC_menu_emit(WC_menuFrame *frame, int y, int x, char *string, int length, int color);
+/* hands the recorded frame to drawBatchFunction (or drawFunction per span) and empties it */
+WC_INTERNAL void WC_menu_flush(MenuItems *menuItems, WC_menuFrame *frame);
+/* draws the frame's spans into the back-buffer and replaces them with spans for only the changed cells */
+WC_INTERNAL void WC_menu_diff(MenuItems *menuItems, WC_menuFrame *frame);
+/* length of the selected item's text, 0 if it's gone */
+WC_INTERNAL int WC_menu_selected_length(WC_menuState *state);
+/* stops the menu with result (an item or WC_ERROR_*) and returns what WC_menu_step should */
+WC_INTERNAL int WC_menu_finish(WC_menuState *state, int result);
+/* turns state->result into a WC_menu_step return value */
+WC_INTERNAL int WC_menu_status(WC_menuState *state);
+/* moves a selected item that's too wide for the menu back and forth by ticks steps */
+WC_INTERNAL void WC_menu_scroll_item(int *itemOffset, int *itemDirection, int displayLength, int width, WC_time ticks);
+/* malloc/realloc/free through menuItems' allocation functions, if it has them (menuItems can be 0) */
+WC_INTERNAL void *WC_menu_heap_alloc(MenuItems *menuItems, size_t size);
+WC_INTERNAL void *WC_menu_heap_resize(MenuItems *menuItems, void *ptr, size_t size);
+WC_INTERNAL void WC_menu_heap_free(MenuItems *menuItems, void *ptr);
+/* a heap copy of text with the menu's mallocFunction; 0 for 0 */
+WC_INTERNAL char *WC_menu_heap_strdup(MenuItems *menuItems, const char *text);
+/* starts a new arena chunk with room for at least size bytes of blocks; 0 if out of memory */
+WC_INTERNAL int WC_menu_arena_grow(MenuItems *menuItems, size_t size);
+/* a block of size bytes from the menu's arena, starting a new chunk if needed */
+WC_INTERNAL void *WC_menu_arena_alloc(MenuItems *menuItems, size_t size);
+/* 1 if ptr is the block most recently handed out by the menu's arena */
+WC_INTERNAL int WC_menu_arena_last(MenuItems *menuItems, void *ptr);
+/* 1 if ptr is in one of the menu's arena chunks */
+WC_INTERNAL int WC_menu_arena_owns(MenuItems *menuItems, const void *ptr);
+/* gives back text the menu owns: an arena copy, or after WC_menu_take_ownership a heap one */
+WC_INTERNAL void WC_menu_free_text(MenuItems *menuItems, char *text);
+/* the free list for an arena block of capacity bytes */
+WC_INTERNAL int WC_menu_arena_bin(size_t capacity);
+/* gives an arena block back: the newest shrinks its chunk, others go on a free list */
+WC_INTERNAL void WC_menu_arena_release(MenuItems *menuItems, void *ptr);
+/* a given back block with room for capacity bytes, off its free list; 0 if there isn't one */
+WC_INTERNAL void *WC_menu_arena_reuse(MenuItems *menuItems, size_t capacity);
+/* array if it's in the arena already, or else a 0-terminated copy of its count entries of size bytes there; 0 if out of memory */
+WC_INTERNAL void *WC_menu_own_array(MenuItems *menuItems, void *array, int count, size_t size);
+/* forgets what a running menu worked out from item index's text, which may be new text at the same address */
+WC_INTERNAL void WC_menu_forget_item(WC_menuState *state, int index);
+/* forgets what a running menu worked out from the text of items first on, after items moved */
+WC_INTERNAL void WC_menu_forget_items(WC_menuState *state, int first);
+/* FNV-1a hash of text, and its length */
+WC_INTERNAL unsigned int WC_menu_hash(const char *text, size_t *length);
+/* malloc/free through an intern pool's allocation functions, if it has them */
+WC_INTERNAL void *WC_menu_intern_alloc(WC_menuIntern *pool, size_t size);
+WC_INTERNAL void WC_menu_intern_release(WC_menuIntern *pool, void *ptr);
+/* 1 if ptr is text in the pool */
+WC_INTERNAL int WC_menu_intern_owns(WC_menuIntern *pool, const void *ptr);
+/* makes room in an intern pool for count more strings of bytes in all, so interning them can't fail; 0 if out of memory */
+WC_INTERNAL int WC_menu_intern_reserve(WC_menuIntern *pool, int count, size_t bytes);
+/* records that items first to last changed (items is the array before the change), for WC_menu_refresh */
+WC_INTERNAL void WC_menu_changed(WC_menuState *state, char **items, int first, int last);
+/* atomic load (acquire), store (release) and compare-and-swap of a queue position */
+WC_INTERNAL unsigned long WC_menu_atomic_load(volatile unsigned long *value);
+WC_INTERNAL void WC_menu_atomic_store(volatile unsigned long *value, unsigned long set);
+WC_INTERNAL int WC_menu_atomic_cas(volatile unsigned long *value, unsigned long *expected, unsigned long set);
+/* empties a queue, using capacity (a power of 2) events */
+WC_INTERNAL void WC_menu_queue_reset(WC_menuQueue *queue, WC_menuEvent *events, unsigned long capacity);
+/* applies the events waiting in a queue, like a callback's changes; a job's own item's go where it is now */
+WC_INTERNAL void WC_menu_drain(WC_menuState *state, WC_menuQueue *queue, WC_menuJob *job);
+/* 1 if callback is in menuItems->asyncCallbacks */
+WC_INTERNAL int WC_menu_is_async(MenuItems *menuItems, cbf_ptr callback);
+/* the job running item index's callback, 0 if there isn't one */
+WC_INTERNAL WC_menuJob *WC_menu_item_job(WC_menuState *state, int index);
+/* starts callback for item in a job, on a thread if there are any; 0 if it can't */
+WC_INTERNAL int WC_menu_job_start(WC_menuState *state, cbf_ptr callback, int item);
+/* runs a job's callback, on whichever thread it's on */
+WC_INTERNAL void WC_menu_job_run(WC_menuJob *job);
+/* takes in what jobs' callbacks changed and frees those that finished; returns the keys they pressed */
+WC_INTERNAL int WC_menu_jobs_collect(WC_menuState *state);
+/* tells every job still going to stop; how many were */
+WC_INTERNAL int WC_menu_jobs_cancel(WC_menuState *state);
+/* keeps jobs on their items after count items were inserted at first (or -count removed) */
+WC_INTERNAL void WC_menu_jobs_move(WC_menuState *state, int first, int count);
+/* cancels the jobs, waits for their callbacks to return and frees them */
+WC_INTERNAL void WC_menu_jobs_end(WC_menuState *state);
+/* grows an array in the arena to room for count entries of size bytes, at least doubling it; 0 if out of memory */
+WC_INTERNAL void *WC_menu_grow_array(MenuItems *menuItems, void *array, int used, int count, size_t size);
+/* 1 if the running menu counts items of each length to keep its width, starting the count if needed */
+WC_INTERNAL int WC_menu_track_widths(WC_menuState *state);
+/* adds count (1 or -1) items of length to widths, keeping maxLength */
+WC_INTERNAL void WC_menu_count_width(WC_menuState *state, int length, int count);
+/* works out again what WC_menu_begin worked out of the menu's position and size */
+WC_INTERNAL void WC_menu_fit(WC_menuState *state);
+/* brings a running menu up to date after a callback (or a WC_menu_ function that edits menus) changed it; 0 if no items are left */
+WC_INTERNAL int WC_menu_refresh(WC_menuState *state, int *states, int numMenuItems, int numMenuStates);
+/* rows in the list, which is all the items unless filtering */
+WC_INTERNAL int WC_menu_num_rows(WC_menuState *state);
+/* the item shown on a row of the list */
+WC_INTERNAL int WC_menu_row_item(WC_menuState *state, int row);
+/* WC_menu_next_item for rows of the list; returns -1 or the number of rows off the ends */
+WC_INTERNAL int WC_menu_next_row(WC_menuState *state, int row, int direction);
+/* puts the cursor on item if it's listed and enabled, or else the nearest enabled row */
+WC_INTERNAL void WC_menu_select_item(WC_menuState *state, int item);
+/* puts the cursor on the enabled row nearest row, looking in direction first, and */
+/* makes sure it's on-screen; 0 if no row is enabled */
+WC_INTERNAL int WC_menu_select_near(WC_menuState *state, int row, int direction);
+/* strcmp, ignoring ASCII case */
+WC_INTERNAL int WC_menu_compare_nocase(const char *a, const char *b);
+/* sorts item indices by their text, ignoring case.  Stable, temp has room for count */
+WC_INTERNAL void WC_menu_sort_index(char **items, int *sorted, int *temp, int count);
+/* sorts the items into state->sorted for filtering; 0 if out of memory */
+WC_INTERNAL int WC_menu_build_index(WC_menuState *state);
+/* frees the sorted index, to be built again when next needed */
+WC_INTERNAL void WC_menu_forget_index(WC_menuState *state);
+/* after a callback, re-sorts items first to last given new text, and any added on the end, */
+/* or drops the index if it can't tell */
+WC_INTERNAL void WC_menu_sync_index(WC_menuState *state, int first, int last);
+/* narrows sorted[*first] to sorted[*last-1] to the items with (lower case) c at position length */
+WC_INTERNAL void WC_menu_prefix_range(WC_menuState *state, int length, int c, int *first, int *last);
+/* qsort comparison for item indices */
+WC_INTERNAL int WC_menu_compare_int(const void *a, const void *b);
+/* makes the view the items in sorted[first] to sorted[last-1], in menu order */
+WC_INTERNAL void WC_menu_view_range(WC_menuState *state, int first, int last);
+/* adds c to the filter, narrowing the list; 0 if it can't */
+WC_INTERNAL int WC_menu_filter_add(WC_menuState *state, int c);
+/* works out the list again for the whole filter, after the items changed */
+WC_INTERNAL void WC_menu_filter_apply(WC_menuState *state);
+/* makes room for count entries in the view; 0 if out of memory */
+WC_INTERNAL int WC_menu_view_room(WC_menuState *state, int count);
+/* WC_menu_char_class of every character of text, or'd together */
+WC_INTERNAL WC_bits WC_menu_char_classes(const char *text);
+/* how well text matches (lower case) query, in order but not necessarily together; -1 if not at all */
+WC_INTERNAL int WC_menu_fuzzy_score(const char *text, const char *query);
+/* adds a match to a heap of at most WC_MENU_FUZZY_TOP, if it's better than the worst */
+WC_INTERNAL void WC_menu_match_push(WC_menuMatch *heap, int *count, int score, int item);
+/* qsort comparison putting better matches first */
+WC_INTERNAL int WC_menu_compare_match(const void *a, const void *b);
+/* (re)starts fuzzy ranking for filterText, dropping whatever was being ranked */
+WC_INTERNAL void WC_menu_rank_start(WC_menuState *state);
+/* worker's part of ranking items first to last-1, into its heap */
+WC_INTERNAL void WC_menu_rank_part(WC_menuState *state, int worker, int first, int last);
+/* ranks chunks until the items run out or it's time until, then lists the best so far */
+WC_INTERNAL void WC_menu_rank(WC_menuState *state, WC_time until);
+#ifdef WC_MENU_THREADS
+/* ranks first to last-1 with the help of the pool's threads, starting them if needed */
+WC_INTERNAL void WC_menu_pool_rank(WC_menuState *state, int first, int last);
+/* a pool thread, ranking its part of each chunk */
+WC_INTERNAL void *WC_menu_pool_thread(void *arg);
+/* stops the pool's threads and frees it */
+WC_INTERNAL void WC_menu_pool_end(WC_menuState *state);
+/* a job thread, running queued jobs until the menu ends */
+WC_INTERNAL void *WC_menu_job_thread(void *arg);
+#endif
+#ifdef WC_MENU_TERMINAL
+/* adds length bytes to the terminal's output, growing it with the menu's allocator; 0 if it can't */
+WC_INTERNAL int WC_menu_term_put(WC_menuTerminal *term, const char *bytes, int length);
+/* ESC [ count final into buffer, leaving out a count of 1; returns its length */
+WC_INTERNAL int WC_menu_term_csi(char *buffer, int count, char final);
+/* the shortest way from the cursor to y, x into buffer; returns its length */
+WC_INTERNAL int WC_menu_term_move(WC_menuTerminal *term, char *buffer, int y, int x);
+/* the key an escape sequence's final part (after ESC [ or ESC O) stands for, 0 if none */
+WC_INTERNAL int WC_menu_term_escape_key(const unsigned char *sequence, int length);
+#endif
+#ifdef WC_MENU_STATS
+/* the histogram bucket a time falls in */
+WC_INTERNAL int WC_menu_stats_bucket(WC_time time);
+/* appends ,"name":[values] to the JSON in buffer, which is length long; returns the new length */
+WC_INTERNAL int WC_menu_stats_array(char *buffer, int capacity, int length, const char *name, const long *values, int count);
+/* counts a key given to WC_menu_step, by what it does */
+WC_INTERNAL void WC_menu_stats_key(WC_menuStats *stats, int key);
+/* counts a frame's spans and characters, as handed to the program */
+WC_INTERNAL void WC_menu_stats_spans(WC_menuStats *stats, WC_menuFrame *frame);
+/* counts a frame whose WC_menu_render started at started, and the latency of the keys it shows */
+WC_INTERNAL void WC_menu_stats_frame(WC_menuStats *stats, WC_time started);
+#endif
 
 /*--------------------------------------------------------------------------*\
   user callable functions
@@ -143,15 +828,214 @@ WC_GLOBAL void WC_menuInit(MenuItems *menuItems);
 /* 
    clone all of the elements in a menuItems, in place, so the 
    memory belongs to this menuItems.  Sets selfOwnsMemory to 1.
-   only call if a callback will make changes to the menuItems
+   only call if a callback will make changes to the menuItems.
+   The title, footer, items' text and the arrays are copied with the
+   menu's mallocFunction (or malloc), so a callback can free() an item
+   and put malloc'd text in its place, or realloc() the arrays, and
+   WC_menu_cleanup frees it all.  Text WC_menu_set_item and
+   WC_menu_insert_items copy in later is the heap's too, unless it's
+   from an intern pool.  Calling it again does nothing
 */
 WC_GLOBAL void WC_menu_take_ownership(MenuItems *menuItems);
 /* 
-   if selfOwnsMemory is 1, calls free on alloc'd memory, in other
-   words, this only needs to be called if WC_menu_take_ownership
-   was called, meaning a callback made changes to menuItems 
+   copies the items, states and callbacks arrays into the menu's arena,
+   so a callback can change, add or remove entries.  Sets selfOwnsMemory
+   to 1.  Arrays already copied aren't copied again, so it's cheap to
+   call from every callback that adds or removes items.  Callbacks that
+   only change some items' text or states don't need this, see
+   WC_menu_set_item and WC_menu_set_states.
+   Unlike WC_menu_take_ownership the text isn't copied: title, footer
+   and the items[i] the program gave stay the program's, and the menu
+   keeps pointing at them, so they must stay alive (and unchanged,
+   unless WC_menu_invalidate is told) until WC_menu_cleanup.  Only text
+   the menu copies itself (see WC_menu_set_item) is its own, and that's
+   in the arena, so don't free() text or arrays of a menu set up this
+   way; use WC_menu_set_item and WC_menu_insert_items
+*/
+WC_GLOBAL void WC_menu_own_arrays(MenuItems *menuItems);
+/* 
+   if selfOwnsMemory is 1, frees the menu's arena and what's in it (the
+   arrays and text the menu copied), in other words, this only needs to
+   be called if WC_menu_take_ownership, WC_menu_own_arrays,
+   WC_menu_set_item or the like was called, meaning a callback made
+   changes to menuItems.  After WC_menu_take_ownership, the title,
+   footer, items' text and arrays that aren't the arena's are freed with
+   the freeFunction (or free) too; otherwise they're the program's and
+   aren't freed
 */
 WC_GLOBAL void WC_menu_cleanup(MenuItems *menuItems);
+/*
+   allocate memory for a menu.  Once the menu owns its memory (see
+   WC_menu_own_arrays) this comes from the menu's arena, and
+   callbacks should use these for anything they put in the menu.
+   Freed arena blocks are reused for later allocations of about their
+   size (a block moved by WC_menu_realloc is freed too), but they're
+   never split or joined, so a menu whose allocations keep changing size
+   can still grow its arena; it all goes in one go in WC_menu_cleanup.
+   Memory these gave before the menu owned its memory stays the heap's:
+   WC_menu_realloc resizes it there and WC_menu_free leaves it alone, as
+   it does the program's own text, so free that with the menu's
+   freeFunction (or free) instead.  Otherwise these use the
+   mallocFunction etc. (or malloc etc.) directly
+*/
+WC_GLOBAL void *WC_menu_malloc(MenuItems *menuItems, size_t size);
+WC_GLOBAL void *WC_menu_realloc(MenuItems *menuItems, void *ptr, size_t size);
+WC_GLOBAL void WC_menu_free(MenuItems *menuItems, void *ptr);
+/* strdup with WC_menu_malloc; 0 for 0 */
+WC_GLOBAL char *WC_menu_strdup(MenuItems *menuItems, const char *string);
+/*
+   an intern pool keeps one copy of each string it's given, so menus with
+   menuItems->intern set to it share labels (WC_menu_set_item and
+   WC_menu_insert_items take their copies from it) and the same text is
+   always the same pointer.  Setting an item to text it's had before
+   allocates nothing.  The pool's lookups, hits, bytes and bytesSaved say
+   how well it's doing.  It outlives the menus using it;
+   WC_menu_intern_free frees it, after which they mustn't be shown
+*/
+WC_GLOBAL void WC_menu_intern_init(WC_menuIntern *pool);
+/* the pool's copy of text, adding it if it's new; 0 if out of memory.  Don't change it */
+WC_GLOBAL char *WC_menu_intern(WC_menuIntern *pool, const char *text);
+WC_GLOBAL void WC_menu_intern_free(WC_menuIntern *pool);
+/*
+   a queue lets other threads change a running menu: they push
+   WC_EVENT_APPEND, WC_EVENT_UPDATE and WC_EVENT_STATE events, and the
+   menu (with menuItems->queue set to it) applies what's waiting at the
+   start of each WC_menu_step, all in one go and without waiting for
+   anyone.  Pushing never blocks either; it returns 0 if the queue is
+   full.  Events from one thread are applied in the order pushed.
+   capacity is rounded up to a power of 2.  The events are allocated with
+   menuItems' allocator (0 for malloc), so set that (if any) first.
+   Returns 0 if out of memory
+*/
+WC_GLOBAL int WC_menu_queue_init(WC_menuQueue *queue, MenuItems *menuItems, int capacity);
+/* pushes an event, from any thread; text (for APPEND and UPDATE) is copied, cut short at WC_MENU_EVENT_TEXT */
+WC_GLOBAL int WC_menu_queue_push(WC_menuQueue *queue, int type, int index, const char *text, int state);
+WC_GLOBAL void WC_menu_queue_free(WC_menuQueue *queue);
+/*
+   callbacks listed in menuItems->asyncCallbacks run in the background:
+   ENTER hands the item to a job, the item shows as busy (menuItems->busyColor) and
+   the menu keeps running.  The callback gets a stand-in menu, not the
+   real one, and mustn't touch anything but its userData_ptr; it makes
+   its changes by pushing events to its queue (WC_menu_queue_push(
+   menuItems->queue, ...)), which the menu applies as they come.  Events
+   for the index it was given go to that item wherever it's moved to, and
+   are dropped once it's removed; other indices are taken as the menu is
+   when they're applied.  What it returns is pressed like any callback's
+   key when it's done.  ESC while
+   jobs run cancels them: this is then 1 and what they do after is
+   ignored.  With WC_MENU_THREADS defined they run on
+   WC_MENU_JOB_THREADS threads, otherwise right away on the menu's thread.
+   A job's queue holds WC_MENU_JOB_EVENTS (64) events: on a thread a
+   push to a full one returns 0 until the menu takes them in (each
+   WC_menu_step), so push again later rather than straight away; on the
+   menu's thread the menu takes them in there and then, so pushes don't
+   fail
+*/
+WC_GLOBAL int WC_menu_cancelled(MenuItems *menuItems);
+/* 1 if item index's async callback is still running */
+WC_GLOBAL int WC_menu_item_busy(WC_menuState *state, int index);
+/*
+   calls menuItems->drawFunction for each span.  This is what the menu
+   does when there's no drawBatchFunction, and a batch function can
+   call it for spans it doesn't want to handle itself
+*/
+WC_GLOBAL void WC_menu_draw_spans(MenuItems *menuItems, WC_menuSpan *spans, int numSpans);
+/*
+   sets states first to last (inclusive) to state (WC_ENABLED or
+   WC_DISABLED) in one go.  While the menu runs, this is how callbacks
+   should enable/disable runs of items as it only updates the words of
+   the menu's enabled-bitset it touches.  The first time, the states
+   array is copied into the menu's arena rather than written
+*/
+WC_GLOBAL void WC_menu_set_states(MenuItems *menuItems, int first, int last, int state);
+/*
+   gives item index (which must be an item) a copy of text, returning
+   0 if it can't.  The first time, the items array (but none of the
+   text) is copied into the menu's arena, and after that only the text
+   set is copied.  Setting the same item again reuses its copy if the
+   new text fits, and otherwise gives it back for reuse
+*/
+WC_GLOBAL int WC_menu_set_item(MenuItems *menuItems, int index, const char *text);
+/* sets the state of item index, see WC_menu_set_states */
+WC_GLOBAL void WC_menu_set_state(MenuItems *menuItems, int index, int state);
+/*
+   tells a running menu that items first to last (inclusive) changed
+   in a way none of the functions here did: text rewritten in place or
+   pointed somewhere else, states written directly, or what
+   getItem/getState give for them.  Only those items are measured,
+   sorted and fetched again.  With numItems given, a callback that makes
+   such changes must say so with this, since the menu doesn't look for
+   changes nobody told it about
+*/
+WC_GLOBAL void WC_menu_invalidate(MenuItems *menuItems, int first, int last);
+/*
+   inserts count items before item index (0 to the number of items), with
+   copies of their text, keeping the states and callbacks arrays in step
+   (and numItems etc. if given).  states and callbacks can be 0 for
+   enabled items without callbacks.  The arrays are copied into the
+   menu's arena the first time (see WC_menu_own_arrays) and at least
+   double when they grow, and a running menu's cursor stays on the item
+   it was on.  Returns 0 if it can't
+*/
+WC_GLOBAL int WC_menu_insert_items(MenuItems *menuItems, int index, char **items, int *states, cbf_ptr *callbacks, int count);
+/* inserts one item, see WC_menu_insert_items */
+WC_GLOBAL int WC_menu_insert_item(MenuItems *menuItems, int index, const char *text, int state, cbf_ptr callback);
+/* removes count items from item index on, with their states and callbacks; 0 if there aren't that many */
+WC_GLOBAL int WC_menu_remove_items(MenuItems *menuItems, int index, int count);
+/* removes item index, see WC_menu_remove_items */
+WC_GLOBAL int WC_menu_remove_item(MenuItems *menuItems, int index);
+/*
+   sets menuItems->jumpItem to index and returns WC_INPUT_KEY_JUMP, so
+   a callback can "return WC_menu_jump(menuItems, index);" to move the
+   cursor to item index (or the nearest enabled item to it).  A program
+   can also call it and pass the result to WC_menu_step
+*/
+WC_GLOBAL int WC_menu_jump(MenuItems *menuItems, int index);
+/* 
+   returns the time, in nanoseconds, from a monotonic clock
+*/
+WC_GLOBAL WC_time WC_menu_now(void);
+/*
+   a waitFunction that blocks until there's keyboard input (stdin on
+   Linux/OS X, the message queue on Windows) or timeout nanoseconds
+   have passed.  WC_WAIT_FOREVER waits for input only
+*/
+WC_GLOBAL void WC_menu_wait_input(WC_time timeout);
+/*
+   sets up state to run the menu without giving up control, as an
+   alternative to WC_menu.  Returns 0, or a WC_ERROR if the menu
+   can't be shown.  Call WC_menu_end when done, even after an error.
+   With several states, several menus can be run from one loop
+*/
+WC_GLOBAL int WC_menu_begin(MenuItems *menuItems, WC_menuState *state);
+/*
+   moves the menu's scrolling on to time now (from WC_menu_now) and acts
+   on key (WC_INPUT_* bits, or 0), which may call a callback.  Returns
+   WC_MENU_RUNNING, WC_MENU_SELECTED (the item is in state->result),
+   WC_MENU_CANCEL or another WC_ERROR
+*/
+WC_GLOBAL int WC_menu_step(WC_menuState *state, int key, WC_time now);
+/*
+   WC_menu_step with each of numKeys keys in turn (or once with 0 if
+   there are none), stopping if the menu finishes, so a burst of input
+   costs one WC_menu_render rather than one per key.  Returns what the
+   last WC_menu_step did
+*/
+WC_GLOBAL int WC_menu_step_keys(WC_menuState *state, const int *keys, int numKeys, WC_time now);
+/*
+   draws the menu as it is now, through drawFunction/drawBatchFunction,
+   then calls showFunction
+*/
+WC_GLOBAL void WC_menu_render(WC_menuState *state);
+/*
+   returns the WC_menu_now time when the menu next needs a WC_menu_step
+   and WC_menu_render to scroll, or WC_WAIT_FOREVER if nothing scrolls
+*/
+WC_GLOBAL WC_time WC_menu_next_deadline(WC_menuState *state);
+/*
+   frees what the menu allocated while it ran
+*/
+WC_GLOBAL void WC_menu_end(WC_menuState *state);
 /* 
    shows a menu and returns user choice or error.  the menu
    item chose, if done, is 0 based from the first option. 
@@ -159,6 +1043,101 @@ WC_GLOBAL void WC_menu_cleanup(MenuItems *menuItems);
    defined/explained by the WC_ERROR defiens
 */
 WC_GLOBAL int WC_menu(MenuItems *menuItems);
+#ifdef WC_MENU_STATS
+/*
+   copies what menuItems' menu has done, since WC_menuInit or
+   WC_menu_reset_stats, into stats.  Counts go on from one run of the
+   menu to the next.  Read from another thread than the menu's, a frame
+   may be half counted
+*/
+WC_GLOBAL void WC_menu_get_stats(MenuItems *menuItems, WC_menuStats *stats);
+/* zeroes menuItems' stats */
+WC_GLOBAL void WC_menu_reset_stats(MenuItems *menuItems);
+/*
+   writes stats as a line of JSON into buffer, cut short (but 0
+   terminated) past capacity bytes.  Returns the length the whole line
+   needs, as snprintf does.  Times are in nanoseconds; the histograms are
+   arrays of counts, and "bucketsUs" gives the microseconds each bucket
+   but the last is under
+*/
+WC_GLOBAL int WC_menu_stats_json(const WC_menuStats *stats, char *buffer, int capacity);
+#endif
+/*
+   sets up rec to run menuItems' menu with no screen, pressing the
+   scriptLength keys in script (0 for none) one a frame, then ESC.  Unless
+   sy and sx are set already the screen is 24 by 80.  The screen is
+   allocated with menuItems' allocator, so set that (if any) first.
+   Returns 0, or -1 if there's no memory
+*/
+WC_GLOBAL int WC_menu_record_begin(WC_menuRecorder *rec, MenuItems *menuItems, const int *script, int scriptLength);
+/* frees the screen */
+WC_GLOBAL void WC_menu_record_end(WC_menuRecorder *rec);
+/*
+   makes WC_menu run on rec, by setting its menu's drawContext to it,
+   and its inputMenuFunction, drawBatchFunction and showMenuFunction, and
+   clearing its readEvents and wait functions so it runs as fast as it
+   can.  Each menu finds its own rec, so any number can run at once
+*/
+WC_GLOBAL void WC_menu_record_use(WC_menuRecorder *rec);
+/* draws spans on rec's screen, counting and hashing them */
+WC_GLOBAL void WC_menu_record_spans(WC_menuRecorder *rec, WC_menuSpan *spans, int numSpans);
+/* the inputMenuFunction, drawBatchFunction and showMenuFunction WC_menu_record_use sets */
+WC_GLOBAL int WC_menu_record_input(MenuItems *menuItems);
+WC_GLOBAL void WC_menu_record_draw(MenuItems *menuItems, WC_menuSpan *spans, int numSpans);
+WC_GLOBAL void WC_menu_record_show(MenuItems *menuItems);
+#ifdef WC_MENU_TERMINAL
+/*
+   sets up term for menuItems' menu on terminal fd (0 for the one the
+   program runs in).  A tty is put in raw mode and, unless sy and sx are
+   set already, gives menuItems its size.  The first frame starts by
+   hiding the cursor and clearing the screen.  With fd -1 frames are only
+   encoded into term->output, for a program with its own output (see
+   WC_menu_term_spans).  Set up menuItems' allocator (if any) first.
+   Returns 0, or -1 if the output can't be allocated or the tty's
+   settings can't be read
+*/
+WC_GLOBAL int WC_menu_term_begin(WC_menuTerminal *term, MenuItems *menuItems, int fd);
+/* writes what's left, puts the terminal back as WC_menu_term_begin found it and frees the output */
+WC_GLOBAL void WC_menu_term_end(WC_menuTerminal *term);
+/*
+   makes WC_menu draw on and read keys from term, by setting term's menu's
+   drawContext to it, and its drawBatchFunction, showMenuFunction,
+   readMenuEvents, waitMenuFunction and useBackBuffer.  Each menu finds
+   its own terminal, so any number can run at once
+*/
+WC_GLOBAL void WC_menu_term_use(WC_menuTerminal *term);
+/*
+   encodes spans into term->output: the cursor moves whichever way is
+   shortest, colours are only set when they change, and wide padding is
+   erased rather than written.  Adjacent spans of a colour run on
+   without either
+*/
+WC_GLOBAL void WC_menu_term_spans(WC_menuTerminal *term, WC_menuSpan *spans, int numSpans);
+/* writes term->output with one write (more only if the terminal takes part of it); 0 if it can't */
+WC_GLOBAL int WC_menu_term_flush(WC_menuTerminal *term);
+/* turns length bytes read from the terminal into keys (at most length); returns how many */
+WC_GLOBAL int WC_menu_term_keys(WC_menuTerminal *term, const unsigned char *bytes, int length, int *keys);
+/* the drawBatchFunction, showMenuFunction, readMenuEvents and waitMenuFunction WC_menu_term_use sets */
+WC_GLOBAL void WC_menu_term_draw(MenuItems *menuItems, WC_menuSpan *spans, int numSpans);
+WC_GLOBAL void WC_menu_term_show(MenuItems *menuItems);
+WC_GLOBAL int WC_menu_term_read_events(MenuItems *menuItems, int *keys, int max);
+WC_GLOBAL void WC_menu_term_wait(MenuItems *menuItems, WC_time timeout);
+#endif
+#ifdef WC_MENU_CURSES
+/*
+   makes the menu draw on curses' stdscr, by setting menuItems'
+   drawFunction and showFunction.  Colours are the curses colour pairs
+   of the same number, which the program sets up with init_pair
+*/
+WC_GLOBAL void WC_menu_curses_use(MenuItems *menuItems);
+/*
+   drawFunction: the string, padded out with spaces to length, at y, x.
+   The colour pair is only set when it changes
+*/
+WC_GLOBAL void WC_menu_curses_draw(int y, int x, char *string, int length, int color);
+/* showFunction: puts the frame on the screen with wnoutrefresh and doupdate */
+WC_GLOBAL void WC_menu_curses_show(void);
+#endif
 
 #if defined(__cplusplus) || defined(__cplusplus__) || defined(__CPLUSPLUS)
 }
@@ -172,6 +1151,15 @@ WC_GLOBAL int WC_menu(MenuItems *menuItems);
 #ifndef WC_MENU_IMPLEMENTATION
 #define WC_MENU_IMPLEMENTATION
 
+/* the single character strings drawn around items.  Spans point in here */
+/* so these have to outlive the frame, unlike a local buffer would */
+WC_GLOBAL char WC_gMenuMarks[] = " \0>\0<\0^\0v";
+#define WC_MARK_BLANK        (&WC_gMenuMarks[0])
+#define WC_MARK_OPEN         (&WC_gMenuMarks[2])
+#define WC_MARK_CLOSE        (&WC_gMenuMarks[4])
+#define WC_MARK_MORE_UP      (&WC_gMenuMarks[6])
+#define WC_MARK_MORE_DOWN    (&WC_gMenuMarks[8])
+
 /* define clock_gettime for windows and a platform specific time diff function */
 #if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
 
@@ -194,43 +1182,187 @@ WC_INTERNAL int clock_gettime(int dummy, struct timespec *ct)
     return 0;
 }
 
-/* get the delta between two sub-second timers */
-WC_INTERNAL unsigned long WC_menu_elapsedTime(struct timespec start, struct timespec end)
+/* get the delta between two timers */
+WC_INTERNAL WC_time WC_menu_elapsedTime(struct timespec start, struct timespec end)
+{
+    return (WC_time)(((end.count.QuadPart - start.count.QuadPart) * WC_BILLION) / WC_gCountsPerSec.QuadPart);
+}
+
+/* nanoseconds from the performance counter */
+WC_GLOBAL WC_time WC_menu_now(void)
+{
+    struct timespec now;
+
+    if(clock_gettime(CLOCK_MONOTONIC, &now))
+        return 0;
+
+    return (now.count.QuadPart / WC_gCountsPerSec.QuadPart) * (WC_time)WC_BILLION + now.tv_nsec;
+}
+
+/* wait for a message (which is how keys arrive) or the timeout */
+WC_GLOBAL void WC_menu_wait_input(WC_time timeout)
 {
-    return (((end.count.QuadPart - start.count.QuadPart) * WC_BILLION) / WC_gCountsPerSec.QuadPart);
+    MsgWaitForMultipleObjects(0, NULL, FALSE, WC_WAIT_FOREVER == timeout ? INFINITE : (DWORD)((timeout + 999999) / 1000000), QS_ALLINPUT);
 }
 
 #else /* !Windows */
 
-/* get the delta between the nanosecond timers (ignoring the seconds component) */
-WC_INTERNAL unsigned long WC_menu_elapsedTime(struct timespec start, struct timespec end)
+/* get the delta between the timers */
+WC_INTERNAL WC_time WC_menu_elapsedTime(struct timespec start, struct timespec end)
 {
-    unsigned long temp;
+    return (WC_time)(end.tv_sec - start.tv_sec) * (WC_time)WC_BILLION + (end.tv_nsec - start.tv_nsec);
+}
 
-    if ((end.tv_nsec-start.tv_nsec)<0) 
-        temp = WC_BILLION+end.tv_nsec-start.tv_nsec;
-    else
-        temp = end.tv_nsec-start.tv_nsec;
+/* nanoseconds from the monotonic clock */
+WC_GLOBAL WC_time WC_menu_now(void)
+{
+    struct timespec now;
 
-    return temp;
+    if(clock_gettime(CLOCK_MONOTONIC, &now))
+        return 0;
+
+    return (WC_time)now.tv_sec * (WC_time)WC_BILLION + now.tv_nsec;
+}
+
+/* wait for stdin to become readable or the timeout */
+WC_GLOBAL void WC_menu_wait_input(WC_time timeout)
+{
+    struct pollfd fds;
+
+    fds.fd = 0;
+    fds.events = POLLIN;
+    fds.revents = 0;
+    /* round up so the wait doesn't end just before the deadline */
+    poll(&fds, 1, WC_WAIT_FOREVER == timeout ? -1 : (int)((timeout + 999999) / 1000000));
 }
 
 #endif /* !Windows */
 
-/* gets lenth of longest item in array "items" */
-WC_INTERNAL int WC_menu_maxItemLength(char **items)
+/* gets lenth of longest of the first numItems items */
+WC_INTERNAL int WC_menu_maxItemLength(WC_menuState *state, int numItems)
 {
-    int maxItemLen = 0;
-    char **item = items;
+    int i, maxItemLen = 0, *lengths = state->lengths;
 
-    while(*item)
+    /* no cache (getItem, or out of memory) so just measure */
+    if(state->numLengths < numItems)
     {
-        maxItemLen = WC_menu_max(maxItemLen, strlen(*item));
-        item++;
+        for(i=0; i<numItems; i++)
+            maxItemLen = WC_menu_max(maxItemLen, WC_menu_item_length(state, i));
+        return maxItemLen;
     }
+
+    /* fill the cache (strlen is vectorized in the C library) then take the */
+    /* max in a branch-free loop of its own, which the compiler vectorizes */
+    for(i=0; i<numItems; i++)
+        WC_menu_item_length(state, i);
+    for(i=0; i<numItems; i++)
+        maxItemLen = lengths[i] > maxItemLen ? lengths[i] : maxItemLen;
+
     return maxItemLen;
 }
 
+/* strlen of item index, from the lengths cache */
+WC_INTERNAL int WC_menu_item_length(WC_menuState *state, int index)
+{
+    if(index >= state->numLengths)
+        return (int)strlen(WC_menu_item_text(state, index));
+
+    /* an item pointed at new text needs measuring again */
+    if(WC_NONE == state->lengths[index] || state->measured[index] != state->menuItems->items[index])
+    {
+        state->measured[index] = state->menuItems->items[index];
+        state->lengths[index] = (int)strlen(state->measured[index]);
+    }
+
+    return state->lengths[index];
+}
+
+/* forgets cached lengths of items first to last, and makes room for all the items */
+WC_INTERNAL void WC_menu_forget_lengths(WC_menuState *state, int first, int last)
+{
+    /* getItem rows are measured as they're fetched */
+    if(state->menuItems->getItem)
+        return;
+
+    if(state->numLengths < state->numMenuItems)
+    {
+        void *temp = WC_menu_heap_resize(state->menuItems, state->lengths, state->numMenuItems * sizeof(int));
+        void *measured = WC_menu_heap_resize(state->menuItems, state->measured, state->numMenuItems * sizeof(char*));
+        if(temp)
+            state->lengths = (int*)temp;
+        if(measured)
+            state->measured = (char**)measured;
+        if(!temp || !measured)
+            return;
+        /* the new entries need forgetting too */
+        first = WC_menu_min(first, state->numLengths);
+        last = WC_menu_max(last, state->numMenuItems - 1);
+        state->numLengths = state->numMenuItems;
+    }
+
+    first = WC_menu_max(0, first);
+    last = WC_menu_min(last, state->numLengths - 1);
+    /* WC_NONE is all bits set in every byte */
+    if(first <= last)
+        memset(&state->lengths[first], 0xff, (last - first + 1) * sizeof(int));
+}
+
+/* the text of item index, from items or getItem */
+WC_INTERNAL char *WC_menu_item_text(WC_menuState *state, int index)
+{
+    MenuItems *menuItems = state->menuItems;
+    WC_menuRow *row = 0;
+    int r;
+
+    if(!menuItems->getItem)
+        return menuItems->items[index];
+
+    /* already got, or else reuse the row that's gone longest without being drawn */
+    for(r=0; r<state->numRows; r++)
+    {
+        if(state->rows[r].index == index)
+        {
+            state->rows[r].used = state->frameNumber;
+            return state->rows[r].text;
+        }
+        /* prefer an empty row, then the one unused longest */
+        if(!row || (WC_NONE != row->index && (WC_NONE == state->rows[r].index || state->rows[r].used < row->used)))
+            row = &state->rows[r];
+    }
+
+    if(!row)
+        return WC_MARK_BLANK;
+
+    row->index = index;
+    row->used = state->frameNumber;
+    row->text[0] = '\0';
+    menuItems->getItem(menuItems->userData_ptr, index, row->text, WC_MENU_ROW_CAPACITY);
+    row->text[WC_MENU_ROW_CAPACITY-1] = '\0';
+
+    return row->text;
+}
+
+/* 1 if item index is enabled */
+WC_INTERNAL int WC_menu_item_enabled(WC_menuState *state, int index)
+{
+    if(state->menuItems->getItem && state->menuItems->getState)
+        return WC_ENABLED == state->menuItems->getState(state->menuItems->userData_ptr, index);
+
+    return !state->numEnabledWords || (state->enabled[WC_BITS_WORD(index)] & WC_BITS_BIT(index));
+}
+
+/* forgets getItem text of items first to last, for when they may have changed */
+WC_INTERNAL void WC_menu_forget_rows(WC_menuState *state, int first, int last)
+{
+    int r;
+
+    for(r=0; r<state->numRows; r++)
+    {
+        if(state->rows[r].index >= first && state->rows[r].index <= last)
+            state->rows[r].index = WC_NONE;
+    }
+}
+
 /* counts the number of pointers in a 0 terminated array (of pointer sized elements) */
 WC_INTERNAL int WC_menu_len(void *array)
 {
@@ -251,437 +1383,4361 @@ WC_INTERNAL int WC_menu_count(void *array)
     return entry-(int *)array;
 }
 
-/* finds the next item in "status" that has a 1 from selectedItem in direction (1 or -1) */
-/* returns -1 or len(menuItems->states) if it runs off the end of the list */
-WC_INTERNAL int WC_menu_next_item(MenuItems *menuItems, int selectedItem, int direction)
+/* moves a selected item that's too wide for the menu back and forth by ticks steps */
+WC_INTERNAL void WC_menu_scroll_item(int *itemOffset, int *itemDirection, int displayLength, int width, WC_time ticks)
 {
-    int numMenuStates;
-
-    selectedItem += direction;
+    /* the bounce repeats every 2 runs across plus a hold at each end so skip whole bounces */
+    ticks %= 2 * (displayLength - width + 1) + 2;
 
-    /* always just next if there are no states */
-    if(!menuItems->states)
-        return selectedItem;
-
-    numMenuStates = WC_menu_count(menuItems->states);
-
-    while(1)
+    while(ticks-- > 0)
     {
-        if(selectedItem >= numMenuStates || selectedItem < 0)
-            return selectedItem;
-        if(menuItems->states[selectedItem] == WC_ENABLED)
-            return selectedItem;
-        selectedItem += direction;
+        *itemOffset += *itemDirection;
+        /* swap scroll itemDirection but hold for one frame at either end */
+        if(*itemOffset == 0 || *itemOffset > displayLength - width)
+        {
+            if(*itemDirection)
+                *itemDirection = 0;
+            else if(*itemOffset == 0)
+                *itemDirection = 1;
+            else
+                *itemDirection = -1;
+        }
     }
 }
 
-/* inits a MenuItems struct to sane values */
-WC_GLOBAL void WC_menuInit(MenuItems *menuItems)
+/* how many items there are, from numItems or else by counting */
+WC_INTERNAL int WC_menu_num_items(MenuItems *menuItems)
 {
-    menuItems->sy = menuItems->sx = WC_NONE;
-    menuItems->inputFunction = 0;
-    menuItems->drawFunction = 0;
-    menuItems->showFunction = 0;
-    menuItems->y = menuItems->x = menuItems->height = menuItems->width = WC_NONE;
-    menuItems->title_height = menuItems->footer_height = 2;
-    menuItems->title = menuItems->footer = 0;
-    menuItems->items = 0;
-    menuItems->states = 0;
-    menuItems->callbacks = 0;
-    menuItems->userData_ptr = 0;
-    menuItems->selfOwnsMemory = 0;
+    if(WC_NONE != menuItems->numItems)
+        return menuItems->numItems;
+
+    /* a getItem provider has to say how many items it has */
+    if(menuItems->getItem)
+        return 0;
+
+    return menuItems->items ? WC_menu_len(menuItems->items) : 0;
 }
 
-/* clone all of the elements in a menuItems, in place, so the */
-/* memory belongs to this menuItems.  Sets selfOwnsMemory to 1 */
-WC_GLOBAL void WC_menu_take_ownership(MenuItems *menuItems)
+/* how many states there are, from numStates or else by counting */
+WC_INTERNAL int WC_menu_num_states(MenuItems *menuItems)
 {
-    int i, length;
-    void *temp;
+    if(!menuItems->states)
+        return 0;
 
-    menuItems->title = strdup(menuItems->title);
-    menuItems->footer = strdup(menuItems->footer);
+    if(WC_NONE != menuItems->numStates)
+        return menuItems->numStates;
 
-    length = WC_menu_len(menuItems->items);
-    temp = malloc((length+1)*sizeof(char*));
-    for(i=0;i<length;i++)
-    {
-        ((char**)temp)[i] = strdup(menuItems->items[i]);
-    }
-    ((char**)temp)[length] = 0;
-    menuItems->items = (char**)temp;
+    return WC_menu_count(menuItems->states);
+}
 
-    length = WC_menu_count(menuItems->states)+1;
-    temp = malloc(length*sizeof(int));
-    for(i=0;i<length;i++)
-        ((int*)temp)[i] = menuItems->states[i];
-    menuItems->states = (int*)temp;
+/* how many callbacks there are, from numCallbacks or else by counting */
+WC_INTERNAL int WC_menu_num_callbacks(MenuItems *menuItems)
+{
+    if(!menuItems->callbacks)
+        return 0;
 
-    length = WC_menu_len(menuItems->callbacks)+1;
-    temp = malloc(length*sizeof(cbf_ptr));
-    for(i=0;i<length;i++)
-        ((cbf_ptr*)temp)[i] = menuItems->callbacks[i];
-    menuItems->callbacks = (cbf_ptr*)temp;
+    if(WC_NONE != menuItems->numCallbacks)
+        return menuItems->numCallbacks;
 
-    menuItems->selfOwnsMemory = 1;
+    return WC_menu_len(menuItems->callbacks);
 }
 
-/* if selfOwnsMemory is 1, calls free on alloc'd memory */
-WC_GLOBAL void WC_menu_cleanup(MenuItems *menuItems)
+/* refreshes the item/state/callback counts the running menu works with */
+WC_INTERNAL void WC_menu_recount(WC_menuState *state)
 {
-    if(menuItems->selfOwnsMemory)
-    {
-        int i, length;
-        if(menuItems->title)
-        {
-            free(menuItems->title);
-            menuItems->title = 0;
-        }
-        if(menuItems->footer)
-        {
-            free(menuItems->footer);
-            menuItems->footer = 0;
-        }
+    state->numMenuItems = WC_menu_num_items(state->menuItems);
+    state->numMenuStates = WC_menu_num_states(state->menuItems);
+    state->numMenuCallbacks = WC_menu_num_callbacks(state->menuItems);
+}
 
-        length = WC_menu_len(menuItems->items);
-        for(i=0;i<length;i++)
-        {
-            free(menuItems->items[i]);
-        }
-        if(menuItems->items)
-        {
-            free(menuItems->items);
+/* index of the lowest set bit in a non-zero word */
+WC_INTERNAL int WC_menu_lowest_bit(WC_bits bits)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(bits);
+#elif defined(_MSC_VER) && defined(_WIN64)
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return (int)index;
+#else
+    int index = 0;
+    while(!(bits & 1))
+    {
+        bits >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
+/* index of the highest set bit in a non-zero word */
+WC_INTERNAL int WC_menu_highest_bit(WC_bits bits)
+{
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(bits);
+#elif defined(_MSC_VER) && defined(_WIN64)
+    unsigned long index;
+    _BitScanReverse64(&index, bits);
+    return (int)index;
+#else
+    int index = 63;
+    while(!(bits & ((WC_bits)1 << 63)))
+    {
+        bits <<= 1;
+        index--;
+    }
+    return index;
+#endif
+}
+
+/* (re)builds the enabled bitset from the states array */
+WC_INTERNAL void WC_menu_build_enabled(WC_menuState *state)
+{
+    int i, w, *states = state->menuItems->states;
+    int numWords = WC_BITS_WORD(state->numMenuItems + WC_BITS_PER_WORD - 1);
+    int numSummaryWords = WC_BITS_WORD(numWords + WC_BITS_PER_WORD - 1);
+
+    /* without states every item is enabled and there's nothing to look up */
+    if(!states)
+        return;
+
+    if(numWords > state->numEnabledWords || !state->enabled)
+    {
+        void *temp = WC_menu_heap_resize(state->menuItems, state->enabled, WC_menu_max(1, numWords) * sizeof(WC_bits));
+        void *summary = WC_menu_heap_resize(state->menuItems, state->enabledSummary, WC_menu_max(1, numSummaryWords) * sizeof(WC_bits));
+        if(temp)
+            state->enabled = (WC_bits*)temp;
+        if(summary)
+            state->enabledSummary = (WC_bits*)summary;
+        if(!temp || !summary)
+        {
+            state->numEnabledWords = 0;
+            return;
+        }
+    }
+    state->numEnabledWords = numWords;
+
+    /* items without a state count as enabled */
+    for(w=0; w<numWords; w++)
+    {
+        int base = w * WC_BITS_PER_WORD;
+        int end = WC_menu_min(base + WC_BITS_PER_WORD, state->numMenuItems);
+        WC_bits bits = 0;
+
+        for(i=base; i<end; i++)
+        {
+            if(i >= state->numMenuStates || WC_ENABLED == states[i])
+                bits |= WC_BITS_BIT(i);
+        }
+        state->enabled[w] = bits;
+    }
+
+    memset(state->enabledSummary, 0, numSummaryWords * sizeof(WC_bits));
+    for(w=0; w<numWords; w++)
+    {
+        if(state->enabled[w])
+            state->enabledSummary[WC_BITS_WORD(w)] |= WC_BITS_BIT(w);
+    }
+}
+
+/* sets or clears bits first to last in the enabled bitset and keeps the summary right */
+WC_INTERNAL void WC_menu_set_enabled(WC_menuState *state, int first, int last, int enabled)
+{
+    int w;
+
+    last = WC_menu_min(last, state->numEnabledWords * WC_BITS_PER_WORD - 1);
+
+    for(w=WC_BITS_WORD(first); first<=last; w++)
+    {
+        /* the bits of this word from first up to last */
+        int end = WC_menu_min(last, w * WC_BITS_PER_WORD + WC_BITS_PER_WORD - 1);
+        WC_bits mask = (~(WC_bits)0 << (first & 63)) & (~(WC_bits)0 >> (63 - (end & 63)));
+
+        if(enabled)
+            state->enabled[w] |= mask;
+        else
+            state->enabled[w] &= ~mask;
+
+        if(state->enabled[w])
+            state->enabledSummary[WC_BITS_WORD(w)] |= WC_BITS_BIT(w);
+        else
+            state->enabledSummary[WC_BITS_WORD(w)] &= ~WC_BITS_BIT(w);
+
+        first = end + 1;
+    }
+}
+
+/* finds the next item in "status" that has a 1 from selectedItem in direction (1 or -1) */
+/* returns -1 or the number of items if it runs off the end of the list */
+WC_INTERNAL int WC_menu_next_item(WC_menuState *state, int selectedItem, int direction)
+{
+    int w, s, numSummaryWords;
+    WC_bits bits;
+
+    selectedItem += direction;
+
+    /* a getState provider has no bitset, so ask it about each item in turn */
+    if(state->menuItems->getItem && state->menuItems->getState)
+    {
+        while(selectedItem >= 0 && selectedItem < state->numMenuItems && !WC_menu_item_enabled(state, selectedItem))
+            selectedItem += direction;
+        return WC_menu_max(-1, WC_menu_min(selectedItem, state->numMenuItems));
+    }
+
+    /* always just next if there are no states */
+    if(!state->menuItems->states || !state->numEnabledWords)
+        return selectedItem;
+
+    if(selectedItem < 0)
+        return -1;
+    if(selectedItem >= state->numMenuItems)
+        return state->numMenuItems;
+
+    numSummaryWords = WC_BITS_WORD(state->numEnabledWords + WC_BITS_PER_WORD - 1);
+    w = WC_BITS_WORD(selectedItem);
+
+    if(direction > 0)
+    {
+        /* the rest of this word */
+        bits = state->enabled[w] & (~(WC_bits)0 << (selectedItem & 63));
+        if(bits)
+            return w * WC_BITS_PER_WORD + WC_menu_lowest_bit(bits);
+
+        /* then the summary finds the next word with anything in it */
+        w++;
+        for(s=WC_BITS_WORD(w); s<numSummaryWords && w<state->numEnabledWords; s++)
+        {
+            bits = state->enabledSummary[s] & (~(WC_bits)0 << (w & 63));
+            if(bits)
+            {
+                w = s * WC_BITS_PER_WORD + WC_menu_lowest_bit(bits);
+                return w * WC_BITS_PER_WORD + WC_menu_lowest_bit(state->enabled[w]);
+            }
+            w = (s + 1) * WC_BITS_PER_WORD;
+        }
+        return state->numMenuItems;
+    }
+
+    /* this word, down from selectedItem */
+    bits = state->enabled[w] & (~(WC_bits)0 >> (63 - (selectedItem & 63)));
+    if(bits)
+        return w * WC_BITS_PER_WORD + WC_menu_highest_bit(bits);
+
+    /* then the summary finds the previous word with anything in it */
+    w--;
+    for(s=WC_BITS_WORD(w); w>=0; s--)
+    {
+        bits = state->enabledSummary[s] & (~(WC_bits)0 >> (63 - (w & 63)));
+        if(bits)
+        {
+            w = s * WC_BITS_PER_WORD + WC_menu_highest_bit(bits);
+            return w * WC_BITS_PER_WORD + WC_menu_highest_bit(state->enabled[w]);
+        }
+        w = s * WC_BITS_PER_WORD - 1;
+    }
+    return -1;
+}
+
+/* sets the state of items first to last, and the running menu's bitset */
+WC_GLOBAL void WC_menu_set_states(MenuItems *menuItems, int first, int last, int state)
+{
+    int i, *states = menuItems->states;
+    WC_menuState *running = menuItems->runningState;
+
+    if(!states)
+        return;
+
+    first = WC_menu_max(0, first);
+    last = WC_menu_min(last, WC_menu_num_states(menuItems) - 1);
+    if(first > last)
+        return;
+
+    /* write a copy, not the user's array */
+    states = (int*)WC_menu_own_array(menuItems, states, WC_menu_num_states(menuItems), sizeof(int));
+    if(!states)
+        return;
+    menuItems->states = states;
+
+    for(i=first; i<=last; i++)
+        states[i] = state;
+
+    if(running && running->numEnabledWords)
+        WC_menu_set_enabled(running, first, last, WC_ENABLED == state);
+    if(running)
+        WC_menu_changed(running, menuItems->items, first, last);
+}
+
+/* gives item index a copy of text, copying the items array first if it isn't the menu's */
+WC_GLOBAL int WC_menu_set_item(MenuItems *menuItems, int index, const char *text)
+{
+    WC_menuState *running = menuItems->runningState;
+    char **items = menuItems->items, **oldItems = items, *copy, *oldText;
+    int tracked = 0, inPlace = 0;
+    size_t length;
+
+    if(!items || !text || index < 0)
+        return 0;
+
+    /* only counting the items to copy them, so later edits don't scan */
+    if(!WC_menu_arena_owns(menuItems, items))
+    {
+        int numItems = WC_menu_num_items(menuItems);
+        if(index >= numItems || !(items = (char**)WC_menu_own_array(menuItems, items, numItems, sizeof(char*))))
+            return 0;
+        menuItems->items = items;
+    }
+    else if(WC_NONE != menuItems->numItems && index >= menuItems->numItems)
+    {
+        return 0;
+    }
+
+    /* shared text comes from the pool, after take_ownership the heap (the program may free it), */
+    /* and otherwise the old copy can take the new text where it is, like a free then malloc would */
+    length = strlen(text) + 1;
+    oldText = items[index];
+    if(menuItems->intern)
+        copy = WC_menu_intern(menuItems->intern, text);
+    else if(menuItems->selfOwnsHeap)
+        copy = WC_menu_heap_strdup(menuItems, text);
+    else if((inPlace = WC_menu_arena_owns(menuItems, oldText) && length <= ((WC_menuArenaBlock*)oldText - 1)->capacity))
+        copy = oldText;
+    else
+        copy = WC_menu_strdup(menuItems, text);
+    if(!copy)
+        return 0;
+
+    /* the old text's length comes out of the width count before the text goes */
+    if(running && index < running->numMenuItems && (tracked = WC_menu_track_widths(running)))
+        WC_menu_count_width(running, WC_menu_item_length(running, index), -1);
+
+    if(inPlace)
+        memcpy(copy, text, length);
+    items[index] = copy;
+    /* a copy the menu made before is given back; the program's own text stays as it was */
+    if(!inPlace)
+        WC_menu_free_text(menuItems, oldText);
+
+    if(running)
+    {
+        WC_menu_forget_item(running, index);
+        if(tracked)
+            WC_menu_count_width(running, WC_menu_item_length(running, index), 1);
+        WC_menu_changed(running, oldItems, index, index);
+        /* a callback's changes are caught up with when it returns */
+        if(!running->inCallback && !WC_menu_refresh(running, menuItems->states, running->numMenuItems, running->numMenuStates))
+            WC_menu_finish(running, WC_ERROR_NONE_ENABLED);
+    }
+
+    return 1;
+}
+
+/* sets the state of item index */
+WC_GLOBAL void WC_menu_set_state(MenuItems *menuItems, int index, int state)
+{
+    WC_menu_set_states(menuItems, index, index, state);
+}
+
+/* tells the running menu items first to last changed, and catches up with just those */
+WC_GLOBAL void WC_menu_invalidate(MenuItems *menuItems, int first, int last)
+{
+    WC_menuState *running = menuItems->runningState;
+    int i;
+
+    /* a menu that isn't running works everything out when it starts */
+    if(!running)
+        return;
+
+    first = WC_menu_max(0, first);
+    last = WC_menu_min(last, running->numMenuItems - 1);
+    if(first > last)
+        return;
+
+    /* the old lengths come out of the width count, or if they weren't all measured it starts again */
+    if(running->numWidths)
+    {
+        for(i=first; i<=last && i<running->numLengths && WC_NONE != running->lengths[i]; i++)
+            ;
+        if(i > last)
+        {
+            for(i=first; i<=last; i++)
+                WC_menu_count_width(running, running->lengths[i], -1);
+        }
+        else
+        {
+            WC_menu_heap_free(menuItems, running->widths);
+            running->widths = 0;
+            running->numWidths = 0;
+        }
+    }
+    for(i=first; i<=last; i++)
+        WC_menu_forget_item(running, i);
+    if(running->numWidths)
+    {
+        for(i=first; i<=last; i++)
+            WC_menu_count_width(running, WC_menu_item_length(running, i), 1);
+    }
+    else
+    {
+        WC_menu_track_widths(running);
+    }
+
+    /* states written directly */
+    if(menuItems->states && running->numEnabledWords)
+    {
+        for(i=first; i<=last; i++)
+            WC_menu_set_enabled(running, i, i, i >= running->numMenuStates || WC_ENABLED == menuItems->states[i]);
+    }
+
+    WC_menu_changed(running, menuItems->items, first, last);
+    if(!running->inCallback && !WC_menu_refresh(running, menuItems->states, running->numMenuItems, running->numMenuStates))
+        WC_menu_finish(running, WC_ERROR_NONE_ENABLED);
+}
+
+/* inserts count items before item index, keeping the arrays in step */
+WC_GLOBAL int WC_menu_insert_items(MenuItems *menuItems, int index, char **items, int *states, cbf_ptr *callbacks, int count)
+{
+    WC_menuState *running = menuItems->runningState;
+    int i, numItems, numStates, numCallbacks, tracked, moveStates, moveCallbacks, *oldStates = menuItems->states;
+    char **oldItems = menuItems->items, **copies = 0;
+    size_t size = 0;
+    void *array;
+
+    if(menuItems->getItem || index < 0 || count < 0)
+        return 0;
+
+    numItems = menuItems->items ? WC_menu_num_items(menuItems) : 0;
+    numStates = menuItems->states ? WC_menu_num_states(menuItems) : 0;
+    numCallbacks = menuItems->callbacks ? WC_menu_num_callbacks(menuItems) : 0;
+    if(index > numItems)
+        return 0;
+
+    /* make room in all three arrays first, so they can't get out of step, then for all the text */
+    /* (in the pool, if the text's shared), so nothing changes if there isn't room for everything. */
+    /* Arrays that move have the same entries, so the menu is as it was if this gives up */
+    WC_menu_own_arrays(menuItems);
+    if(!(array = WC_menu_grow_array(menuItems, menuItems->items, numItems, numItems + count + 1, sizeof(char*))))
+        return 0;
+    menuItems->items = (char**)array;
+    /* the old array may be reused, so the running menu follows the move now */
+    if(running && array != oldItems)
+        WC_menu_changed(running, oldItems, index, index - 1);
+    /* states and callbacks that reach the insert move up with their items */
+    moveStates = menuItems->states && index <= numStates;
+    if(moveStates)
+    {
+        if(!(array = WC_menu_grow_array(menuItems, menuItems->states, numStates, numStates + count + 1, sizeof(int))))
+            return 0;
+        menuItems->states = (int*)array;
+    }
+    moveCallbacks = menuItems->callbacks && index <= numCallbacks;
+    if(moveCallbacks)
+    {
+        if(!(array = WC_menu_grow_array(menuItems, menuItems->callbacks, numCallbacks, numCallbacks + count + 1, sizeof(cbf_ptr))))
+            return 0;
+        menuItems->callbacks = (cbf_ptr*)array;
+    }
+    for(i=0; i<count; i++)
+        size += menuItems->intern ? strlen(items[i]) + 1 : sizeof(WC_menuArenaBlock) + WC_menu_arena_round(strlen(items[i]) + 1);
+    if(menuItems->intern)
+    {
+        if(!WC_menu_intern_reserve(menuItems->intern, count, size))
+            return 0;
+    }
+    else if(menuItems->selfOwnsHeap)
+    {
+        /* after take_ownership the copies are the heap's, made up front as they can't be reserved */
+        if(!(copies = (char**)WC_menu_heap_alloc(menuItems, WC_menu_max(1, count) * sizeof(char*))))
+            return 0;
+        for(i=0; i<count && (copies[i] = WC_menu_heap_strdup(menuItems, items[i])); i++)
+            ;
+        if(i < count)
+        {
+            while(i--)
+                WC_menu_heap_free(menuItems, copies[i]);
+            WC_menu_heap_free(menuItems, copies);
+            return 0;
+        }
+    }
+    else if(!menuItems->arena || menuItems->arena->size - menuItems->arena->used < size)
+    {
+        if(!WC_menu_arena_grow(menuItems, size))
+            return 0;
+    }
+
+    /* the width count starts from the items as they were */
+    tracked = running && WC_menu_track_widths(running);
+
+    memmove(&menuItems->items[index + count], &menuItems->items[index], (numItems - index) * sizeof(char*));
+    for(i=0; i<count; i++)
+    {
+        if(copies)
+            menuItems->items[index + i] = copies[i];
+        else
+            menuItems->items[index + i] = menuItems->intern ? WC_menu_intern(menuItems->intern, items[i]) : WC_menu_strdup(menuItems, items[i]);
+        if(tracked)
+            WC_menu_count_width(running, (int)strlen(items[i]), 1);
+    }
+    menuItems->items[numItems + count] = 0;
+    if(WC_NONE != menuItems->numItems)
+        menuItems->numItems += count;
+    WC_menu_heap_free(menuItems, copies);
+
+    if(moveStates)
+    {
+        memmove(&menuItems->states[index + count], &menuItems->states[index], (numStates - index) * sizeof(int));
+        for(i=0; i<count; i++)
+            menuItems->states[index + i] = states ? states[i] : WC_ENABLED;
+        menuItems->states[numStates + count] = 0;
+        if(WC_NONE != menuItems->numStates)
+            menuItems->numStates += count;
+    }
+    if(moveCallbacks)
+    {
+        memmove(&menuItems->callbacks[index + count], &menuItems->callbacks[index], (numCallbacks - index) * sizeof(cbf_ptr));
+        for(i=0; i<count; i++)
+            menuItems->callbacks[index + i] = callbacks ? callbacks[i] : WC_NO_CALLBACK;
+        menuItems->callbacks[numCallbacks + count] = 0;
+        if(WC_NONE != menuItems->numCallbacks)
+            menuItems->numCallbacks += count;
+    }
+
+    if(running)
+    {
+        /* the cursor stays on the item it was on */
+        if(WC_NONE != running->selectedItem && running->selectedItem >= index)
+            running->selectedItem += count;
+        /* items added on the end move nothing */
+        if(index < numItems)
+            running->itemsMoved = 1;
+        WC_menu_jobs_move(running, index, count);
+        WC_menu_forget_items(running, index);
+        WC_menu_changed(running, oldItems, index, numItems + count - 1);
+        if(!running->inCallback && !WC_menu_refresh(running, oldStates, running->numMenuItems, running->numMenuStates))
+            WC_menu_finish(running, WC_ERROR_NONE_ENABLED);
+    }
+
+    return 1;
+}
+
+/* inserts one item */
+WC_GLOBAL int WC_menu_insert_item(MenuItems *menuItems, int index, const char *text, int state, cbf_ptr callback)
+{
+    char *items[1];
+
+    items[0] = (char*)text;
+    return WC_menu_insert_items(menuItems, index, items, &state, &callback, 1);
+}
+
+/* removes count items from item index on, keeping the arrays in step */
+WC_GLOBAL int WC_menu_remove_items(MenuItems *menuItems, int index, int count)
+{
+    WC_menuState *running = menuItems->runningState;
+    int i, numItems, numStates, numCallbacks, *oldStates = menuItems->states;
+    char **oldItems = menuItems->items;
+
+    if(!menuItems->items || menuItems->getItem || index < 0 || count < 0)
+        return 0;
+
+    numItems = WC_menu_num_items(menuItems);
+    numStates = menuItems->states ? WC_menu_num_states(menuItems) : 0;
+    numCallbacks = menuItems->callbacks ? WC_menu_num_callbacks(menuItems) : 0;
+    if(index + count > numItems)
+        return 0;
+
+    /* their lengths come out of the width count while they're still there */
+    if(running && index + count <= running->numMenuItems && WC_menu_track_widths(running))
+    {
+        for(i=index; i<index+count; i++)
+            WC_menu_count_width(running, WC_menu_item_length(running, i), -1);
+    }
+
+    WC_menu_own_arrays(menuItems);
+
+    /* newest first, so text added last is given back */
+    for(i=index+count-1; i>=index; i--)
+        WC_menu_free_text(menuItems, menuItems->items[i]);
+    memmove(&menuItems->items[index], &menuItems->items[index + count], (numItems - index - count) * sizeof(char*));
+    menuItems->items[numItems - count] = 0;
+    if(WC_NONE != menuItems->numItems)
+        menuItems->numItems -= count;
+
+    /* the arrays keep their room, for items added later */
+    if(menuItems->states && index < numStates)
+    {
+        int removed = WC_menu_min(count, numStates - index);
+        memmove(&menuItems->states[index], &menuItems->states[index + removed], (numStates - index - removed) * sizeof(int));
+        menuItems->states[numStates - removed] = 0;
+        if(WC_NONE != menuItems->numStates)
+            menuItems->numStates -= removed;
+    }
+    if(menuItems->callbacks && index < numCallbacks)
+    {
+        int removed = WC_menu_min(count, numCallbacks - index);
+        memmove(&menuItems->callbacks[index], &menuItems->callbacks[index + removed], (numCallbacks - index - removed) * sizeof(cbf_ptr));
+        menuItems->callbacks[numCallbacks - removed] = 0;
+        if(WC_NONE != menuItems->numCallbacks)
+            menuItems->numCallbacks -= removed;
+    }
+
+    if(running)
+    {
+        /* the cursor stays on its item, or goes to the nearest one to the removed ones */
+        if(WC_NONE != running->selectedItem && running->selectedItem >= index + count)
+            running->selectedItem -= count;
+        else if(WC_NONE != running->selectedItem && running->selectedItem >= index)
+            running->selectedItem = WC_menu_min(index, numItems - count - 1);
+        running->itemsMoved = 1;
+        WC_menu_jobs_move(running, index, -count);
+        WC_menu_forget_items(running, index);
+        WC_menu_changed(running, oldItems, index, numItems - 1);
+        if(!running->inCallback && !WC_menu_refresh(running, oldStates, running->numMenuItems, running->numMenuStates))
+            WC_menu_finish(running, WC_ERROR_NONE_ENABLED);
+    }
+
+    return 1;
+}
+
+/* removes item index */
+WC_GLOBAL int WC_menu_remove_item(MenuItems *menuItems, int index)
+{
+    return WC_menu_remove_items(menuItems, index, 1);
+}
+
+/* rows in the list, which is all the items unless filtering */
+WC_INTERNAL int WC_menu_num_rows(WC_menuState *state)
+{
+    return state->filterLength ? state->numView : state->numMenuItems;
+}
+
+/* the item shown on a row of the list */
+WC_INTERNAL int WC_menu_row_item(WC_menuState *state, int row)
+{
+    return state->filterLength ? state->view[row] : row;
+}
+
+/* WC_menu_next_item for rows of the list; returns -1 or the number of rows off the ends */
+WC_INTERNAL int WC_menu_next_row(WC_menuState *state, int row, int direction)
+{
+    if(!state->filterLength)
+        return WC_menu_next_item(state, row, direction);
+
+    /* the view is short, so just check each row */
+    for(row += direction; row >= 0 && row < state->numView; row += direction)
+    {
+        if(WC_menu_item_enabled(state, state->view[row]))
+            break;
+    }
+    return WC_menu_max(-1, WC_menu_min(row, state->numView));
+}
+
+/* puts the cursor on item if it's listed and enabled, or else the nearest enabled row */
+WC_INTERNAL void WC_menu_select_item(WC_menuState *state, int item)
+{
+    int numRows = WC_menu_num_rows(state), first = 0, last = numRows, row;
+
+    /* fuzzy matches are best first and there aren't many, so look through them */
+    if(state->filterLength && WC_FILTER_FUZZY == state->menuItems->filterMode)
+    {
+        while(first < numRows && state->view[first] != item)
+            first++;
+        if(first == numRows)
+            first = 0;
+        last = first;
+    }
+
+    /* otherwise the list is in menu order, so find where item is (or would be) in it */
+    while(first < last)
+    {
+        row = first + (last - first) / 2;
+        if(WC_menu_row_item(state, row) < item)
+            first = row + 1;
+        else
+            last = row;
+    }
+
+    row = first;
+    if(row >= numRows || WC_menu_row_item(state, row) != item || !WC_menu_item_enabled(state, item))
+    {
+        row = WC_menu_next_row(state, first - 1, 1);
+        if(row >= numRows)
+            row = WC_menu_next_row(state, first, -1);
+    }
+
+    state->itemOffset = 0;
+    state->itemDirection = 1;
+    state->topItem = WC_menu_min(state->topItem, WC_menu_max(0, numRows - state->numVisibleItems));
+    if(row < 0 || row >= numRows)
+    {
+        state->selectedRow = state->selectedItem = WC_NONE;
+        return;
+    }
+
+    state->selectedRow = row;
+    state->selectedItem = WC_menu_row_item(state, row);
+    /* make sure it's on-screen */
+    if(row < state->topItem)
+        state->topItem = row;
+    if(row - state->topItem >= state->numVisibleItems)
+        state->topItem = row - state->numVisibleItems + 1;
+}
+
+/* puts the cursor on the enabled row nearest row, looking in direction first, and makes sure it's on-screen */
+WC_INTERNAL int WC_menu_select_near(WC_menuState *state, int row, int direction)
+{
+    int numRows = WC_menu_num_rows(state), found;
+
+    /* row itself or past it, else back from it - both skip disabled runs through the bitset */
+    found = WC_menu_next_row(state, row - direction, direction);
+    if(found < 0 || found >= numRows)
+        found = WC_menu_next_row(state, row + direction, -direction);
+    if(found < 0 || found >= numRows)
+        return 0;
+
+    state->selectedRow = found;
+    state->selectedItem = WC_menu_row_item(state, found);
+    state->itemOffset = 0;
+    state->itemDirection = 1;
+    if(found < state->topItem)
+        state->topItem = found;
+    if(found - state->topItem >= state->numVisibleItems)
+        state->topItem = found - state->numVisibleItems + 1;
+
+    return 1;
+}
+
+/* sets jumpItem and returns the key that moves there */
+WC_GLOBAL int WC_menu_jump(MenuItems *menuItems, int index)
+{
+    menuItems->jumpItem = index;
+    return WC_INPUT_KEY_JUMP;
+}
+
+/* strcmp, ignoring ASCII case */
+WC_INTERNAL int WC_menu_compare_nocase(const char *a, const char *b)
+{
+    int ca, cb;
+
+    do
+    {
+        ca = WC_menu_lower((unsigned char)*a);
+        cb = WC_menu_lower((unsigned char)*b);
+        a++;
+        b++;
+    } while(ca && ca == cb);
+
+    return ca - cb;
+}
+
+/* sorts item indices by their text, ignoring case.  Stable, temp has room for count */
+WC_INTERNAL void WC_menu_sort_index(char **items, int *sorted, int *temp, int count)
+{
+    int *from = sorted, *to = temp, *swap;
+    int width, i;
+
+    /* bottom-up merge sort, merging runs of width back and forth between the arrays */
+    for(width=1; width<count; width*=2)
+    {
+        for(i=0; i<count; i+=2*width)
+        {
+            int a = i, mid = WC_menu_min(i + width, count), b = mid, end = WC_menu_min(i + 2 * width, count), k = i;
+
+            while(a < mid && b < end)
+                to[k++] = WC_menu_compare_nocase(items[from[b]], items[from[a]]) < 0 ? from[b++] : from[a++];
+            while(a < mid)
+                to[k++] = from[a++];
+            while(b < end)
+                to[k++] = from[b++];
+        }
+        swap = from;
+        from = to;
+        to = swap;
+    }
+
+    if(from != sorted)
+        memcpy(sorted, from, count * sizeof(int));
+}
+
+/* sorts the items into state->sorted for filtering; 0 if out of memory */
+WC_INTERNAL int WC_menu_build_index(WC_menuState *state)
+{
+    char **items = state->menuItems->items;
+    int i, count = state->numMenuItems, *temp;
+
+    WC_menu_forget_index(state);
+
+    state->sorted = (int*)WC_menu_heap_alloc(state->menuItems, WC_menu_max(1, count) * sizeof(int));
+    state->indexed = (char**)WC_menu_heap_alloc(state->menuItems, WC_menu_max(1, count) * sizeof(char*));
+    temp = (int*)WC_menu_heap_alloc(state->menuItems, WC_menu_max(1, count) * sizeof(int));
+    if(!state->sorted || !state->indexed || !temp || !WC_menu_view_room(state, count))
+    {
+        WC_menu_heap_free(state->menuItems, temp);
+        WC_menu_forget_index(state);
+        return 0;
+    }
+
+    for(i=0; i<count; i++)
+    {
+        state->sorted[i] = i;
+        state->indexed[i] = items[i];
+    }
+    WC_menu_sort_index(items, state->sorted, temp, count);
+    WC_menu_heap_free(state->menuItems, temp);
+
+    state->numSorted = count;
+    state->filterFirst[0] = 0;
+    state->filterLast[0] = count;
+
+    return 1;
+}
+
+/* frees the sorted index, to be built again when next needed */
+WC_INTERNAL void WC_menu_forget_index(WC_menuState *state)
+{
+    WC_menu_heap_free(state->menuItems, state->sorted);
+    WC_menu_heap_free(state->menuItems, state->indexed);
+    state->sorted = 0;
+    state->indexed = 0;
+    state->numSorted = 0;
+}
+
+/* after a callback, re-sorts items first to last given new text, and any added on the end, */
+/* or drops the index if it can't tell */
+WC_INTERNAL void WC_menu_sync_index(WC_menuState *state, int first, int last)
+{
+    MenuItems *menuItems = state->menuItems;
+    char **items = menuItems->items;
+    int count = state->numSorted, total = state->numMenuItems;
+    int i, j, k, numCandidates, *changed, *temp;
+
+    if(!state->sorted)
+        return;
+
+    /* without numItems text may have changed in place, and inserting or removing */
+    /* items renumbers them, so sort again from scratch */
+    if(WC_NONE == menuItems->numItems || count > total || state->itemsMoved)
+    {
+        WC_menu_forget_index(state);
+        return;
+    }
+
+    /* room for items added on the end */
+    if(total > count)
+    {
+        void *sorted = WC_menu_heap_resize(menuItems, state->sorted, total * sizeof(int));
+        void *indexed;
+
+        if(sorted)
+            state->sorted = (int*)sorted;
+        indexed = sorted ? WC_menu_heap_resize(menuItems, state->indexed, total * sizeof(char*)) : 0;
+        if(indexed)
+            state->indexed = (char**)indexed;
+        if(!indexed || !WC_menu_view_room(state, total))
+        {
+            WC_menu_forget_index(state);
+            return;
+        }
+    }
+
+    last = WC_menu_min(last, count - 1);
+    numCandidates = WC_menu_max(0, last - first + 1) + total - count;
+    if(!numCandidates)
+        return;
+    changed = (int*)WC_menu_heap_alloc(menuItems, numCandidates * sizeof(int));
+    temp = (int*)WC_menu_heap_alloc(menuItems, numCandidates * sizeof(int));
+    if(!changed || !temp)
+    {
+        WC_menu_heap_free(menuItems, changed);
+        WC_menu_heap_free(menuItems, temp);
+        WC_menu_forget_index(state);
+        return;
+    }
+
+    /* items given new text point somewhere else (or were forgotten), and new ones weren't indexed */
+    for(i=first, k=0; i<=last; i++)
+    {
+        if(state->indexed[i] != items[i])
+        {
+            state->indexed[i] = 0;
+            changed[k++] = i;
+        }
+    }
+    for(i=count; i<total; i++)
+    {
+        state->indexed[i] = 0;
+        changed[k++] = i;
+    }
+
+    if(k)
+    {
+        int *sorted = state->sorted;
+
+        /* take the changed items out (ones added on the end were never in), */
+        j = count;
+        if(changed[0] < count)
+        {
+            for(i=j=0; i<count; i++)
+            {
+                if(state->indexed[sorted[i]])
+                    sorted[j++] = sorted[i];
+            }
+        }
+        /* sort them among themselves, */
+        WC_menu_sort_index(items, changed, temp, k);
+        /* and put them back from the last, each before the items after it, so each item */
+        /* is moved once at most and only the changed ones are compared */
+        for(i=k-1; i>=0; i--)
+        {
+            int lo = 0, hi = j, mid, compare;
+
+            while(lo < hi)
+            {
+                mid = lo + (hi - lo) / 2;
+                compare = WC_menu_compare_nocase(items[sorted[mid]], items[changed[i]]);
+                if(compare < 0 || (!compare && sorted[mid] < changed[i]))
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            memmove(&sorted[lo + i + 1], &sorted[lo], (j - lo) * sizeof(int));
+            sorted[lo + i] = changed[i];
+            j = lo;
+        }
+        for(i=0; i<k; i++)
+            state->indexed[changed[i]] = items[changed[i]];
+        state->numSorted = total;
+        state->filterLast[0] = total;
+    }
+
+    WC_menu_heap_free(menuItems, changed);
+    WC_menu_heap_free(menuItems, temp);
+}
+
+/* narrows sorted[*first] to sorted[*last-1] to the items with (lower case) c at position length */
+WC_INTERNAL void WC_menu_prefix_range(WC_menuState *state, int length, int c, int *first, int *last)
+{
+    char **items = state->menuItems->items;
+    int *sorted = state->sorted, lo = *first, hi = *last, mid;
+
+    /* the range all starts with the same length characters, so it's in order of the next one */
+    while(lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if(WC_menu_lower((unsigned char)items[sorted[mid]][length]) < c)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    *first = lo;
+
+    hi = *last;
+    while(lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if(WC_menu_lower((unsigned char)items[sorted[mid]][length]) <= c)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    *last = lo;
+}
+
+/* qsort comparison for item indices */
+WC_INTERNAL int WC_menu_compare_int(const void *a, const void *b)
+{
+    return *(const int*)a < *(const int*)b ? -1 : *(const int*)a > *(const int*)b;
+}
+
+/* makes the view the items in sorted[first] to sorted[last-1], in menu order */
+WC_INTERNAL void WC_menu_view_range(WC_menuState *state, int first, int last)
+{
+    state->numView = last - first;
+    memcpy(state->view, &state->sorted[first], state->numView * sizeof(int));
+    qsort(state->view, state->numView, sizeof(int), WC_menu_compare_int);
+}
+
+/* adds c to the filter, narrowing the list; 0 if it can't */
+WC_INTERNAL int WC_menu_filter_add(WC_menuState *state, int c)
+{
+    char **items = state->menuItems->items;
+    int length = state->filterLength, lower = WC_menu_lower(c), i, j;
+    int first, last;
+
+    if(length >= WC_MENU_FILTER_CAPACITY - 1)
+        return 0;
+    if(!state->sorted && !WC_menu_build_index(state))
+        return 0;
+
+    /* the matches for one more character are inside the matches so far */
+    first = state->filterFirst[length];
+    last = state->filterLast[length];
+    WC_menu_prefix_range(state, length, lower, &first, &last);
+
+    if(!length)
+    {
+        WC_menu_view_range(state, first, last);
+    }
+    else
+    {
+        /* keep the rows that still match, which keeps them in menu order */
+        for(i=j=0; i<state->numView; i++)
+        {
+            if(WC_menu_lower((unsigned char)items[state->view[i]][length]) == lower)
+                state->view[j++] = state->view[i];
+        }
+        state->numView = j;
+    }
+
+    state->filterText[length] = (char)c;
+    state->filterText[length + 1] = '\0';
+    state->filterLength = length + 1;
+    state->filterFirst[length + 1] = first;
+    state->filterLast[length + 1] = last;
+
+    return 1;
+}
+
+/* works out the list again for the whole filter, after the items changed */
+WC_INTERNAL void WC_menu_filter_apply(WC_menuState *state)
+{
+    int length, first, last;
+
+    if(!state->sorted && !WC_menu_build_index(state))
+    {
+        state->filterLength = 0;
+        return;
+    }
+
+    first = 0;
+    last = state->numSorted;
+    for(length=0; length<state->filterLength; length++)
+    {
+        WC_menu_prefix_range(state, length, WC_menu_lower((unsigned char)state->filterText[length]), &first, &last);
+        state->filterFirst[length + 1] = first;
+        state->filterLast[length + 1] = last;
+    }
+    WC_menu_view_range(state, first, last);
+}
+
+/* makes room for count entries in the view; 0 if out of memory */
+WC_INTERNAL int WC_menu_view_room(WC_menuState *state, int count)
+{
+    void *temp;
+
+    if(count <= state->maxView && state->view)
+        return 1;
+
+    temp = WC_menu_heap_resize(state->menuItems, state->view, WC_menu_max(1, count) * sizeof(int));
+    if(!temp)
+        return 0;
+    state->view = (int*)temp;
+    state->maxView = count;
+
+    return 1;
+}
+
+/* WC_menu_char_class of every character of text, or'd together */
+WC_INTERNAL WC_bits WC_menu_char_classes(const char *text)
+{
+    WC_bits classes = 0;
+
+    while(*text)
+    {
+        int c = WC_menu_lower((unsigned char)*text);
+        classes |= WC_menu_char_class(c);
+        text++;
+    }
+
+    return classes;
+}
+
+/* how well text matches (lower case) query, in order but not necessarily together; -1 if not at all */
+WC_INTERNAL int WC_menu_fuzzy_score(const char *text, const char *query)
+{
+    int i, score = 0, previous = -2, before = 0;
+
+    /* take each query character at its first chance, scoring more for */
+    /* runs and for the starts of words, and less for gaps */
+    for(i=0; text[i] && *query; i++)
+    {
+        int c = (unsigned char)text[i], lower = WC_menu_lower(c);
+
+        if(lower == *query)
+        {
+            score += 16;
+            if(i == previous + 1)
+                score += 12;
+            else if(previous >= 0)
+                score -= WC_menu_min(i - previous - 1, 8);
+            /* the start, after a separator, or an upper case letter after a lower case one */
+            if(!i || !((before >= 'a' && before <= 'z') || (before >= 'A' && before <= 'Z') || (before >= '0' && before <= '9')) ||
+               (c >= 'A' && c <= 'Z' && before >= 'a' && before <= 'z'))
+                score += 10;
+            previous = i;
+            query++;
+        }
+        before = c;
+    }
+
+    if(*query)
+        return -1;
+
+    /* between equal matches, the shorter item wins */
+    while(text[i])
+        i++;
+    return score * 64 - WC_menu_min(i, 63);
+}
+
+/* adds a match to a heap of at most WC_MENU_FUZZY_TOP, if it's better than the worst */
+WC_INTERNAL void WC_menu_match_push(WC_menuMatch *heap, int *count, int score, int item)
+{
+    int i, child;
+
+    /* the worst match is on top; lower scores are worse, then later items */
+    if(*count < WC_MENU_FUZZY_TOP)
+    {
+        for(i=(*count)++; i; i=(i-1)/2)
+        {
+            WC_menuMatch *parent = &heap[(i-1)/2];
+            if(parent->score < score || (parent->score == score && parent->item > item))
+                break;
+            heap[i] = *parent;
+        }
+        heap[i].score = score;
+        heap[i].item = item;
+        return;
+    }
+
+    if(score < heap[0].score || (score == heap[0].score && item > heap[0].item))
+        return;
+
+    /* replace the worst and sift it down */
+    for(i=0; (child = 2*i+1) < *count; i=child)
+    {
+        if(child + 1 < *count && (heap[child+1].score < heap[child].score ||
+           (heap[child+1].score == heap[child].score && heap[child+1].item > heap[child].item)))
+            child++;
+        if(score < heap[child].score || (score == heap[child].score && item > heap[child].item))
+            break;
+        heap[i] = heap[child];
+    }
+    heap[i].score = score;
+    heap[i].item = item;
+}
+
+/* qsort comparison putting better matches first */
+WC_INTERNAL int WC_menu_compare_match(const void *a, const void *b)
+{
+    const WC_menuMatch *ma = (const WC_menuMatch*)a, *mb = (const WC_menuMatch*)b;
+
+    if(ma->score != mb->score)
+        return ma->score > mb->score ? -1 : 1;
+    return ma->item < mb->item ? -1 : ma->item > mb->item;
+}
+
+/* (re)starts fuzzy ranking for filterText, dropping whatever was being ranked */
+WC_INTERNAL void WC_menu_rank_start(WC_menuState *state)
+{
+    int i;
+
+    if(!state->matches)
+        state->matches = (WC_menuMatch*)WC_menu_heap_alloc(state->menuItems, 2 * WC_MENU_WORKERS * WC_MENU_FUZZY_TOP * sizeof(WC_menuMatch));
+
+    /* room to remember each item's character classes */
+    if(state->numClassified < state->numMenuItems)
+    {
+        void *temp = WC_menu_heap_resize(state->menuItems, state->classes, state->numMenuItems * sizeof(WC_bits));
+        void *classified = WC_menu_heap_resize(state->menuItems, state->classified, state->numMenuItems * sizeof(char*));
+        if(temp)
+            state->classes = (WC_bits*)temp;
+        if(classified)
+            state->classified = (char**)classified;
+        if(temp && classified)
+        {
+            memset(&state->classified[state->numClassified], 0, (state->numMenuItems - state->numClassified) * sizeof(char*));
+            state->numClassified = state->numMenuItems;
+        }
+    }
+
+    if(!state->matches || !WC_menu_view_room(state, WC_MENU_FUZZY_TOP))
+    {
+        /* can't rank, so list nothing rather than everything */
+        state->numView = 0;
+        state->rankNext = state->numMenuItems;
+        return;
+    }
+
+    for(i=0; i<state->filterLength; i++)
+        state->filterLower[i] = (char)WC_menu_lower((unsigned char)state->filterText[i]);
+    state->filterLower[state->filterLength] = '\0';
+    state->filterClasses = WC_menu_char_classes(state->filterLower);
+
+    for(i=0; i<WC_MENU_WORKERS; i++)
+        state->numMatches[i] = 0;
+    state->numView = 0;
+    state->rankNext = 0;
+}
+
+/* worker's part of ranking items first to last-1, into its heap */
+WC_INTERNAL void WC_menu_rank_part(WC_menuState *state, int worker, int first, int last)
+{
+    char **items = state->menuItems->items;
+    WC_menuMatch *heap = &state->matches[worker * WC_MENU_FUZZY_TOP];
+    WC_bits query = state->filterClasses;
+    int i, score, parts = 1, size;
+
+#ifdef WC_MENU_THREADS
+    if(state->pool)
+        parts = state->pool->numThreads + 1;
+#endif
+    /* each worker takes its own slice of the chunk */
+    size = (last - first + parts - 1) / parts;
+    first += worker * size;
+    last = WC_menu_min(last, first + size);
+
+    for(i=first; i<last; i++)
+    {
+        /* an item without every character class in the query can't match */
+        if(i < state->numClassified)
+        {
+            if(state->classified[i] != items[i])
+            {
+                state->classified[i] = items[i];
+                state->classes[i] = WC_menu_char_classes(items[i]);
+            }
+            if(query & ~state->classes[i])
+                continue;
+        }
+
+        score = WC_menu_fuzzy_score(items[i], state->filterLower);
+        if(score >= 0)
+            WC_menu_match_push(heap, &state->numMatches[worker], score, i);
+    }
+}
+
+/* ranks chunks until the items run out or it's time until, then lists the best so far */
+WC_INTERNAL void WC_menu_rank(WC_menuState *state, WC_time until)
+{
+    WC_menuMatch *sorted = &state->matches[WC_MENU_WORKERS * WC_MENU_FUZZY_TOP];
+    int i, count = 0;
+
+    while(state->rankNext < state->numMenuItems)
+    {
+        int first = state->rankNext, last = WC_menu_min(state->numMenuItems, first + WC_MENU_RANK_CHUNK * WC_MENU_WORKERS);
+
+#ifdef WC_MENU_THREADS
+        WC_menu_pool_rank(state, first, last);
+#else
+        WC_menu_rank_part(state, 0, first, last);
+#endif
+        state->rankNext = last;
+        if(WC_menu_now() >= until)
+            break;
+    }
+
+    /* the best of every worker's best, in order */
+    for(i=0; i<WC_MENU_WORKERS; i++)
+    {
+        memcpy(&sorted[count], &state->matches[i * WC_MENU_FUZZY_TOP], state->numMatches[i] * sizeof(WC_menuMatch));
+        count += state->numMatches[i];
+    }
+    qsort(sorted, count, sizeof(WC_menuMatch), WC_menu_compare_match);
+
+    state->numView = WC_menu_min(count, WC_MENU_FUZZY_TOP);
+    for(i=0; i<state->numView; i++)
+        state->view[i] = sorted[i].item;
+}
+
+#ifdef WC_MENU_THREADS
+/* ranks first to last-1 with the help of the pool's threads, starting them if needed */
+WC_INTERNAL void WC_menu_pool_rank(WC_menuState *state, int first, int last)
+{
+    WC_menuPool *pool = state->pool;
+
+    if(!pool)
+    {
+        int t;
+
+        pool = state->pool = (WC_menuPool*)WC_menu_heap_alloc(state->menuItems, sizeof(WC_menuPool));
+        if(!pool)
+        {
+            WC_menu_rank_part(state, 0, first, last);
+            return;
+        }
+        memset(pool, 0, sizeof(WC_menuPool));
+        pthread_mutex_init(&pool->lock, NULL);
+        pthread_cond_init(&pool->start, NULL);
+        pthread_cond_init(&pool->done, NULL);
+        for(t=0; t<WC_MENU_THREADS; t++)
+        {
+            if(pthread_create(&pool->threads[t], NULL, WC_menu_pool_thread, pool))
+                break;
+        }
+        /* with fewer threads, each does a bigger part */
+        pool->numThreads = t;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->state = state;
+    pool->first = first;
+    pool->last = last;
+    pool->busy = pool->numThreads;
+    pool->job++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    /* this thread does part 0 */
+    WC_menu_rank_part(state, 0, first, last);
+
+    pthread_mutex_lock(&pool->lock);
+    while(pool->busy)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* a pool thread, ranking its part of each chunk */
+WC_INTERNAL void *WC_menu_pool_thread(void *arg)
+{
+    WC_menuPool *pool = (WC_menuPool*)arg;
+    unsigned int job = 0;
+    int part;
+
+    pthread_mutex_lock(&pool->lock);
+    part = ++pool->numJoined;
+    for(;;)
+    {
+        while(!pool->quit && pool->job == job)
+            pthread_cond_wait(&pool->start, &pool->lock);
+        if(pool->quit)
+            break;
+        job = pool->job;
+        pthread_mutex_unlock(&pool->lock);
+
+        WC_menu_rank_part(pool->state, part, pool->first, pool->last);
+
+        pthread_mutex_lock(&pool->lock);
+        if(!--pool->busy)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return 0;
+}
+
+/* stops the pool's threads and frees it */
+WC_INTERNAL void WC_menu_pool_end(WC_menuState *state)
+{
+    WC_menuPool *pool = state->pool;
+    int t;
+
+    if(!pool)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for(t=0; t<pool->numThreads; t++)
+        pthread_join(pool->threads[t], NULL);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    WC_menu_heap_free(state->menuItems, pool);
+    state->pool = 0;
+}
+#endif
+
+/* records a draw call in the frame, to be handed to the program by WC_menu_flush */
+WC_INTERNAL void WC_menu_emit(WC_menuFrame *frame, int y, int x, char *string, int length, int color)
+{
+    WC_menuSpan *span;
+
+    if(length <= 0)
+        return;
+
+    if(frame->numSpans == frame->maxSpans)
+    {
+        int maxSpans = frame->maxSpans ? frame->maxSpans * 2 : 64;
+        void *temp = WC_menu_heap_resize(frame->menuItems, frame->spans, maxSpans*sizeof(WC_menuSpan));
+        if(!temp)
+            return;
+        frame->spans = (WC_menuSpan*)temp;
+        frame->maxSpans = maxSpans;
+    }
+
+    span = &frame->spans[frame->numSpans++];
+    span->y = y;
+    span->x = x;
+    span->string = string;
+    span->length = length;
+    span->color = color;
+}
+
+/* draws the frame's spans into the back-buffer and replaces them with spans for only the changed cells */
+WC_INTERNAL void WC_menu_diff(MenuItems *menuItems, WC_menuFrame *frame)
+{
+    int i, y, x, numSpans = frame->numSpans, size = menuItems->sy * menuItems->sx;
+
+    /* make the buffers the 1st time through.  screenColors starts as all 0 so everything gets drawn once */
+    if(!frame->cells)
+    {
+        frame->cells = (char*)WC_menu_heap_alloc(menuItems, size);
+        frame->colors = (unsigned char*)WC_menu_heap_alloc(menuItems, size);
+        frame->screenCells = (char*)WC_menu_heap_alloc(menuItems, size);
+        frame->screenColors = (unsigned char*)WC_menu_heap_alloc(menuItems, size);
+        if(!frame->cells || !frame->colors || !frame->screenCells || !frame->screenColors)
+        {
+            /* no back-buffer, draw the spans as they are */
+            menuItems->useBackBuffer = 0;
+            return;
+        }
+        memset(frame->colors, 0, size);
+        memset(frame->screenColors, 0, size);
+    }
+
+    /* draw the spans into the cells, clipped to the screen */
+    frame->top = menuItems->sy;
+    frame->left = menuItems->sx;
+    frame->bottom = frame->right = -1;
+    for(i=0; i<numSpans; i++)
+    {
+        WC_menuSpan *span = &frame->spans[i];
+        char *string = span->string;
+        int end = WC_menu_min(span->x + span->length, menuItems->sx);
+
+        if(span->y < 0 || span->y >= menuItems->sy)
+            continue;
+
+        for(x=span->x; x<end; x++)
+        {
+            /* like the drawFunction, pad out with spaces once the string ends */
+            char c = *string ? *string++ : ' ';
+            if(x < 0)
+                continue;
+            frame->cells[span->y * menuItems->sx + x] = c;
+            frame->colors[span->y * menuItems->sx + x] = (unsigned char)span->color;
+        }
+
+        frame->top = WC_menu_min(frame->top, span->y);
+        frame->bottom = WC_menu_max(frame->bottom, span->y);
+        frame->left = WC_menu_max(0, WC_menu_min(frame->left, span->x));
+        frame->right = WC_menu_max(frame->right, end - 1);
+    }
+
+    /* emit runs of same-colour cells that differ from what's on-screen, in place of the spans */
+    frame->numSpans = 0;
+    menuItems->cellsChanged = 0;
+    for(y=frame->top; y<=frame->bottom; y++)
+    {
+        int row = y * menuItems->sx;
+
+        x = frame->left;
+        while(x <= frame->right)
+        {
+            int start = row + x, color = frame->colors[start];
+
+            if(!color || (frame->cells[start] == frame->screenCells[start] && color == frame->screenColors[start]))
+            {
+                x++;
+                continue;
+            }
+
+            do
+            {
+                frame->screenCells[row + x] = frame->cells[row + x];
+                frame->screenColors[row + x] = (unsigned char)color;
+                x++;
+            } while(x <= frame->right && frame->colors[row + x] == color &&
+                    (frame->cells[row + x] != frame->screenCells[row + x] || color != frame->screenColors[row + x]));
+
+            WC_menu_emit(frame, y, start - row, &frame->cells[start], row + x - start, color);
+            menuItems->cellsChanged += row + x - start;
+        }
+
+        /* cells not drawn next frame must not look drawn */
+        memset(&frame->colors[row + frame->left], 0, frame->right - frame->left + 1);
+    }
+}
+
+/* hands the recorded frame to drawBatchFunction (or drawFunction per span) and empties it */
+WC_INTERNAL void WC_menu_flush(MenuItems *menuItems, WC_menuFrame *frame)
+{
+#ifdef WC_MENU_STATS
+    WC_time drawn;
+#endif
+
+    if(menuItems->useBackBuffer)
+        WC_menu_diff(menuItems, frame);
+
+#ifdef WC_MENU_STATS
+    WC_menu_stats_spans(&menuItems->stats, frame);
+    drawn = WC_menu_now();
+#endif
+    if(menuItems->drawBatchFunction)
+        menuItems->drawBatchFunction(menuItems, frame->spans, frame->numSpans);
+    else
+        WC_menu_draw_spans(menuItems, frame->spans, frame->numSpans);
+#ifdef WC_MENU_STATS
+    menuItems->stats.drawTime += WC_menu_now() - drawn;
+#endif
+
+    frame->numSpans = 0;
+}
+
+/* calls menuItems->drawFunction for each span */
+WC_GLOBAL void WC_menu_draw_spans(MenuItems *menuItems, WC_menuSpan *spans, int numSpans)
+{
+    int i;
+
+    for(i=0; i<numSpans; i++)
+        menuItems->drawFunction(spans[i].y, spans[i].x, spans[i].string, spans[i].length, spans[i].color);
+}
+
+/* inits a MenuItems struct to sane values */
+WC_GLOBAL void WC_menuInit(MenuItems *menuItems)
+{
+    menuItems->sy = menuItems->sx = WC_NONE;
+    menuItems->inputFunction = 0;
+    menuItems->drawFunction = 0;
+    menuItems->showFunction = 0;
+    menuItems->drawBatchFunction = 0;
+    menuItems->getItem = 0;
+    menuItems->getState = 0;
+    menuItems->waitFunction = 0;
+    menuItems->useBackBuffer = 0;
+    menuItems->cellsChanged = 0;
+    menuItems->filterMode = WC_FILTER_NONE;
+    menuItems->jumpItem = 0;
+    menuItems->y = menuItems->x = menuItems->height = menuItems->width = WC_NONE;
+    menuItems->title_height = menuItems->footer_height = 2;
+    menuItems->title = menuItems->footer = 0;
+    menuItems->items = 0;
+    menuItems->states = 0;
+    menuItems->callbacks = 0;
+    menuItems->userData_ptr = 0;
+    menuItems->numItems = menuItems->numStates = menuItems->numCallbacks = WC_NONE;
+    menuItems->mallocFunction = 0;
+    menuItems->reallocFunction = 0;
+    menuItems->freeFunction = 0;
+    menuItems->allocContext = 0;
+    menuItems->intern = 0;
+    menuItems->queue = 0;
+    menuItems->asyncCallbacks = 0;
+    menuItems->numAsyncCallbacks = 0;
+    menuItems->readEvents = 0;
+    menuItems->drawContext = 0;
+    menuItems->inputMenuFunction = 0;
+    menuItems->readMenuEvents = 0;
+    menuItems->waitMenuFunction = 0;
+    menuItems->showMenuFunction = 0;
+    menuItems->busyColor = WC_CLR_BUSY;
+    menuItems->selfOwnsMemory = 0;
+    menuItems->selfOwnsHeap = 0;
+    menuItems->arena = 0;
+    menuItems->chunks = 0;
+    menuItems->numChunks = menuItems->chunksCapacity = 0;
+    memset(menuItems->freeBlocks, 0, sizeof(menuItems->freeBlocks));
+    menuItems->runningState = 0;
+    menuItems->job = 0;
+#ifdef WC_MENU_STATS
+    memset(&menuItems->stats, 0, sizeof(WC_menuStats));
+#endif
+}
+
+/* clone all of the elements in a menuItems, in place, so the */
+/* memory belongs to this menuItems.  Sets selfOwnsMemory to 1 */
+WC_GLOBAL void WC_menu_take_ownership(MenuItems *menuItems)
+{
+    int i, length;
+    void *temp;
+
+    if(menuItems->selfOwnsHeap)
+        return;
+
+    menuItems->title = WC_menu_heap_strdup(menuItems, menuItems->title);
+    menuItems->footer = WC_menu_heap_strdup(menuItems, menuItems->footer);
+
+    /* a getItem provider's items aren't the menu's to copy */
+    if(menuItems->items)
+    {
+        length = WC_menu_num_items(menuItems);
+        temp = WC_menu_heap_alloc(menuItems, (length+1)*sizeof(char*));
+        if(temp)
+        {
+            for(i=0;i<length;i++)
+                ((char**)temp)[i] = WC_menu_heap_strdup(menuItems, menuItems->items[i]);
+            ((char**)temp)[length] = 0;
+            menuItems->items = (char**)temp;
+        }
+    }
+
+    if(menuItems->states)
+    {
+        length = WC_menu_num_states(menuItems)+1;
+        temp = WC_menu_heap_alloc(menuItems, length*sizeof(int));
+        if(temp)
+        {
+            memcpy(temp, menuItems->states, (length-1)*sizeof(int));
+            ((int*)temp)[length-1] = 0;
+            menuItems->states = (int*)temp;
+        }
+    }
+
+    if(menuItems->callbacks)
+    {
+        length = WC_menu_num_callbacks(menuItems)+1;
+        temp = WC_menu_heap_alloc(menuItems, length*sizeof(cbf_ptr));
+        if(temp)
+        {
+            memcpy(temp, menuItems->callbacks, (length-1)*sizeof(cbf_ptr));
+            ((cbf_ptr*)temp)[length-1] = 0;
+            menuItems->callbacks = (cbf_ptr*)temp;
+        }
+    }
+
+    menuItems->selfOwnsMemory = 1;
+    menuItems->selfOwnsHeap = 1;
+}
+
+/* copies the arrays (not the text) into the menu's arena.  Sets selfOwnsMemory to 1 */
+WC_GLOBAL void WC_menu_own_arrays(MenuItems *menuItems)
+{
+    int numItems = 0, numStates = 0, numCallbacks = 0;
+    size_t size = 0;
+    void *array;
+
+    /* take_ownership's copies are the menu's already */
+    if(menuItems->selfOwnsHeap)
+        return;
+    /* a getItem provider's items aren't the menu's to copy, and arrays */
+    /* already copied (by WC_menu_set_item etc.) aren't copied again */
+    if(menuItems->items && !WC_menu_arena_owns(menuItems, menuItems->items))
+        numItems = WC_menu_num_items(menuItems) + 1;
+    if(menuItems->states && !WC_menu_arena_owns(menuItems, menuItems->states))
+        numStates = WC_menu_num_states(menuItems) + 1;
+    if(menuItems->callbacks && !WC_menu_arena_owns(menuItems, menuItems->callbacks))
+        numCallbacks = WC_menu_num_callbacks(menuItems) + 1;
+
+    /* from here on WC_menu_malloc etc. use the arena */
+    menuItems->selfOwnsMemory = 1;
+    if(!numItems && !numStates && !numCallbacks)
+        return;
+
+    /* add up what the copies need, so they all fit in one chunk */
+    size += sizeof(WC_menuArenaBlock) + WC_menu_arena_round(numItems*sizeof(char*));
+    size += sizeof(WC_menuArenaBlock) + WC_menu_arena_round(numStates*sizeof(int));
+    size += sizeof(WC_menuArenaBlock) + WC_menu_arena_round(numCallbacks*sizeof(cbf_ptr));
+    if(!menuItems->arena || menuItems->arena->size - menuItems->arena->used < size)
+        WC_menu_arena_grow(menuItems, size);
+
+    if(numItems && (array = WC_menu_own_array(menuItems, menuItems->items, numItems - 1, sizeof(char*))))
+        menuItems->items = (char**)array;
+    if(numStates && (array = WC_menu_own_array(menuItems, menuItems->states, numStates - 1, sizeof(int))))
+        menuItems->states = (int*)array;
+    if(numCallbacks && (array = WC_menu_own_array(menuItems, menuItems->callbacks, numCallbacks - 1, sizeof(cbf_ptr))))
+        menuItems->callbacks = (cbf_ptr*)array;
+}
+
+/* if selfOwnsMemory is 1, frees the arena and everything in it, and take_ownership's heap copies */
+WC_GLOBAL void WC_menu_cleanup(MenuItems *menuItems)
+{
+    if(menuItems->selfOwnsMemory)
+    {
+        if(menuItems->selfOwnsHeap)
+        {
+            int i, length = menuItems->items ? WC_menu_num_items(menuItems) : 0;
+
+            /* text the arena (or a pool) doesn't have is the heap's, as are the arrays */
+            WC_menu_free_text(menuItems, menuItems->title);
+            WC_menu_free_text(menuItems, menuItems->footer);
+            menuItems->title = menuItems->footer = 0;
+            for(i=0;i<length;i++)
+                WC_menu_free_text(menuItems, menuItems->items[i]);
+            if(!WC_menu_arena_owns(menuItems, menuItems->items))
+                WC_menu_heap_free(menuItems, menuItems->items);
+            if(!WC_menu_arena_owns(menuItems, menuItems->states))
+                WC_menu_heap_free(menuItems, menuItems->states);
+            if(!WC_menu_arena_owns(menuItems, menuItems->callbacks))
+                WC_menu_heap_free(menuItems, menuItems->callbacks);
+            menuItems->items = 0;
+            menuItems->states = 0;
+            menuItems->callbacks = 0;
+            menuItems->selfOwnsHeap = 0;
+        }
+
+        /* what was copied goes with the arena, what wasn't stays the user's */
+        if(WC_menu_arena_owns(menuItems, menuItems->title))
+            menuItems->title = 0;
+        if(WC_menu_arena_owns(menuItems, menuItems->footer))
+            menuItems->footer = 0;
+        if(WC_menu_arena_owns(menuItems, menuItems->items))
             menuItems->items = 0;
+        if(WC_menu_arena_owns(menuItems, menuItems->states))
+            menuItems->states = 0;
+        if(WC_menu_arena_owns(menuItems, menuItems->callbacks))
+            menuItems->callbacks = 0;
+
+        /* everything owned is in the arena, so it goes a chunk at a time */
+        while(menuItems->arena)
+        {
+            WC_menuArena *next = menuItems->arena->next;
+            WC_menu_heap_free(menuItems, menuItems->arena);
+            menuItems->arena = next;
+        }
+        WC_menu_heap_free(menuItems, menuItems->chunks);
+        menuItems->chunks = 0;
+        menuItems->numChunks = menuItems->chunksCapacity = 0;
+        memset(menuItems->freeBlocks, 0, sizeof(menuItems->freeBlocks));
+        menuItems->selfOwnsMemory = 0;
+    }
+}
+
+/* malloc through menuItems' mallocFunction, if it has one */
+WC_INTERNAL void *WC_menu_heap_alloc(MenuItems *menuItems, size_t size)
+{
+    if(menuItems && menuItems->mallocFunction)
+        return menuItems->mallocFunction(menuItems->allocContext, size);
+
+    return malloc(size);
+}
+
+/* realloc through menuItems' reallocFunction, if it has one */
+WC_INTERNAL void *WC_menu_heap_resize(MenuItems *menuItems, void *ptr, size_t size)
+{
+    if(menuItems && menuItems->reallocFunction)
+        return menuItems->reallocFunction(menuItems->allocContext, ptr, size);
+
+    return realloc(ptr, size);
+}
+
+/* free through menuItems' freeFunction, if it has one */
+WC_INTERNAL void WC_menu_heap_free(MenuItems *menuItems, void *ptr)
+{
+    if(!ptr)
+        return;
+
+    if(menuItems && menuItems->freeFunction)
+        menuItems->freeFunction(menuItems->allocContext, ptr);
+    else
+        free(ptr);
+}
+
+/* a heap copy of text with the menu's mallocFunction; 0 for 0 */
+WC_INTERNAL char *WC_menu_heap_strdup(MenuItems *menuItems, const char *text)
+{
+    size_t length;
+    char *copy;
+
+    if(!text)
+        return 0;
+    length = strlen(text) + 1;
+    copy = (char*)WC_menu_heap_alloc(menuItems, length);
+    if(copy)
+        memcpy(copy, text, length);
+
+    return copy;
+}
+
+/* starts a new arena chunk with room for at least size bytes of blocks */
+WC_INTERNAL int WC_menu_arena_grow(MenuItems *menuItems, size_t size)
+{
+    WC_menuArena *chunk;
+    /* each chunk twice the last, up to a limit, so a growing menu needs few */
+    size_t chunkSize = menuItems->arena ? WC_menu_min(menuItems->arena->size * 2, (size_t)WC_MENU_ARENA_CHUNK_MAX) : WC_MENU_ARENA_CHUNK;
+    WC_menuArena *older = menuItems->arena;
+    int low = 0, high = menuItems->numChunks;
+
+    /* room to list the chunk that's no longer the newest, before making the new one */
+    if(older && menuItems->numChunks == menuItems->chunksCapacity)
+    {
+        int capacity = menuItems->chunksCapacity ? menuItems->chunksCapacity * 2 : 16;
+        WC_menuArena **chunks = (WC_menuArena**)WC_menu_heap_resize(menuItems, menuItems->chunks, capacity * sizeof(WC_menuArena*));
+
+        if(!chunks)
+            return 0;
+        menuItems->chunks = chunks;
+        menuItems->chunksCapacity = capacity;
+    }
+
+    chunkSize = WC_menu_max(chunkSize, size);
+    chunk = (WC_menuArena*)WC_menu_heap_alloc(menuItems, sizeof(WC_menuArena) + chunkSize);
+    if(!chunk)
+        return 0;
+
+    chunk->next = older;
+    chunk->size = chunkSize;
+    chunk->used = 0;
+    menuItems->arena = chunk;
+    if(!older)
+        return 1;
+
+    /* in address order, which the heap needn't hand chunks out in */
+    while(low < high)
+    {
+        int middle = (low + high) / 2;
+
+        if(menuItems->chunks[middle] < older)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    memmove(&menuItems->chunks[low + 1], &menuItems->chunks[low], (menuItems->numChunks - low) * sizeof(WC_menuArena*));
+    menuItems->chunks[low] = older;
+    menuItems->numChunks++;
+
+    return 1;
+}
+
+/* a block of size bytes from the menu's arena, starting a new chunk if needed */
+WC_INTERNAL void *WC_menu_arena_alloc(MenuItems *menuItems, size_t size)
+{
+    WC_menuArena *chunk = menuItems->arena;
+    WC_menuArenaBlock *block;
+    size_t capacity = WC_menu_arena_round(size), need = sizeof(WC_menuArenaBlock) + capacity;
+    void *reused;
+
+    /* a block given back, if one fits */
+    if(capacity && (reused = WC_menu_arena_reuse(menuItems, capacity)))
+        return reused;
+
+    /* what's left in the old chunk is lost, but chunks grow so it's never much */
+    if(!chunk || chunk->size - chunk->used < need)
+    {
+        if(!WC_menu_arena_grow(menuItems, need))
+            return 0;
+        chunk = menuItems->arena;
+    }
+
+    block = (WC_menuArenaBlock*)((char*)&chunk->first + chunk->used);
+    block->capacity = capacity;
+    chunk->used += need;
+
+    return block + 1;
+}
+
+/* 1 if ptr is the block most recently handed out by the menu's arena */
+WC_INTERNAL int WC_menu_arena_last(MenuItems *menuItems, void *ptr)
+{
+    WC_menuArena *chunk = menuItems->arena;
+    char *start, *end;
+
+    if(!chunk)
+        return 0;
+
+    /* check ptr is in the chunk before looking at its header */
+    start = (char*)&chunk->first;
+    end = start + chunk->used;
+    if((char*)ptr <= start || (char*)ptr > end)
+        return 0;
+
+    return (char*)ptr + ((WC_menuArenaBlock*)ptr - 1)->capacity == end;
+}
+
+/* 1 if ptr is in one of the menu's arena chunks */
+WC_INTERNAL int WC_menu_arena_owns(MenuItems *menuItems, const void *ptr)
+{
+    WC_menuArena *chunk = menuItems->arena;
+    const char *start;
+    int low = 0, high = menuItems->numChunks;
+
+    if(!chunk)
+        return 0;
+
+    /* most of what's asked about is in the newest chunk */
+    start = (const char*)&chunk->first;
+    if((const char*)ptr > start && (const char*)ptr <= start + chunk->used)
+        return 1;
+
+    /* else the last older chunk starting below ptr is the only one it can be in */
+    while(low < high)
+    {
+        int middle = (low + high) / 2;
+
+        if((const char*)&menuItems->chunks[middle]->first < (const char*)ptr)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    if(!low)
+        return 0;
+    chunk = menuItems->chunks[low - 1];
+    start = (const char*)&chunk->first;
+
+    return (const char*)ptr <= start + chunk->used;
+}
+
+/* gives back text the menu owns: an arena copy, or after WC_menu_take_ownership a heap one */
+WC_INTERNAL void WC_menu_free_text(MenuItems *menuItems, char *text)
+{
+    if(!text)
+        return;
+
+    if(WC_menu_arena_owns(menuItems, text))
+        WC_menu_arena_release(menuItems, text);
+    else if(menuItems->selfOwnsHeap && !(menuItems->intern && WC_menu_intern_owns(menuItems->intern, text)))
+        WC_menu_heap_free(menuItems, text);
+}
+
+/* list n holds blocks of 2^n up to 2^(n+1) block headers' worth */
+WC_INTERNAL int WC_menu_arena_bin(size_t capacity)
+{
+    size_t units = capacity / sizeof(WC_menuArenaBlock);
+    int bin = 0;
+
+    while(units > 1 && bin < WC_MENU_ARENA_BINS - 1)
+    {
+        units >>= 1;
+        bin++;
+    }
+
+    return bin;
+}
+
+/* the newest block shrinks its chunk, others wait on a free list, linked through their 1st bytes */
+WC_INTERNAL void WC_menu_arena_release(MenuItems *menuItems, void *ptr)
+{
+    size_t capacity = ((WC_menuArenaBlock*)ptr - 1)->capacity;
+    int bin;
+
+    if(WC_menu_arena_last(menuItems, ptr))
+    {
+        menuItems->arena->used -= sizeof(WC_menuArenaBlock) + capacity;
+        return;
+    }
+    /* a block of 0 bytes has no room for the link, and nothing to reuse */
+    if(!capacity)
+        return;
+
+    bin = WC_menu_arena_bin(capacity);
+    *(void**)ptr = menuItems->freeBlocks[bin];
+    menuItems->freeBlocks[bin] = ptr;
+}
+
+/* first fit among the first few of the block's own size, or else any of the next size up */
+WC_INTERNAL void *WC_menu_arena_reuse(MenuItems *menuItems, size_t capacity)
+{
+    int bin = WC_menu_arena_bin(capacity), tries = 8;
+    void **link = &menuItems->freeBlocks[bin], *block;
+
+    /* the same size's blocks can be smaller than capacity */
+    while(*link && tries-- && ((WC_menuArenaBlock*)*link - 1)->capacity < capacity)
+        link = (void**)*link;
+    if(!*link || ((WC_menuArenaBlock*)*link - 1)->capacity < capacity)
+    {
+        /* the next size's are all bigger, and no more than 4 times as big (the last list's can be smaller) */
+        if(bin + 1 >= WC_MENU_ARENA_BINS || !menuItems->freeBlocks[bin + 1])
+            return 0;
+        link = &menuItems->freeBlocks[bin + 1];
+    }
+
+    block = *link;
+    *link = *(void**)block;
+
+    return block;
+}
+
+/* array if it's in the arena already (or take_ownership's), or else a 0-terminated copy of it there */
+WC_INTERNAL void *WC_menu_own_array(MenuItems *menuItems, void *array, int count, size_t size)
+{
+    char *copy;
+
+    if(menuItems->selfOwnsHeap || WC_menu_arena_owns(menuItems, array))
+        return array;
+
+    menuItems->selfOwnsMemory = 1;
+    copy = (char*)WC_menu_arena_alloc(menuItems, (count+1)*size);
+    if(copy)
+    {
+        memcpy(copy, array, count*size);
+        memset(copy + count*size, 0, size);
+    }
+
+    return copy;
+}
+
+/* forgets a running menu's length, sort position and character classes for item index */
+WC_INTERNAL void WC_menu_forget_item(WC_menuState *state, int index)
+{
+    if(index < state->numLengths)
+        state->lengths[index] = WC_NONE;
+    /* sync_index and ranking spot changed text by its address */
+    if(state->sorted && index < state->numSorted)
+        state->indexed[index] = 0;
+    if(index < state->numClassified)
+        state->classified[index] = 0;
+}
+
+/* forgets a running menu's lengths and character classes from item first on */
+WC_INTERNAL void WC_menu_forget_items(WC_menuState *state, int first)
+{
+    int i;
+
+    /* moved text is measured again anyway, but new text can be where removed text was */
+    for(i=first; i<state->numLengths; i++)
+        state->lengths[i] = WC_NONE;
+    if(first < state->numClassified)
+        memset(&state->classified[first], 0, (state->numClassified - first) * sizeof(char*));
+}
+
+/* records that items first to last changed, for WC_menu_refresh */
+WC_INTERNAL void WC_menu_changed(WC_menuState *state, char **items, int first, int last)
+{
+    /* a menu up to date with the array that was changed is up to date with the one it's in now */
+    if(items == state->knownItems)
+        state->knownItems = state->menuItems->items;
+
+    if(state->dirtyFirst > state->dirtyLast)
+    {
+        state->dirtyFirst = first;
+        state->dirtyLast = last;
+    }
+    else
+    {
+        state->dirtyFirst = WC_menu_min(state->dirtyFirst, first);
+        state->dirtyLast = WC_menu_max(state->dirtyLast, last);
+    }
+    state->generation++;
+}
+
+/* grows an array to room for count entries in the arena, at least doubling it; */
+/* one that isn't the arena's (used entries of it) is copied there, and left as it was, */
+/* unless take_ownership made it, when it stays on the heap where the program can realloc it */
+WC_INTERNAL void *WC_menu_grow_array(MenuItems *menuItems, void *array, int used, int count, size_t size)
+{
+    size_t capacity;
+    void *copy;
+
+    if(array && menuItems->selfOwnsHeap && !WC_menu_arena_owns(menuItems, array))
+        return WC_menu_heap_resize(menuItems, array, count * size);
+    if(array && !WC_menu_arena_owns(menuItems, array))
+    {
+        copy = WC_menu_arena_alloc(menuItems, WC_menu_max(count, used * 2) * size);
+        if(copy)
+            memcpy(copy, array, used * size);
+        return copy;
+    }
+
+    capacity = array ? ((WC_menuArenaBlock*)array - 1)->capacity : 0;
+    if(count * size <= capacity)
+        return array;
+
+    return WC_menu_realloc(menuItems, array, WC_menu_max(count * size, capacity * 2));
+}
+
+/* malloc from the arena if the menu owns its memory, or else the heap */
+WC_GLOBAL void *WC_menu_malloc(MenuItems *menuItems, size_t size)
+{
+    if(menuItems->selfOwnsMemory)
+        return WC_menu_arena_alloc(menuItems, size);
+
+    return WC_menu_heap_alloc(menuItems, size);
+}
+
+/* realloc in the arena if the menu owns its memory, or else the heap */
+WC_GLOBAL void *WC_menu_realloc(MenuItems *menuItems, void *ptr, size_t size)
+{
+    WC_menuArenaBlock *block;
+    void *temp;
+
+    /* memory from before the menu owned its memory is still the heap's */
+    if(!menuItems->selfOwnsMemory || (ptr && !WC_menu_arena_owns(menuItems, ptr)))
+        return WC_menu_heap_resize(menuItems, ptr, size);
+    if(!ptr)
+        return WC_menu_arena_alloc(menuItems, size);
+
+    block = (WC_menuArenaBlock*)ptr - 1;
+    if(size <= block->capacity)
+        return ptr;
+
+    /* the newest block can grow where it is, if the chunk has room */
+    if(WC_menu_arena_last(menuItems, ptr) &&
+       menuItems->arena->size - menuItems->arena->used >= WC_menu_arena_round(size) - block->capacity)
+    {
+        menuItems->arena->used += WC_menu_arena_round(size) - block->capacity;
+        block->capacity = WC_menu_arena_round(size);
+        return ptr;
+    }
+
+    /* otherwise it moves, to a block twice as big so growing it one */
+    /* entry at a time (like appending items) doesn't move it every time */
+    temp = WC_menu_arena_alloc(menuItems, WC_menu_max(size, block->capacity * 2));
+    if(temp)
+    {
+        memcpy(temp, ptr, block->capacity);
+        WC_menu_arena_release(menuItems, ptr);
+    }
+
+    return temp;
+}
+
+/* frees to the heap, or gives an arena block back for reuse */
+WC_GLOBAL void WC_menu_free(MenuItems *menuItems, void *ptr)
+{
+    if(!ptr)
+        return;
+
+    if(!menuItems->selfOwnsMemory)
+        WC_menu_heap_free(menuItems, ptr);
+    else if(WC_menu_arena_owns(menuItems, ptr))
+        WC_menu_arena_release(menuItems, ptr);
+}
+
+/* strdup with WC_menu_malloc */
+WC_GLOBAL char *WC_menu_strdup(MenuItems *menuItems, const char *string)
+{
+    size_t length;
+    char *copy;
+
+    if(!string)
+        return 0;
+
+    length = strlen(string) + 1;
+    copy = (char*)WC_menu_malloc(menuItems, length);
+    if(copy)
+        memcpy(copy, string, length);
+
+    return copy;
+}
+
+/* 1 if the running menu counts items of each length, starting the count if needed */
+WC_INTERNAL int WC_menu_track_widths(WC_menuState *state)
+{
+    int i;
+
+    /* only a width that was worked out follows the items */
+    if(!(state->autoSize & WC_AUTO_WIDTH) || state->menuItems->getItem)
+        return 0;
+    if(state->numWidths)
+        return 1;
+
+    /* lengths past the screen's width all make the menu as wide as it goes */
+    state->widths = (int*)WC_menu_heap_alloc(state->menuItems, (state->menuItems->sx + 1) * sizeof(int));
+    if(!state->widths)
+        return 0;
+    memset(state->widths, 0, (state->menuItems->sx + 1) * sizeof(int));
+    state->numWidths = state->menuItems->sx + 1;
+    state->maxLength = 0;
+
+    for(i=0; i<state->numMenuItems; i++)
+        WC_menu_count_width(state, WC_menu_item_length(state, i), 1);
+
+    return 1;
+}
+
+/* adds count (1 or -1) items of length to widths */
+WC_INTERNAL void WC_menu_count_width(WC_menuState *state, int length, int count)
+{
+    length = WC_menu_min(length, state->numWidths - 1);
+    state->widths[length] += count;
+    if(length > state->maxLength)
+        state->maxLength = length;
+    /* if the longest went, the next longest is the nearest count below that isn't 0 */
+    while(state->maxLength && !state->widths[state->maxLength])
+        state->maxLength--;
+}
+
+/* works out again what WC_menu_begin worked out of the menu's position and size */
+WC_INTERNAL void WC_menu_fit(WC_menuState *state)
+{
+    MenuItems *menuItems = state->menuItems;
+    int _y = state->autoSize & WC_AUTO_Y ? 0 : menuItems->y;
+    int _x = state->autoSize & WC_AUTO_X ? 0 : menuItems->x;
+
+    if(state->autoSize & WC_AUTO_HEIGHT)
+        menuItems->height = WC_menu_min(state->numMenuItems + state->numMenuHeaders + state->numMenuFooters, menuItems->sy - _y - 1);
+    /* the width follows the items once they've been counted, which is when they first change */
+    if(state->numWidths)
+        menuItems->width = WC_menu_min(WC_menu_max(state->maxLength, state->titleLength), menuItems->sx - _x - 2);
+    if(state->autoSize & WC_AUTO_Y)
+        menuItems->y = WC_menu_max(0,(int)((menuItems->sy-menuItems->height)/2));
+    if(state->autoSize & WC_AUTO_X)
+        menuItems->x = WC_menu_max(0,(int)((menuItems->sx-(menuItems->width+2))/2));
+    state->numVisibleItems = menuItems->height - (state->numMenuHeaders + state->numMenuFooters);
+}
+
+/* brings a running menu up to date after its items, states or callbacks changed */
+WC_INTERNAL int WC_menu_refresh(WC_menuState *state, int *states, int numMenuItems, int numMenuStates)
+{
+    MenuItems *menuItems = state->menuItems;
+    /* with numItems given, the WC_menu_ functions (and WC_menu_invalidate) say what changed, so */
+    /* only those items are looked at again.  Without it, or if the items array was swapped, */
+    /* callbacks may have changed anything, as they always could */
+    int reported = WC_NONE != menuItems->numItems && menuItems->items == state->knownItems;
+    int first = 0, last;
+
+    /* re-check how many items in the menu as a callback can add/delete items */
+    WC_menu_recount(state);
+    last = state->numMenuItems - 1;
+    if(reported)
+    {
+        /* a callback that changed nothing the menu shows (only userData_ptr, say) costs nothing */
+        if(state->refreshed == state->generation && numMenuItems == state->numMenuItems && states == menuItems->states &&
+           numMenuStates == state->numMenuStates && (!states || WC_NONE != menuItems->numStates))
+            return 1;
+        first = state->dirtyFirst;
+        last = WC_menu_min(state->dirtyLast, last);
+    }
+    state->refreshed = state->generation;
+    state->dirtyFirst = 0;
+    state->dirtyLast = WC_NONE;
+    state->knownItems = menuItems->items;
+
+    /* with counts given, callbacks use WC_menu_set_states so only a changed array needs rebuilding */
+    if(WC_NONE == menuItems->numStates || states != menuItems->states || state->itemsMoved ||
+       numMenuItems != state->numMenuItems || numMenuStates != state->numMenuStates)
+        WC_menu_build_enabled(state);
+    WC_menu_forget_rows(state, first, last);
+    /* lengths of items given new text re-measure themselves, but without counts */
+    /* callbacks may also have rewritten text in place */
+    if(!reported)
+        WC_menu_forget_lengths(state, 0, state->numMenuItems - 1);
+    else
+        WC_menu_forget_lengths(state, state->numMenuItems, state->numMenuItems - 1);
+    if(!state->numMenuItems)
+        return 0;
+    /* without counts, the width count can't know what changed, so it starts again */
+    if(!reported && (state->autoSize & WC_AUTO_WIDTH))
+    {
+        state->numWidths = 0;
+        WC_menu_heap_free(menuItems, state->widths);
+        state->widths = 0;
+        WC_menu_track_widths(state);
+    }
+    WC_menu_fit(state);
+    /* keep the filter's index up to date, and the list if it's filtered */
+    WC_menu_sync_index(state, first, last);
+    if(!reported && state->numClassified)
+        memset(state->classified, 0, state->numClassified * sizeof(char*));
+    if(state->filterLength && WC_FILTER_FUZZY == menuItems->filterMode)
+    {
+        /* items only added on the end just join the ranking, whether or not it finished */
+        if(!reported || state->itemsMoved || first < numMenuItems || state->rankNext > numMenuItems || !state->matches)
+            WC_menu_rank_start(state);
+    }
+    else if(state->filterLength)
+    {
+        WC_menu_filter_apply(state);
+        WC_menu_select_item(state, state->selectedItem);
+    }
+    /* items came or went, so make sure the cursor's on one that's there */
+    else if(numMenuItems != state->numMenuItems || state->itemsMoved)
+    {
+        WC_menu_select_item(state, state->selectedItem);
+    }
+    state->itemsMoved = 0;
+    /* the selected item's text (or the width) may have changed, and scrolling must stay inside it */
+    if(state->itemOffset)
+    {
+        int length = WC_menu_selected_length(state);
+
+        if(length <= menuItems->width || state->itemOffset > length - menuItems->width + 1)
+        {
+            state->itemOffset = 0;
+            state->itemDirection = 1;
+        }
+    }
+
+    return 1;
+}
+
+/* FNV-1a hash of text, and its length */
+WC_INTERNAL unsigned int WC_menu_hash(const char *text, size_t *length)
+{
+    const unsigned char *c = (const unsigned char*)text;
+    unsigned int hash = 2166136261u;
+
+    while(*c)
+        hash = (hash ^ *c++) * 16777619u;
+    *length = (const char*)c - text;
+
+    return hash;
+}
+
+/* inits an empty intern pool */
+WC_GLOBAL void WC_menu_intern_init(WC_menuIntern *pool)
+{
+    memset(pool, 0, sizeof(WC_menuIntern));
+}
+
+/* malloc through the pool's mallocFunction, if it has one */
+WC_INTERNAL void *WC_menu_intern_alloc(WC_menuIntern *pool, size_t size)
+{
+    if(pool->mallocFunction)
+        return pool->mallocFunction(pool->allocContext, size);
+
+    return malloc(size);
+}
+
+/* free through the pool's freeFunction, if it has one */
+WC_INTERNAL void WC_menu_intern_release(WC_menuIntern *pool, void *ptr)
+{
+    if(!ptr)
+        return;
+
+    if(pool->freeFunction)
+        pool->freeFunction(pool->allocContext, ptr);
+    else
+        free(ptr);
+}
+
+/* 1 if ptr is text in the pool */
+WC_INTERNAL int WC_menu_intern_owns(WC_menuIntern *pool, const void *ptr)
+{
+    WC_menuArena *chunk;
+
+    for(chunk = pool->text; chunk; chunk = chunk->next)
+    {
+        const char *start = (const char*)&chunk->first;
+        if((const char*)ptr >= start && (const char*)ptr < start + chunk->used)
+            return 1;
+    }
+
+    return 0;
+}
+
+/* makes room for count more strings of bytes in all */
+WC_INTERNAL int WC_menu_intern_reserve(WC_menuIntern *pool, int count, size_t bytes)
+{
+    /* the table stays at most 3/4 full so probes stay short */
+    if((pool->count + count) * 4 >= pool->capacity * 3)
+    {
+        int i, capacity = pool->capacity ? pool->capacity : 64;
+        char **table;
+        unsigned int *hashes;
+
+        while((pool->count + count) * 4 >= capacity * 3)
+            capacity *= 2;
+        table = (char**)WC_menu_intern_alloc(pool, capacity * sizeof(char*));
+        hashes = (unsigned int*)WC_menu_intern_alloc(pool, capacity * sizeof(int));
+        if(!table || !hashes)
+        {
+            WC_menu_intern_release(pool, table);
+            WC_menu_intern_release(pool, hashes);
+            return 0;
+        }
+        memset(table, 0, capacity * sizeof(char*));
+
+        /* put what's there in the new table, by the hashes kept so the text isn't read again */
+        for(i=0; i<pool->capacity; i++)
+        {
+            if(pool->table[i])
+            {
+                int slot = pool->hashes[i] & (capacity - 1);
+                while(table[slot])
+                    slot = (slot + 1) & (capacity - 1);
+                table[slot] = pool->table[i];
+                hashes[slot] = pool->hashes[i];
+            }
+        }
+
+        WC_menu_intern_release(pool, pool->table);
+        WC_menu_intern_release(pool, pool->hashes);
+        pool->table = table;
+        pool->hashes = hashes;
+        pool->capacity = capacity;
+    }
+
+    /* the text goes in chunks like a menu's arena, each twice the last up to a limit */
+    if(!pool->text || pool->text->size - pool->text->used < bytes)
+    {
+        size_t size = pool->text ? WC_menu_min(pool->text->size * 2, (size_t)WC_MENU_ARENA_CHUNK_MAX) : WC_MENU_ARENA_CHUNK;
+        WC_menuArena *chunk;
+
+        size = WC_menu_max(size, bytes);
+        chunk = (WC_menuArena*)WC_menu_intern_alloc(pool, sizeof(WC_menuArena) + size);
+        if(!chunk)
+            return 0;
+        chunk->next = pool->text;
+        chunk->size = size;
+        chunk->used = 0;
+        pool->text = chunk;
+    }
+
+    return 1;
+}
+
+/* the pool's copy of text, adding it if it's new */
+WC_GLOBAL char *WC_menu_intern(WC_menuIntern *pool, const char *text)
+{
+    size_t length;
+    unsigned int hash = WC_menu_hash(text, &length);
+    int slot;
+    char *copy;
+
+    pool->lookups++;
+    if(pool->capacity)
+    {
+        for(slot = hash & (pool->capacity - 1); pool->table[slot]; slot = (slot + 1) & (pool->capacity - 1))
+        {
+            if(pool->hashes[slot] == hash && !strcmp(pool->table[slot], text))
+            {
+                pool->hits++;
+                pool->bytesSaved += length + 1;
+                return pool->table[slot];
+            }
+        }
+    }
+
+    if(!WC_menu_intern_reserve(pool, 1, length + 1))
+    {
+        pool->lookups--;
+        return 0;
+    }
+
+    copy = (char*)&pool->text->first + pool->text->used;
+    memcpy(copy, text, length + 1);
+    pool->text->used += length + 1;
+    pool->bytes += length + 1;
+
+    /* the table may have grown, so find the free slot again */
+    for(slot = hash & (pool->capacity - 1); pool->table[slot]; slot = (slot + 1) & (pool->capacity - 1))
+        ;
+    pool->table[slot] = copy;
+    pool->hashes[slot] = hash;
+    pool->count++;
+
+    return copy;
+}
+
+/* frees the pool and all its text */
+WC_GLOBAL void WC_menu_intern_free(WC_menuIntern *pool)
+{
+    while(pool->text)
+    {
+        WC_menuArena *next = pool->text->next;
+        WC_menu_intern_release(pool, pool->text);
+        pool->text = next;
+    }
+    WC_menu_intern_release(pool, pool->table);
+    WC_menu_intern_release(pool, pool->hashes);
+    WC_menu_intern_init(pool);
+}
+
+/* atomic load of a queue position, after which what was written before it was stored can be read */
+WC_INTERNAL unsigned long WC_menu_atomic_load(volatile unsigned long *value)
+{
+#if defined(__GNUC__)
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#elif defined(WIN32) || defined(_WIN32) || defined(__WIN32)
+    return (unsigned long)InterlockedCompareExchange((volatile LONG*)value, 0, 0);
+#else
+    /* no atomics known for this compiler, so only push from the menu's thread */
+    return *value;
+#endif
+}
+
+/* atomic store of a queue position, after everything written before it */
+WC_INTERNAL void WC_menu_atomic_store(volatile unsigned long *value, unsigned long set)
+{
+#if defined(__GNUC__)
+    __atomic_store_n(value, set, __ATOMIC_RELEASE);
+#elif defined(WIN32) || defined(_WIN32) || defined(__WIN32)
+    InterlockedExchange((volatile LONG*)value, (LONG)set);
+#else
+    *value = set;
+#endif
+}
+
+/* sets value to set if it's still expected; if not, expected gets what it is */
+WC_INTERNAL int WC_menu_atomic_cas(volatile unsigned long *value, unsigned long *expected, unsigned long set)
+{
+#if defined(__GNUC__)
+    return __atomic_compare_exchange_n(value, expected, set, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+#elif defined(WIN32) || defined(_WIN32) || defined(__WIN32)
+    unsigned long seen = (unsigned long)InterlockedCompareExchange((volatile LONG*)value, (LONG)set, (LONG)*expected);
+    if(seen == *expected)
+        return 1;
+    *expected = seen;
+    return 0;
+#else
+    if(*value != *expected)
+    {
+        *expected = *value;
+        return 0;
+    }
+    *value = set;
+    return 1;
+#endif
+}
+
+/* sets up an empty queue of at least capacity events */
+WC_GLOBAL int WC_menu_queue_init(WC_menuQueue *queue, MenuItems *menuItems, int capacity)
+{
+    WC_menuEvent *events;
+    unsigned long size = 1;
+
+    memset(queue, 0, sizeof(WC_menuQueue));
+    while(size < (unsigned long)capacity)
+        size *= 2;
+
+    events = (WC_menuEvent*)WC_menu_heap_alloc(menuItems, size * sizeof(WC_menuEvent));
+    if(!events)
+        return 0;
+    WC_menu_queue_reset(queue, events, size);
+    queue->menuItems = menuItems;
+
+    return 1;
+}
+
+/* empties a queue, using capacity (a power of 2) events */
+WC_INTERNAL void WC_menu_queue_reset(WC_menuQueue *queue, WC_menuEvent *events, unsigned long capacity)
+{
+    unsigned long i;
+
+    memset(queue, 0, sizeof(WC_menuQueue));
+    queue->events = events;
+    queue->capacity = capacity;
+    /* each slot is ready for the first position that uses it */
+    for(i=0; i<capacity; i++)
+        events[i].sequence = i;
+}
+
+/* pushes an event, from any thread */
+WC_GLOBAL int WC_menu_queue_push(WC_menuQueue *queue, int type, int index, const char *text, int state)
+{
+    unsigned long position = WC_menu_atomic_load(&queue->pushPosition);
+    WC_menuEvent *event;
+    size_t length;
+    int drained = 0;
+
+    for(;;)
+    {
+        long lap;
+
+        event = &queue->events[position & (queue->capacity - 1)];
+        lap = (long)(WC_menu_atomic_load(&event->sequence) - position);
+        /* the slot's ready for this position, so claim it unless another thread just did */
+        if(!lap)
+        {
+            if(WC_menu_atomic_cas(&queue->pushPosition, &position, position + 1))
+                break;
+        }
+        /* the menu hasn't taken the event a lap ago from the slot, so the queue's full */
+        else if(lap < 0)
+        {
+            /* unless the menu's waiting on this very callback, when it takes the lot now */
+            if(!queue->job || drained)
+                return 0;
+            WC_menu_drain(queue->job->state, queue, queue->job);
+            drained = 1;
+            position = WC_menu_atomic_load(&queue->pushPosition);
+        }
+        /* another thread claimed it, so try the next one */
+        else
+        {
+            position = WC_menu_atomic_load(&queue->pushPosition);
+        }
+    }
+
+    event->type = type;
+    event->index = index;
+    event->state = state;
+    length = text ? WC_menu_min(strlen(text), WC_MENU_EVENT_TEXT - 1) : 0;
+    if(length)
+        memcpy(event->text, text, length);
+    event->text[length] = '\0';
+    /* the menu can take it now */
+    WC_menu_atomic_store(&event->sequence, position + 1);
+
+    return 1;
+}
+
+/* frees the queue's events, with the allocator they came from */
+WC_GLOBAL void WC_menu_queue_free(WC_menuQueue *queue)
+{
+    WC_menu_heap_free(queue->menuItems, queue->events);
+    memset(queue, 0, sizeof(WC_menuQueue));
+}
+
+/* applies the events waiting in a queue, like a callback's changes; a job's own item's go where it is now */
+WC_INTERNAL void WC_menu_drain(WC_menuState *state, WC_menuQueue *queue, WC_menuJob *job)
+{
+    MenuItems *menuItems = state->menuItems;
+    unsigned long position = queue->takePosition, stop = position + queue->capacity, mask = queue->capacity - 1;
+    int *states = menuItems->states, numMenuItems = state->numMenuItems, numMenuStates = state->numMenuStates;
+    int i, count, numItems = menuItems->items ? WC_menu_num_items(menuItems) : 0;
+    char *texts[WC_QUEUE_BATCH];
+    int textStates[WC_QUEUE_BATCH];
+
+    /* most frames there's nothing */
+    if(WC_menu_atomic_load(&queue->events[position & mask].sequence) != position + 1)
+        return;
+
+    /* the menu catches up with it all at the end, as after a callback */
+    state->inCallback = 1;
+    /* a ring's worth at most, so threads pushing flat out can't keep the menu here */
+    while(position != stop)
+    {
+        WC_menuEvent *event;
+
+        /* a run of appends goes in with one insert */
+        for(count=0; count<WC_QUEUE_BATCH && position + count != stop; count++)
+        {
+            event = &queue->events[(position + count) & mask];
+            if(WC_menu_atomic_load(&event->sequence) != position + count + 1 || WC_EVENT_APPEND != event->type)
+                break;
+            texts[count] = event->text;
+            textStates[count] = event->state;
+        }
+        if(count)
+        {
+            if(WC_menu_insert_items(menuItems, numItems, texts, textStates, 0, count))
+                numItems += count;
+        }
+        else
+        {
+            int index;
+
+            event = &queue->events[position & mask];
+            if(WC_menu_atomic_load(&event->sequence) != position + 1)
+                break;
+            /* a job's callback only knows its item by where it was when the job started */
+            index = job && event->index == job->item ? job->index : event->index;
+            /* events for items that aren't there (any more) are dropped */
+            if(index >= 0 && index < numItems)
+            {
+                if(WC_EVENT_UPDATE == event->type)
+                    WC_menu_set_item(menuItems, index, event->text);
+                else if(WC_EVENT_STATE == event->type)
+                    WC_menu_set_state(menuItems, index, event->state);
+            }
+            count = 1;
+        }
+
+        /* the slots are ready for the pushers' next lap */
+        for(i=0; i<count; i++, position++)
+            WC_menu_atomic_store(&queue->events[position & mask].sequence, position + queue->capacity);
+        queue->taken += count;
+    }
+    queue->takePosition = position;
+    state->inCallback = 0;
+
+    if(!WC_menu_refresh(state, states, numMenuItems, numMenuStates))
+        WC_menu_finish(state, WC_ERROR_NONE_ENABLED);
+}
+
+/* 1 if callback is in menuItems->asyncCallbacks */
+WC_INTERNAL int WC_menu_is_async(MenuItems *menuItems, cbf_ptr callback)
+{
+    int i;
+
+    for(i=0; i<menuItems->numAsyncCallbacks; i++)
+    {
+        if(menuItems->asyncCallbacks[i] == callback)
+            return 1;
+    }
+
+    return 0;
+}
+
+/* the job running item index's callback, 0 if there isn't one */
+WC_INTERNAL WC_menuJob *WC_menu_item_job(WC_menuState *state, int index)
+{
+    int i;
+
+    if(!state->jobs || !state->jobs->numBusy || WC_NONE == index)
+        return 0;
+
+    /* only this thread frees jobs, so one that isn't free stays put */
+    for(i=0; i<WC_MENU_JOBS; i++)
+    {
+        WC_menuJob *job = &state->jobs->jobs[i];
+
+        if(WC_JOB_FREE != WC_menu_atomic_load(&job->status) && job->index == index)
+            return job;
+    }
+
+    return 0;
+}
+
+/* starts callback for item in a job, on a thread if there are any; 0 if it can't */
+WC_INTERNAL int WC_menu_job_start(WC_menuState *state, cbf_ptr callback, int item)
+{
+    WC_menuJobs *jobs = state->jobs;
+    WC_menuJob *job = 0;
+    int i;
+
+    if(!jobs)
+    {
+        jobs = state->jobs = (WC_menuJobs*)WC_menu_heap_alloc(state->menuItems, sizeof(WC_menuJobs));
+        if(!jobs)
+            return 0;
+        memset(jobs, 0, sizeof(WC_menuJobs));
+#ifdef WC_MENU_THREADS
+        pthread_mutex_init(&jobs->lock, NULL);
+        pthread_cond_init(&jobs->start, NULL);
+        for(i=0; i<WC_MENU_JOB_THREADS; i++)
+        {
+            if(pthread_create(&jobs->threads[i], NULL, WC_menu_job_thread, jobs))
+                break;
+        }
+        jobs->numThreads = i;
+#endif
+    }
+
+    for(i=0; i<WC_MENU_JOBS && !job; i++)
+    {
+        if(WC_JOB_FREE == WC_menu_atomic_load(&jobs->jobs[i].status))
+            job = &jobs->jobs[i];
+    }
+    if(!job)
+        return 0;
+    /* the changes queue is made the 1st time the job's used, and emptied each time after */
+    if(!job->changes.events)
+    {
+        WC_menuEvent *events = (WC_menuEvent*)WC_menu_heap_alloc(state->menuItems, WC_MENU_JOB_EVENTS * sizeof(WC_menuEvent));
+
+        if(!events)
+            return 0;
+        job->changes.events = events;
+    }
+    WC_menu_queue_reset(&job->changes, job->changes.events, WC_MENU_JOB_EVENTS);
+
+    WC_menuInit(&job->menuItems);
+    job->menuItems.userData_ptr = state->menuItems->userData_ptr;
+    job->menuItems.queue = &job->changes;
+    job->menuItems.job = job;
+    job->callback = callback;
+    job->state = state;
+    job->item = job->index = item;
+    job->key = 0;
+    job->cancelled = 0;
+    jobs->numBusy++;
+
+#ifdef WC_MENU_THREADS
+    if(jobs->numThreads)
+    {
+        pthread_mutex_lock(&jobs->lock);
+        WC_menu_atomic_store(&job->status, WC_JOB_QUEUED);
+        pthread_cond_signal(&jobs->start);
+        pthread_mutex_unlock(&jobs->lock);
+        return 1;
+    }
+#endif
+    /* no threads, so it runs now, and its changes are taken in whenever its queue fills */
+    WC_menu_atomic_store(&job->status, WC_JOB_RUNNING);
+    job->changes.job = job;
+    WC_menu_job_run(job);
+    job->changes.job = 0;
+
+    return 1;
+}
+
+/* runs a job's callback, on whichever thread it's on */
+WC_INTERNAL void WC_menu_job_run(WC_menuJob *job)
+{
+    if(!WC_menu_atomic_load(&job->cancelled))
+        job->key = job->callback(&job->menuItems, job->item);
+    /* the menu sees the key, and every change pushed, once it sees this */
+    WC_menu_atomic_store(&job->status, WC_JOB_DONE);
+}
+
+/* takes in what jobs' callbacks changed and frees those that finished; returns the keys they pressed */
+WC_INTERNAL int WC_menu_jobs_collect(WC_menuState *state)
+{
+    WC_menuJobs *jobs = state->jobs;
+    int i, key = 0;
+
+    if(!jobs)
+        return 0;
+
+    for(i=0; i<WC_MENU_JOBS && jobs->numBusy && WC_MENU_PENDING == state->result; i++)
+    {
+        WC_menuJob *job = &jobs->jobs[i];
+        unsigned long status = WC_menu_atomic_load(&job->status);
+
+        if(WC_JOB_FREE == status)
+            continue;
+        /* after ESC, whatever the callback does is ignored */
+        if(WC_menu_atomic_load(&job->cancelled))
+        {
+            if(WC_JOB_DONE != status)
+                continue;
+        }
+        else
+        {
+            WC_menu_drain(state, &job->changes, job);
+            if(WC_JOB_DONE != status)
+                continue;
+            /* ENTER chooses the job's item, if it's still there, and ends the menu */
+            if((job->key & WC_INPUT_SELECT) && WC_NONE != job->index && WC_MENU_PENDING == state->result)
+                WC_menu_finish(state, job->index);
+            key |= job->key & ~WC_INPUT_SELECT;
+        }
+        WC_menu_atomic_store(&job->status, WC_JOB_FREE);
+        jobs->numBusy--;
+    }
+
+    return key;
+}
+
+/* tells every job still going to stop; how many were */
+WC_INTERNAL int WC_menu_jobs_cancel(WC_menuState *state)
+{
+    int i, count = 0;
+
+    if(!state->jobs || !state->jobs->numBusy)
+        return 0;
+
+    for(i=0; i<WC_MENU_JOBS; i++)
+    {
+        WC_menuJob *job = &state->jobs->jobs[i];
+        unsigned long status = WC_menu_atomic_load(&job->status);
+
+        if(WC_JOB_FREE != status && WC_JOB_DONE != status && !WC_menu_atomic_load(&job->cancelled))
+        {
+            WC_menu_atomic_store(&job->cancelled, 1);
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/* keeps jobs on their items after count items were inserted at first (or -count removed) */
+WC_INTERNAL void WC_menu_jobs_move(WC_menuState *state, int first, int count)
+{
+    int i;
+
+    if(!state->jobs || !state->jobs->numBusy)
+        return;
+
+    for(i=0; i<WC_MENU_JOBS; i++)
+    {
+        WC_menuJob *job = &state->jobs->jobs[i];
+
+        if(WC_JOB_FREE == WC_menu_atomic_load(&job->status) || WC_NONE == job->index || job->index < first)
+            continue;
+        if(count < 0 && job->index < first - count)
+            job->index = WC_NONE;
+        else
+            job->index += count;
+    }
+}
+
+/* cancels the jobs, waits for their callbacks to return and frees them */
+WC_INTERNAL void WC_menu_jobs_end(WC_menuState *state)
+{
+    WC_menuJobs *jobs = state->jobs;
+    int i;
+
+    if(!jobs)
+        return;
+
+    for(i=0; i<WC_MENU_JOBS; i++)
+        WC_menu_atomic_store(&jobs->jobs[i].cancelled, 1);
+#ifdef WC_MENU_THREADS
+    pthread_mutex_lock(&jobs->lock);
+    jobs->quit = 1;
+    pthread_cond_broadcast(&jobs->start);
+    pthread_mutex_unlock(&jobs->lock);
+    for(i=0; i<jobs->numThreads; i++)
+        pthread_join(jobs->threads[i], NULL);
+    pthread_mutex_destroy(&jobs->lock);
+    pthread_cond_destroy(&jobs->start);
+#endif
+
+    for(i=0; i<WC_MENU_JOBS; i++)
+        WC_menu_heap_free(state->menuItems, jobs->jobs[i].changes.events);
+    WC_menu_heap_free(state->menuItems, jobs);
+    state->jobs = 0;
+}
+
+#ifdef WC_MENU_THREADS
+/* a job thread, running queued jobs until the menu ends */
+WC_INTERNAL void *WC_menu_job_thread(void *arg)
+{
+    WC_menuJobs *jobs = (WC_menuJobs*)arg;
+
+    pthread_mutex_lock(&jobs->lock);
+    while(!jobs->quit)
+    {
+        WC_menuJob *job = 0;
+        int i;
+
+        for(i=0; i<WC_MENU_JOBS && !job; i++)
+        {
+            if(WC_JOB_QUEUED == WC_menu_atomic_load(&jobs->jobs[i].status))
+                job = &jobs->jobs[i];
+        }
+        if(!job)
+        {
+            pthread_cond_wait(&jobs->start, &jobs->lock);
+            continue;
+        }
+        WC_menu_atomic_store(&job->status, WC_JOB_RUNNING);
+        pthread_mutex_unlock(&jobs->lock);
+
+        WC_menu_job_run(job);
+
+        pthread_mutex_lock(&jobs->lock);
+    }
+    pthread_mutex_unlock(&jobs->lock);
+
+    return 0;
+}
+#endif
+
+/* 1 once ESC has cancelled the async callback given menuItems (a stand-in), so it should stop */
+WC_GLOBAL int WC_menu_cancelled(MenuItems *menuItems)
+{
+    return menuItems->job && WC_menu_atomic_load(&menuItems->job->cancelled);
+}
+
+/* 1 if item index's async callback is still running */
+WC_GLOBAL int WC_menu_item_busy(WC_menuState *state, int index)
+{
+    return 0 != WC_menu_item_job(state, index);
+}
+
+/* sets up a menu to be run by WC_menu_step and WC_menu_render */
+WC_GLOBAL int WC_menu_begin(MenuItems *menuItems, WC_menuState *state)
+{
+    int _x, _y;
+
+    memset(state, 0, sizeof(WC_menuState));
+    state->menuItems = menuItems;
+    state->frame.menuItems = menuItems;
+    state->result = WC_ERROR_NONE_ENABLED;
+    /* up to date with the items as they are */
+    state->dirtyLast = WC_NONE;
+    state->knownItems = menuItems->items;
+
+    /* get sizes of menu elements */
+    WC_menu_recount(state);
+    WC_menu_build_enabled(state);
+
+    /* make sure there are items provided */
+    if(!state->numMenuItems)
+        return state->result = WC_ERROR_NONE_ENABLED;
+
+    /* nothing measured yet */
+    WC_menu_forget_lengths(state, 0, state->numMenuItems - 1);
+
+    /* rows for getItem text; more than fit on screen so drawing a frame never reuses a row it drew */
+    if(menuItems->getItem)
+    {
+        int r;
+
+        state->numRows = menuItems->sy * 2 + 1;
+        state->rows = (WC_menuRow*)WC_menu_heap_alloc(menuItems, state->numRows * sizeof(WC_menuRow));
+        if(state->rows)
+            state->rows[0].text = (char*)WC_menu_heap_alloc(menuItems, state->numRows * WC_MENU_ROW_CAPACITY);
+        if(!state->rows || !state->rows[0].text)
+        {
+            state->numRows = 0;
+            return state->result = WC_ERROR_TOO_SMALL;
+        }
+        for(r=0; r<state->numRows; r++)
+        {
+            state->rows[r].index = WC_NONE;
+            state->rows[r].used = 0;
+            state->rows[r].text = state->rows[0].text + r * WC_MENU_ROW_CAPACITY;
+        }
+    }
+
+    /* make sure there's enough screen to display at least line with the selectors (><) and 1 char */
+    if(menuItems->sy < 1 || menuItems->sx < 3)
+        return state->result = WC_ERROR_WINDOW_SMALL;
+
+    /* create placeholder y/x locations */
+    _y = WC_NONE == menuItems->y ? 0 : menuItems->y;
+    _x = WC_NONE == menuItems->x ? 0 : menuItems->x;
+
+    /* make sure the top left edge of the menu is on-screen */
+    if(_y < 0 || _y >= menuItems->sy || _x < 0 || _x > menuItems->sx-3)
+        return state->result = WC_ERROR_NOT_ONSCREEN;
+
+    /* the title row shows what's been typed when filtering, so filter menus have one */
+    state->numMenuHeaders = menuItems->title || menuItems->filterMode ? menuItems->title_height : 0;
+    state->numMenuFooters = menuItems->footer ? menuItems->footer_height : 0;
+
+    /* get length of the title & footer */
+    state->titleLength = menuItems->title ? strlen(menuItems->title) : 0;
+    state->footerLength = menuItems->footer ? strlen(menuItems->footer) : 0;
+
+    /* what gets worked out here is worked out again as items come and go */
+    state->autoSize = (WC_NONE == menuItems->y ? WC_AUTO_Y : 0) | (WC_NONE == menuItems->x ? WC_AUTO_X : 0) |
+                      (WC_NONE == menuItems->height ? WC_AUTO_HEIGHT : 0) | (WC_NONE == menuItems->width ? WC_AUTO_WIDTH : 0);
+
+    /* now calc height if not provided */
+    if(WC_NONE == menuItems->height)
+        menuItems->height = state->numMenuItems + state->numMenuHeaders + state->numMenuFooters;
+    /* make sure height fits on screen */
+    if(_y + menuItems->height > menuItems->sy - 1)
+        menuItems->height = menuItems->sy - _y - 1;
+
+    /* calc width if not provided */
+    if(WC_NONE == menuItems->width)
+    {
+        /* asking a getItem provider for everything would defeat it, so size it to the 1st screen's worth */
+        int numItems = menuItems->getItem ? WC_menu_min(state->numMenuItems, menuItems->sy) : state->numMenuItems;
+        menuItems->width = WC_menu_max(WC_menu_maxItemLength(state, numItems), state->titleLength);
+    }
+    /* make sure it fits on the screen */
+    if(_x + menuItems->width > menuItems->sx - 2)
+        menuItems->width = menuItems->sx - _x - 2;
+
+    /* centre the menu if y or x was not provided */
+    if(WC_NONE == menuItems->y)
+        menuItems->y = WC_menu_max(0,(int)((menuItems->sy-menuItems->height)/2));
+    if(WC_NONE == menuItems->x)
+        menuItems->x = WC_menu_max(0,(int)((menuItems->sx-(menuItems->width+2))/2));
+
+    /* calculate how many items can be shown */
+    state->numVisibleItems = menuItems->height - (state->numMenuHeaders + state->numMenuFooters);
+
+    /* show 1st enabled item as selected */
+    state->selectedItem = WC_menu_next_item(state, -1, 1);
+    if(state->selectedItem >= state->numMenuItems)
+        return state->result = WC_ERROR_NONE_ENABLED;
+    /* not filtering so the list is all the items */
+    state->selectedRow = state->selectedItem;
+    /* handle 1st selectable item not being on-screen */
+    state->topItem = 0;
+    if(state->selectedItem - state->topItem >= state->numVisibleItems)
+        state->topItem = state->selectedItem - state->numVisibleItems + 1;
+    /* start selected item from 1st character */
+    state->itemOffset = 0;
+    /* if selected item has to scroll, scroll it to the left */
+    state->itemDirection = 1;
+    /* start footer from 1st character */
+    state->footerOffset = 0;
+
+    /* if no items can be shown then throw exception */
+    if(state->numVisibleItems < 1)
+        return state->result = WC_ERROR_TOO_SMALL;
+
+    /* get time for scrolling purposes */
+    state->startTime = WC_menu_now();
+
+    menuItems->runningState = state;
+    state->result = WC_MENU_PENDING;
+    return 0;
+}
+
+/* advances scrolling to now, then acts on key */
+WC_GLOBAL int WC_menu_step(WC_menuState *state, int key, WC_time now)
+{
+    MenuItems *menuItems = state->menuItems;
+    WC_time ticks;
+    int i;
+
+    if(WC_MENU_PENDING != state->result)
+        return WC_menu_status(state);
+#ifdef WC_MENU_STATS
+    WC_menu_stats_key(&menuItems->stats, key);
+#endif
+
+    /* what other threads pushed goes in before any key acts on the list */
+    if(menuItems->queue)
+    {
+        WC_menu_drain(state, menuItems->queue, 0);
+        if(WC_MENU_PENDING != state->result)
+            return WC_menu_status(state);
+    }
+    /* and so do async callbacks' changes, and the keys of those that finished */
+    if(state->jobs && state->jobs->numBusy)
+    {
+        key |= WC_menu_jobs_collect(state);
+        if(WC_MENU_PENDING != state->result)
+            return WC_menu_status(state);
+    }
+
+    /* advance the footer and selected item by however many scroll steps have really passed */
+    ticks = (now - state->startTime) / (WC_time)WC_SCROLL_SPEED;
+    if(ticks > 0)
+    {
+        int selectedLength = WC_menu_selected_length(state);
+
+        state->startTime += ticks * (WC_time)WC_SCROLL_SPEED;
+        /* if the item is longer than the menu width, bounce the item back and forth in the menu display */
+        if(selectedLength > menuItems->width)
+            WC_menu_scroll_item(&state->itemOffset, &state->itemDirection, selectedLength, menuItems->width, ticks);
+        if(state->footerLength)
+            state->footerOffset = (int)((state->footerOffset + ticks) % state->footerLength);
+    }
+
+    /* this allows callbaks to "press keys" */
+    while(key)
+    {
+        int numRows = WC_menu_num_rows(state);
+
+        /* cursor key up/down */
+        if(key & WC_INPUT_MOTION)
+        {
+            state->itemOffset = 0;
+            state->itemDirection = 1;
+            /* the cursor is the user's now, not the best match's */
+            state->rankFollow = 0;
+            /* cursor down */
+            if(key & WC_INPUT_KEY_DOWN)
+            {
+                i = WC_menu_next_row(state, state->selectedRow, 1);
+                if(i >= numRows)
+                {
+                    i = WC_menu_next_row(state, -1, 1);
+                    /* a filter can leave nothing to select, but typing more or less may change that */
+                    if(i >= numRows && state->filterLength)
+                        break;
+                    if(i >= numRows)
+                        return WC_menu_finish(state, WC_ERROR_NONE_ENABLED);
+                    state->topItem = 0;
+                }
+                /* make sure newly selected item is visible */
+                if(i - state->topItem >= state->numVisibleItems)
+                    state->topItem = i - state->numVisibleItems + 1;
+                state->selectedRow = i;
+                state->selectedItem = WC_menu_row_item(state, i);
+            }
+            /* cursor up */
+            if(key & WC_INPUT_KEY_UP)
+            {
+                i = WC_menu_next_row(state, state->selectedRow, -1);
+                if(i < 0)
+                {
+                    i = WC_menu_next_row(state, numRows, -1);
+                    if(i < 0 && state->filterLength)
+                        break;
+                    if(i < 0)
+                        return WC_menu_finish(state, WC_ERROR_NONE_ENABLED);
+                    state->topItem = WC_menu_max(0,numRows - state->numVisibleItems);
+                }
+                if(state->topItem > i)
+                    state->topItem = i;
+                state->selectedRow = i;
+                state->selectedItem = WC_menu_row_item(state, i);
+            }
+            key = 0;
+        }
+        /* page up/down, home/end and jumps go straight to the row, skipping disabled runs through the bitset */
+        else if(key & WC_INPUT_PAGING)
+        {
+            int found;
+
+            state->rankFollow = 0;
+            if(key & WC_INPUT_KEY_JUMP)
+            {
+                WC_menu_select_item(state, menuItems->jumpItem);
+                found = WC_NONE != state->selectedItem;
+            }
+            else if(key & WC_INPUT_KEY_HOME)
+            {
+                state->topItem = 0;
+                found = WC_menu_select_near(state, 0, 1);
+            }
+            else if(key & WC_INPUT_KEY_END)
+            {
+                state->topItem = WC_menu_max(0, numRows - state->numVisibleItems);
+                found = WC_menu_select_near(state, numRows - 1, -1);
+            }
+            else if(key & WC_INPUT_KEY_PAGE_DOWN)
+            {
+                /* scroll the list a page along with the cursor */
+                state->topItem = WC_menu_max(0, WC_menu_min(state->topItem + state->numVisibleItems, numRows - state->numVisibleItems));
+                found = WC_menu_select_near(state, WC_menu_min(state->selectedRow + state->numVisibleItems, numRows - 1), 1);
+            }
+            else
+            {
+                state->topItem = WC_menu_max(0, state->topItem - state->numVisibleItems);
+                found = WC_menu_select_near(state, WC_menu_max(state->selectedRow - state->numVisibleItems, 0), -1);
+            }
+            /* like up/down, it's only an error if the menu (not a filter) has nothing enabled */
+            if(!found && !state->filterLength)
+                return WC_menu_finish(state, WC_ERROR_NONE_ENABLED);
+            key = 0;
+        }
+        /* ENTER key */
+        else if(key & WC_INPUT_SELECT)
+        {
+            /* nothing to choose while the filter hides every enabled item */
+            if(WC_NONE == state->selectedItem)
+                break;
+            if(menuItems->callbacks)
+            {
+                /* see if there's a callback and that it's a function */
+                if(state->selectedItem < state->numMenuCallbacks && WC_NO_CALLBACK != menuItems->callbacks[state->selectedItem] &&
+                   WC_menu_is_async(menuItems, menuItems->callbacks[state->selectedItem]))
+                {
+                    /* an item that's busy already stays that way */
+                    if(!WC_menu_item_job(state, state->selectedItem))
+                        WC_menu_job_start(state, menuItems->callbacks[state->selectedItem], state->selectedItem);
+                    /* without threads it's done already, so take it in now */
+                    key = WC_menu_jobs_collect(state);
+                    if(WC_MENU_PENDING != state->result)
+                        return WC_menu_status(state);
+                }
+                else if(state->selectedItem < state->numMenuCallbacks && WC_NO_CALLBACK != menuItems->callbacks[state->selectedItem])
+                {
+                    /* what the callback may change */
+                    int *states = menuItems->states, numMenuItems = state->numMenuItems, numMenuStates = state->numMenuStates;
+#ifdef WC_MENU_STATS
+                    WC_time called = WC_menu_now();
+#endif
+
+                    /* the callbak return value should be 0 or a key-define */
+                    state->inCallback = 1;
+                    key = menuItems->callbacks[state->selectedItem](menuItems, state->selectedItem);
+                    state->inCallback = 0;
+#ifdef WC_MENU_STATS
+                    menuItems->stats.callbacks++;
+                    menuItems->stats.callbackTime += WC_menu_now() - called;
+#endif
+                    if(!WC_menu_refresh(state, states, numMenuItems, numMenuStates))
+                        return WC_menu_finish(state, WC_ERROR_NONE_ENABLED);
+                }
+            }
+            /* test again - The callback may have altered the key, but if not then done */
+            if(key & WC_INPUT_SELECT)
+                return WC_menu_finish(state, state->selectedItem);
+        }
+        /* ESC key cancels async callbacks, or clears the filter, or else exits with -1 */
+        else if(key & WC_INPUT_BACKUP)
+        {
+            if(!WC_menu_jobs_cancel(state))
+            {
+                if(!state->filterLength)
+                    return WC_menu_finish(state, WC_ERROR_CANCEL);
+                state->filterLength = 0;
+                WC_menu_select_item(state, state->selectedItem);
+            }
+            key = 0;
+        }
+        /* typing narrows the list to items starting with what's typed, backspace widens it again */
+        else if(key & WC_INPUT_FILTER)
+        {
+            int c = WC_INPUT_CHAR_OF(key);
+
+            /* a getItem provider's items can't be indexed without asking for every one */
+            if(menuItems->filterMode && menuItems->items && !menuItems->getItem)
+            {
+                if(key & WC_INPUT_KEY_BACKSPACE)
+                {
+                    if(state->filterLength)
+                    {
+                        state->filterText[--state->filterLength] = '\0';
+                        if(WC_FILTER_FUZZY == menuItems->filterMode)
+                            WC_menu_rank_start(state);
+                        else if(state->filterLength)
+                            WC_menu_view_range(state, state->filterFirst[state->filterLength], state->filterLast[state->filterLength]);
+                        WC_menu_select_item(state, state->selectedItem);
+                    }
+                }
+                else if(c < ' ' || c == 127)
+                {
+                    /* not a printable character */
+                }
+                else if(WC_FILTER_FUZZY == menuItems->filterMode)
+                {
+                    /* the ranking starts over, below */
+                    if(state->filterLength < WC_MENU_FILTER_CAPACITY - 1)
+                    {
+                        state->filterText[state->filterLength++] = (char)c;
+                        state->filterText[state->filterLength] = '\0';
+                        WC_menu_rank_start(state);
+                        WC_menu_select_item(state, WC_NONE);
+                    }
+                }
+                else if(WC_menu_filter_add(state, c))
+                {
+                    WC_menu_select_item(state, state->selectedItem);
+                }
+                /* while the typing changes the best match, the cursor stays on it */
+                state->rankFollow = state->filterLength > 0;
+            }
+            key = 0;
+        }
+        else
+            break; /* ignore other key-values */
+    }
+
+    /* fuzzy ranking goes on a chunk at a time, so the list fills in while the menu keeps running */
+    if(state->filterLength && WC_FILTER_FUZZY == menuItems->filterMode && state->rankNext < state->numMenuItems)
+    {
+        WC_menu_rank(state, WC_menu_now() + WC_MENU_RANK_TIME);
+        if(state->rankFollow)
+            state->topItem = 0;
+        WC_menu_select_item(state, state->rankFollow ? WC_NONE : state->selectedItem);
+    }
+
+    return WC_MENU_RUNNING;
+}
+
+/* steps with each key in turn, stopping if the menu finishes */
+WC_GLOBAL int WC_menu_step_keys(WC_menuState *state, const int *keys, int numKeys, WC_time now)
+{
+    int i, status = WC_menu_step(state, numKeys > 0 ? keys[0] : 0, now);
+
+    for(i=1; i<numKeys && WC_MENU_RUNNING == status; i++)
+        status = WC_menu_step(state, keys[i], now);
+
+    return status;
+}
+
+/* draws the menu as it is now and calls the showFunction */
+WC_GLOBAL void WC_menu_render(WC_menuState *state)
+{
+    MenuItems *menuItems = state->menuItems;
+    WC_menuFrame *frame = &state->frame;
+    /* how many rows of the list to draw */
+    int numRows = WC_menu_num_rows(state);
+    int numItemsToDraw = WC_menu_min(numRows,state->topItem+state->numVisibleItems);
+    /* while filtering, what's been typed goes where the title was */
+    char *title = state->filterLength ? state->filterText : menuItems->title;
+    int titleLength = state->filterLength ? state->filterLength : state->titleLength;
+    int i, line, color;
+    char *displayOpen;
+#ifdef WC_MENU_STATS
+    WC_time started, shown;
+#endif
+
+    if(WC_MENU_PENDING != state->result)
+        return;
+
+#ifdef WC_MENU_STATS
+    started = WC_menu_now();
+#endif
+    state->frameNumber++;
+
+    /* start at the top to draw */
+    line = menuItems->y;
+
+	/* show the title if there is one to be shown */
+	if(menuItems->title || menuItems->filterMode)
+	{
+		int titleLengthClamped = WC_menu_min(titleLength, menuItems->width);
+		int length = ((menuItems->width + (titleLengthClamped % 2 ? 0 : 1)) / 2) - (titleLengthClamped / 2) + 1;
+		WC_menu_emit(frame, line, menuItems->x, WC_MARK_BLANK, length, WC_CLR_TITLE);
+		WC_menu_emit(frame, line, menuItems->x + length, title, titleLengthClamped, WC_CLR_TITLE);
+		WC_menu_emit(frame, line, menuItems->x + length + titleLengthClamped, WC_MARK_BLANK, 1 + WC_menu_max(0, (menuItems->width / 2) - (titleLengthClamped / 2)), WC_CLR_TITLE);
+		line += 1;
+		/* pad out the title area */
+		while(line - menuItems->y < state->numMenuHeaders)
+		{
+			WC_menu_emit(frame, line, menuItems->x, WC_MARK_BLANK, menuItems->width + 2, WC_CLR_TITLE);
+			line += 1;
+		}
+	}
+	
+	/* show the visible menu items, highlighting the selected item */
+    for(i=state->topItem; i<numItemsToDraw; i++)
+    {
+        /* the item's text, fetched once for the frame */
+        int item = WC_menu_row_item(state, i);
+        char *text = WC_menu_item_text(state, item);
+
+        /* pick the enabled/disabled/busy colour */
+        if(!WC_menu_item_enabled(state, item))
+            color = WC_CLR_DISABLED;
+        else if(WC_menu_item_busy(state, item))
+            color = menuItems->busyColor;
+        else
+            color = WC_CLR_ITEMS;
+
+        /* handle the item that's selected */
+        if(i == state->selectedRow)
+        {
+            displayOpen = WC_MARK_OPEN;
+            color = WC_CLR_SELECT;
+        }
+        else
+        {
+            displayOpen = WC_MARK_BLANK;
+        }
+
+        /* show 1st character of string */
+        WC_menu_emit(frame, line, menuItems->x, displayOpen, 1, color);
+
+        if(i == state->selectedRow)
+            WC_menu_emit(frame, line, menuItems->x+1, &text[state->itemOffset], menuItems->width, color);
+        else
+            WC_menu_emit(frame, line, menuItems->x+1, text, menuItems->width, color);
+
+        /* put < on selected except the top/bottom when there are more options off-screen which then get ^ or V */
+        if(i == state->topItem && state->topItem != 0)
+            displayOpen = WC_MARK_MORE_UP;
+        else if(i == state->topItem+state->numVisibleItems-1 && i != numRows-1)
+            displayOpen = WC_MARK_MORE_DOWN;
+        else if(i == state->selectedRow)
+            displayOpen = WC_MARK_CLOSE;
+        else
+            displayOpen = WC_MARK_BLANK;
+        WC_menu_emit(frame, line, menuItems->x+1+menuItems->width, displayOpen, 1, color);
+        
+        line += 1;
+    }
+
+    /* a filtered list may not fill the item rows */
+    while(state->filterLength && line < menuItems->y + state->numMenuHeaders + state->numVisibleItems)
+    {
+        WC_menu_emit(frame, line, menuItems->x, WC_MARK_BLANK, menuItems->width+2, WC_CLR_ITEMS);
+        line += 1;
+    }
+
+    /* pad out the footer area, if there is one */
+    while(line < menuItems->y + state->numVisibleItems + state->numMenuFooters + state->numMenuHeaders)
+    {
+        WC_menu_emit(frame, line, menuItems->x, WC_MARK_BLANK, menuItems->width+2, WC_CLR_FOOTER);
+        line += 1;
+    }
+
+    /* display the footer if there is one */
+    if(menuItems->footer)
+    {
+        int remain = state->footerLength - state->footerOffset;
+        int column = menuItems->x;
+        int length = WC_menu_min(remain, menuItems->width);
+
+        /* open the line and print as much of the footer as is visible */
+        WC_menu_emit(frame, line, column++, WC_MARK_BLANK, 1, WC_CLR_FOOTER);
+        WC_menu_emit(frame, line, column, &menuItems->footer[state->footerOffset], length, WC_CLR_FOOTER);
+
+        /* fill the footer ine with the footer text by wrapping */
+        while(remain < menuItems->width)
+        {
+            column += length;
+            length = WC_menu_min(state->footerLength, menuItems->width-remain);
+            WC_menu_emit(frame, line, column, menuItems->footer, length, WC_CLR_FOOTER);
+            remain += state->footerLength;
+        }
+        column += length;
+        WC_menu_emit(frame, line, column, WC_MARK_BLANK, 1, WC_CLR_FOOTER);
+    }
+
+    /* hand the whole frame to the program in one go */
+    WC_menu_flush(menuItems, frame);
+
+#ifdef WC_MENU_STATS
+    shown = WC_menu_now();
+#endif
+    if(menuItems->showMenuFunction)
+        menuItems->showMenuFunction(menuItems);
+    else if(menuItems->showFunction)
+        menuItems->showFunction();
+#ifdef WC_MENU_STATS
+    menuItems->stats.drawTime += WC_menu_now() - shown;
+    WC_menu_stats_frame(&menuItems->stats, started);
+#endif
+}
+
+/* when the footer or selected item next scrolls */
+WC_GLOBAL WC_time WC_menu_next_deadline(WC_menuState *state)
+{
+    WC_time deadline = WC_WAIT_FOREVER;
+
+    if(WC_MENU_PENDING != state->result)
+        return WC_WAIT_FOREVER;
+
+    /* still ranking, so due already */
+    if(state->filterLength && WC_FILTER_FUZZY == state->menuItems->filterMode && state->rankNext < state->numMenuItems)
+        return state->startTime;
+
+    if(state->footerLength || WC_menu_selected_length(state) > state->menuItems->width)
+        deadline = state->startTime + (WC_time)WC_SCROLL_SPEED;
+
+    /* events can be pushed, and callbacks finish, at any time, so look every so often */
+    if(state->menuItems->queue || (state->jobs && state->jobs->numBusy))
+    {
+        WC_time poll = WC_menu_now() + (WC_time)WC_MENU_QUEUE_POLL;
+
+        if(WC_WAIT_FOREVER == deadline || poll < deadline)
+            deadline = poll;
+    }
+
+    return deadline;
+}
+
+/* frees what the menu allocated while running */
+WC_GLOBAL void WC_menu_end(WC_menuState *state)
+{
+    if(state->menuItems && state->menuItems->runningState == state)
+        state->menuItems->runningState = 0;
+    if(state->rows)
+        WC_menu_heap_free(state->menuItems, state->rows[0].text);
+    WC_menu_heap_free(state->menuItems, state->rows);
+    state->rows = 0;
+    state->numRows = 0;
+    WC_menu_heap_free(state->menuItems, state->lengths);
+    WC_menu_heap_free(state->menuItems, state->measured);
+    state->lengths = 0;
+    state->measured = 0;
+    state->numLengths = 0;
+    WC_menu_forget_index(state);
+    state->filterLength = 0;
+    WC_menu_heap_free(state->menuItems, state->view);
+    state->view = 0;
+    state->numView = state->maxView = 0;
+    WC_menu_heap_free(state->menuItems, state->classes);
+    WC_menu_heap_free(state->menuItems, state->classified);
+    WC_menu_heap_free(state->menuItems, state->matches);
+    state->classes = 0;
+    state->classified = 0;
+    state->matches = 0;
+    state->numClassified = 0;
+    WC_menu_heap_free(state->menuItems, state->widths);
+    state->widths = 0;
+    state->numWidths = 0;
+#ifdef WC_MENU_THREADS
+    WC_menu_pool_end(state);
+#endif
+    WC_menu_jobs_end(state);
+    WC_menu_heap_free(state->menuItems, state->enabled);
+    WC_menu_heap_free(state->menuItems, state->enabledSummary);
+    state->enabled = state->enabledSummary = 0;
+    state->numEnabledWords = 0;
+    WC_menu_heap_free(state->menuItems, state->frame.spans);
+    WC_menu_heap_free(state->menuItems, state->frame.cells);
+    WC_menu_heap_free(state->menuItems, state->frame.colors);
+    WC_menu_heap_free(state->menuItems, state->frame.screenCells);
+    WC_menu_heap_free(state->menuItems, state->frame.screenColors);
+    memset(&state->frame, 0, sizeof(WC_menuFrame));
+    state->frame.menuItems = state->menuItems;
+}
+
+/* length of the selected item's text, 0 if it's gone */
+WC_INTERNAL int WC_menu_selected_length(WC_menuState *state)
+{
+    if(state->selectedItem < 0 || state->selectedItem >= state->numMenuItems)
+        return 0;
+
+    return WC_menu_item_length(state, state->selectedItem);
+}
+
+/* stops the menu with result (an item or WC_ERROR_*) and returns what WC_menu_step should */
+WC_INTERNAL int WC_menu_finish(WC_menuState *state, int result)
+{
+    state->result = result;
+    return WC_menu_status(state);
+}
+
+/* turns state->result into a WC_menu_step return value */
+WC_INTERNAL int WC_menu_status(WC_menuState *state)
+{
+    if(state->result >= 0)
+        return WC_MENU_SELECTED;
+
+    return state->result;
+}
+
+/* shows a menu and returns user choice or error */
+WC_GLOBAL int WC_menu(MenuItems *menuItems)
+{
+    WC_menuState state;
+    int key;
+
+    if(WC_menu_begin(menuItems, &state))
+    {
+        WC_menu_end(&state);
+        return state.result;
+    }
+
+    /* go into the main loop */
+    while(WC_MENU_PENDING == state.result)
+    {
+#ifdef _WINDOWS
+		MSG	msg;
+        if(PeekMessage(&msg, (HWND)NULL, 0, 0, PM_NOREMOVE))
+        {
+    		GetMessage(&msg, (HWND)NULL, 0, 0);
+    		TranslateMessage(&msg);
+    		DispatchMessage(&msg);
+            if(msg.message == WM_QUIT)
+            {
+                state.result = WC_ERROR_CANCEL;
+                break;
+            }
+        }
+#endif //_WINDOWS
+        WC_menu_render(&state);
+
+        /* sleep until a key comes in or the next scroll step is due, if nothing scrolls just wait for a key */
+        if(menuItems->waitMenuFunction || menuItems->waitFunction)
+        {
+            WC_time deadline = WC_menu_next_deadline(&state);
+#ifdef WC_MENU_STATS
+            WC_time waited = WC_menu_now();
+#endif
+            if(WC_WAIT_FOREVER != deadline)
+                deadline = WC_menu_max(0, deadline - WC_menu_now());
+            if(menuItems->waitMenuFunction)
+                menuItems->waitMenuFunction(menuItems, deadline);
+            else
+                menuItems->waitFunction(deadline);
+#ifdef WC_MENU_STATS
+            menuItems->stats.waitTime += WC_menu_now() - waited;
+#endif
         }
 
-        if(menuItems->states)
-        {
-            free(menuItems->states);
-            menuItems->states = 0;
-        }
+        /* handle keyboard, all of what's waiting if the program can say, before the next frame */
+        if(menuItems->readMenuEvents || menuItems->readEvents)
+        {
+            int keys[WC_MENU_EVENTS], numKeys;
+#ifdef WC_MENU_STATS
+            WC_time asked = WC_menu_now();
+#endif
+
+            if(menuItems->readMenuEvents)
+                numKeys = menuItems->readMenuEvents(menuItems, keys, WC_MENU_EVENTS);
+            else
+                numKeys = menuItems->readEvents(keys, WC_MENU_EVENTS);
+#ifdef WC_MENU_STATS
+            menuItems->stats.inputTime += WC_menu_now() - asked;
+#endif
+            WC_menu_step_keys(&state, keys, numKeys, WC_menu_now());
+        }
+        else
+        {
+#ifdef WC_MENU_STATS
+            WC_time asked = WC_menu_now();
+#endif
+
+            key = menuItems->inputMenuFunction ? menuItems->inputMenuFunction(menuItems) : menuItems->inputFunction();
+#ifdef WC_MENU_STATS
+            menuItems->stats.inputTime += WC_menu_now() - asked;
+#endif
+            WC_menu_step(&state, key, WC_menu_now());
+        }
+    }
+
+    WC_menu_end(&state);
+
+    return state.result;
+}
+
+#ifdef WC_MENU_STATS
+WC_GLOBAL void WC_menu_get_stats(MenuItems *menuItems, WC_menuStats *stats)
+{
+    memcpy(stats, &menuItems->stats, sizeof(WC_menuStats));
+}
+
+WC_GLOBAL void WC_menu_reset_stats(MenuItems *menuItems)
+{
+    memset(&menuItems->stats, 0, sizeof(WC_menuStats));
+}
+
+WC_GLOBAL int WC_menu_stats_json(const WC_menuStats *stats, char *buffer, int capacity)
+{
+    long limits[WC_MENU_STATS_BUCKETS - 1];
+    int i, length;
+
+    for(i=0; i<WC_MENU_STATS_BUCKETS - 1; i++)
+        limits[i] = 1L << i;
+
+    length = snprintf(buffer, capacity,
+        "{\"frames\":%ld,\"spans\":%ld,\"cells\":%ld,\"lastSpans\":%d,\"lastCells\":%d,"
+        "\"steps\":%ld,\"keys\":%ld,\"moves\":%ld,\"pages\":%ld,\"filterKeys\":%ld,\"selects\":%ld,\"cancels\":%ld,"
+        "\"callbacks\":%ld,\"renderTime\":%lld,\"drawTime\":%lld,\"inputTime\":%lld,\"waitTime\":%lld,\"callbackTime\":%lld",
+        stats->frames, stats->spans, stats->cells, stats->lastSpans, stats->lastCells,
+        stats->steps, stats->keys, stats->moves, stats->pages, stats->filterKeys, stats->selects, stats->cancels,
+        stats->callbacks, stats->renderTime, stats->drawTime, stats->inputTime, stats->waitTime, stats->callbackTime);
+    length = WC_menu_stats_array(buffer, capacity, length, "frameTimes", stats->frameTimes, WC_MENU_STATS_BUCKETS);
+    length = WC_menu_stats_array(buffer, capacity, length, "latencies", stats->latencies, WC_MENU_STATS_BUCKETS);
+    length = WC_menu_stats_array(buffer, capacity, length, "bucketsUs", limits, WC_MENU_STATS_BUCKETS - 1);
+    length += snprintf(length < capacity ? &buffer[length] : 0, length < capacity ? capacity - length : 0, "}");
+
+    return length;
+}
+
+/* appends ,"name":[values] to what WC_menu_stats_json has written */
+WC_INTERNAL int WC_menu_stats_array(char *buffer, int capacity, int length, const char *name, const long *values, int count)
+{
+    int i;
+
+    length += snprintf(length < capacity ? &buffer[length] : 0, length < capacity ? capacity - length : 0, ",\"%s\":[", name);
+    for(i=0; i<count; i++)
+        length += snprintf(length < capacity ? &buffer[length] : 0, length < capacity ? capacity - length : 0, i ? ",%ld" : "%ld", values[i]);
+    length += snprintf(length < capacity ? &buffer[length] : 0, length < capacity ? capacity - length : 0, "]");
+
+    return length;
+}
+
+/* bucket n is under 2^n microseconds */
+WC_INTERNAL int WC_menu_stats_bucket(WC_time time)
+{
+    WC_time micros = time / 1000;
+    int bucket = 0;
+
+    while(micros > 0 && bucket < WC_MENU_STATS_BUCKETS - 1)
+    {
+        micros >>= 1;
+        bucket++;
+    }
+
+    return bucket;
+}
+
+WC_INTERNAL void WC_menu_stats_key(WC_menuStats *stats, int key)
+{
+    stats->steps++;
+    if(!key)
+        return;
+
+    stats->keys++;
+    /* the key's 1st time into the menu; the frame after will show it */
+    if(!stats->pressed)
+        stats->pressed = WC_menu_now();
+
+    /* the same order WC_menu_step tests them in */
+    if(key & WC_INPUT_MOTION)
+        stats->moves++;
+    else if(key & WC_INPUT_PAGING)
+        stats->pages++;
+    else if(key & WC_INPUT_SELECT)
+        stats->selects++;
+    else if(key & WC_INPUT_BACKUP)
+        stats->cancels++;
+    else if(key & WC_INPUT_FILTER)
+        stats->filterKeys++;
+}
+
+WC_INTERNAL void WC_menu_stats_spans(WC_menuStats *stats, WC_menuFrame *frame)
+{
+    int i, cells = 0;
+
+    for(i=0; i<frame->numSpans; i++)
+        cells += frame->spans[i].length;
+
+    stats->lastSpans = frame->numSpans;
+    stats->lastCells = cells;
+    stats->spans += frame->numSpans;
+    stats->cells += cells;
+}
+
+WC_INTERNAL void WC_menu_stats_frame(WC_menuStats *stats, WC_time started)
+{
+    WC_time now = WC_menu_now();
+
+    stats->frames++;
+    stats->renderTime += now - started;
+    stats->frameTimes[WC_menu_stats_bucket(now - started)]++;
+    if(stats->pressed)
+    {
+        stats->latencies[WC_menu_stats_bucket(now - stats->pressed)]++;
+        stats->pressed = 0;
+    }
+}
+#endif /* WC_MENU_STATS */
+
+WC_GLOBAL int WC_menu_record_begin(WC_menuRecorder *rec, MenuItems *menuItems, const int *script, int scriptLength)
+{
+    memset(rec, 0, sizeof(WC_menuRecorder));
+    rec->menuItems = menuItems;
+    rec->script = script;
+    rec->scriptLength = scriptLength;
+    rec->hash = 2166136261UL;
+
+    if(WC_NONE == menuItems->sy && WC_NONE == menuItems->sx)
+    {
+        menuItems->sy = 24;
+        menuItems->sx = 80;
+    }
+    rec->sy = WC_menu_max(1, menuItems->sy);
+    rec->sx = WC_menu_max(1, menuItems->sx);
+    rec->screen = (char*)WC_menu_heap_alloc(menuItems, (size_t)rec->sy * rec->sx * 2);
+    if(!rec->screen)
+        return -1;
+    rec->colors = (unsigned char*)&rec->screen[rec->sy * rec->sx];
+    memset(rec->screen, ' ', (size_t)rec->sy * rec->sx);
+    memset(rec->colors, 0, (size_t)rec->sy * rec->sx);
+
+    return 0;
+}
+
+WC_GLOBAL void WC_menu_record_end(WC_menuRecorder *rec)
+{
+    if(rec->menuItems->drawContext == rec)
+        rec->menuItems->drawContext = 0;
+    WC_menu_heap_free(rec->menuItems, rec->screen);
+    rec->screen = 0;
+    rec->colors = 0;
+}
+
+WC_GLOBAL void WC_menu_record_use(WC_menuRecorder *rec)
+{
+    MenuItems *menuItems = rec->menuItems;
+
+    menuItems->drawContext = rec;
+    menuItems->inputMenuFunction = WC_menu_record_input;
+    menuItems->drawBatchFunction = WC_menu_record_draw;
+    menuItems->showMenuFunction = WC_menu_record_show;
+    menuItems->readEvents = 0;
+    menuItems->readMenuEvents = 0;
+    menuItems->waitFunction = 0;
+    menuItems->waitMenuFunction = 0;
+}
+
+WC_GLOBAL void WC_menu_record_spans(WC_menuRecorder *rec, WC_menuSpan *spans, int numSpans)
+{
+    unsigned long hash = rec->hash;
+    int i, j;
+
+    for(i=0; i<numSpans; i++)
+    {
+        WC_menuSpan *span = &spans[i];
+        int ended = 0, offset = span->y * rec->sx + span->x;
 
-        if(menuItems->callbacks)
+        hash = ((hash ^ (unsigned long)(span->y * 256 + span->x)) * 16777619UL) & 0xFFFFFFFFUL;
+        hash = ((hash ^ (unsigned long)span->color) * 16777619UL) & 0xFFFFFFFFUL;
+        for(j=0; j<span->length; j++)
         {
-            free(menuItems->callbacks);
-            menuItems->callbacks = 0;
+            /* the text, padded with spaces once it ends, as a drawFunction does */
+            char c = ' ';
+
+            if(!ended && span->string[j])
+                c = span->string[j];
+            else
+                ended = 1;
+            hash = ((hash ^ (unsigned char)c) * 16777619UL) & 0xFFFFFFFFUL;
+            if(span->y >= 0 && span->y < rec->sy && span->x + j >= 0 && span->x + j < rec->sx)
+            {
+                rec->screen[offset + j] = c;
+                rec->colors[offset + j] = (unsigned char)span->color;
+            }
         }
-        menuItems->selfOwnsMemory = 0;
+        rec->cells += span->length;
     }
+    rec->spans += numSpans;
+    rec->hash = hash;
 }
 
-/* shows a menu and returns user choice or error */
-WC_GLOBAL int WC_menu(MenuItems *menuItems)
+/* inputMenuFunction: the script's next key, then ESC */
+WC_GLOBAL int WC_menu_record_input(MenuItems *menuItems)
 {
-    int i,
-        _x,
-        _y,
-        numMenuItems,
-        numMenuHeaders,
-        numMenuFooters,
-        numMenuStates,
-        numVisibleItems,
-        titleLength,
-        footerLength,
-        selectedItem,
-        topItem,
-        itemOffset,
-        itemDirection,
-        footerOffset,
-        line,
-        key;
-    struct timespec startTime, thisTime;
+    WC_menuRecorder *rec = (WC_menuRecorder*)menuItems->drawContext;
+    int key;
 
-    /* make sure there are items provided */
-    if(!menuItems->items || !*menuItems->items)
-        return WC_ERROR_NONE_ENABLED;
+    if(!rec || rec->position >= rec->scriptLength)
+        return WC_INPUT_KEY_ESCAPE;
+    key = rec->script[rec->position++];
+    if(key)
+    {
+        rec->keys++;
+        rec->pressed = WC_menu_now();
+    }
 
-    /* make sure there's enough screen to display at least line with the selectors (><) and 1 char */
-    if(menuItems->sy < 1 || menuItems->sx < 3)
-        return WC_ERROR_WINDOW_SMALL;
+    return key;
+}
 
-    /* create placeholder y/x locations */
-    _y = WC_NONE == menuItems->y ? 0 : menuItems->y;
-    _x = WC_NONE == menuItems->x ? 0 : menuItems->x;
+/* drawBatchFunction for the recorder WC_menu_record_use set up */
+WC_GLOBAL void WC_menu_record_draw(MenuItems *menuItems, WC_menuSpan *spans, int numSpans)
+{
+    if(menuItems->drawContext)
+        WC_menu_record_spans((WC_menuRecorder*)menuItems->drawContext, spans, numSpans);
+}
 
-    /* make sure the top left edge of the menu is on-screen */
-    if(_y < 0 || _y >= menuItems->sy || _x < 0 || _x > menuItems->sx-3)
-        return WC_ERROR_NOT_ONSCREEN;
+/* showMenuFunction: a frame's done, showing the last key pressed */
+WC_GLOBAL void WC_menu_record_show(MenuItems *menuItems)
+{
+    WC_menuRecorder *rec = (WC_menuRecorder*)menuItems->drawContext;
 
-    /* get sizes of menu elements */
-    numMenuItems = WC_menu_len(menuItems->items);
-    numMenuHeaders = menuItems->title ? menuItems->title_height : 0;
-    numMenuFooters = menuItems->footer ? menuItems->footer_height : 0;
-    numMenuStates = menuItems->states ? WC_menu_count(menuItems->states) : 0;
+    if(!rec)
+        return;
+    if(!rec->frames++)
+        rec->firstFrame = WC_menu_now();
+    if(rec->pressed)
+    {
+        WC_time latency = WC_menu_now() - rec->pressed;
 
-    /* get length of the title & footer */
-    titleLength = menuItems->title ? strlen(menuItems->title) : 0;
-    footerLength = menuItems->footer ? strlen(menuItems->footer) : 0;
+        rec->latency += latency;
+        rec->latencyMax = WC_menu_max(rec->latencyMax, latency);
+        rec->pressed = 0;
+    }
+}
 
-    /* now calc height if not provided */
-    if(WC_NONE == menuItems->height)
-        menuItems->height = numMenuItems + numMenuHeaders + numMenuFooters;
-    /* make sure height fits on screen */
-    if(_y + menuItems->height > menuItems->sy - 1)
-        menuItems->height = menuItems->sy - _y - 1;
+#ifdef WC_MENU_TERMINAL
+/* SGR foreground and background for each WC_CLR_ colour, as the curses demos pair them */
+WC_CONSTANT int WC_gMenuTermColors[WC_CLR_BUSY+1][2] =
+{
+    {34, 46},                   /* 0, the background */
+    {32, 44},                   /* WC_CLR_TITLE */
+    {37, 44},                   /* WC_CLR_ITEMS */
+    {36, 44},                   /* WC_CLR_FOOTER */
+    {37, 42},                   /* WC_CLR_SELECT */
+    {33, 44},                   /* WC_CLR_DISABLED */
+    {30, 43},                   /* WC_CLR_BUSY */
+};
 
-    /* calc width if not provided */
-    if(WC_NONE == menuItems->width)
-        menuItems->width = WC_menu_max(WC_menu_maxItemLength(menuItems->items), titleLength);
-    /* make sure it fits on the screen */
-    if(_x + menuItems->width > menuItems->sx - 2)
-        menuItems->width = menuItems->sx - _x - 2;
+/* adds length bytes to the terminal's output, growing it with the menu's allocator */
+WC_INTERNAL int WC_menu_term_put(WC_menuTerminal *term, const char *bytes, int length)
+{
+    if(term->used + length > term->capacity)
+    {
+        int capacity = WC_menu_max(term->capacity ? term->capacity * 2 : WC_MENU_TERM_OUTPUT, term->used + length);
+        char *output = (char*)WC_menu_heap_resize(term->menuItems, term->output, capacity);
 
-    /* centre the menu if y or x was not provided */
-    if(WC_NONE == menuItems->y)
-        menuItems->y = WC_menu_max(0,(int)((menuItems->sy-menuItems->height)/2));
-    if(WC_NONE == menuItems->x)
-        menuItems->x = WC_menu_max(0,(int)((menuItems->sx-(menuItems->width+2))/2));
+        if(!output)
+        {
+            term->dropped += length;
+            return 0;
+        }
+        term->output = output;
+        term->capacity = capacity;
+    }
+    memcpy(&term->output[term->used], bytes, length);
+    term->used += length;
 
-    /* calculate how many items can be shown */
-    numVisibleItems = menuItems->height - (numMenuHeaders + numMenuFooters);
+    return 1;
+}
 
-    /* show 1st enabled item as selected */
-    selectedItem = WC_menu_next_item(menuItems, -1, 1);
-    if(selectedItem > numMenuItems)
-        return WC_ERROR_NONE_ENABLED;
-    /* handle 1st selectable item not being on-screen */
-    topItem = 0;
-    if(selectedItem - topItem >= numVisibleItems)
-        topItem = selectedItem - numVisibleItems + 1;
-    /* start selected item from 1st character */
-    itemOffset = 0;
-    /* if selected item has to scroll, scroll it to the left */
-    itemDirection = 1;
-    /* start footer from 1st character */
-    footerOffset = 0;
+/* ESC [ count final, leaving out a count of 1 */
+WC_INTERNAL int WC_menu_term_csi(char *buffer, int count, char final)
+{
+    if(1 == count)
+        return sprintf(buffer, "\x1b[%c", final);
 
-    /* if no items can be shown then throw exception */
-    if(numVisibleItems < 1)
-        return WC_ERROR_TOO_SMALL;
+    return sprintf(buffer, "\x1b[%d%c", count, final);
+}
 
-    /* init the line (y) variable */
-    line = menuItems->y;
+/* the shortest way from the cursor to y, x */
+WC_INTERNAL int WC_menu_term_move(WC_menuTerminal *term, char *buffer, int y, int x)
+{
+    char relative[48], along[24];
+    int length, used = 0, alongLength;
 
-    /* get time for scrolling purposes */
-    clock_gettime(CLOCK_MONOTONIC,&startTime);
-    /* go into the main loop */
-    while(1)
+    /* absolute, leaving out what defaults to 1 */
+    if(x)
+        length = sprintf(buffer, "\x1b[%d;%dH", y + 1, x + 1);
+    else if(y)
+        length = sprintf(buffer, "\x1b[%dH", y + 1);
+    else
+        length = sprintf(buffer, "\x1b[H");
+    if(WC_NONE == term->y)
+        return length;
+
+    /* or up or down, then along: from the left edge, or from where the cursor is if that's shorter */
+    if(y > term->y)
+        used = WC_menu_term_csi(relative, y - term->y, 'B');
+    else if(y < term->y)
+        used = WC_menu_term_csi(relative, term->y - y, 'A');
+    along[0] = '\r';
+    alongLength = 1 + (x ? WC_menu_term_csi(&along[1], x, 'C') : 0);
+    if(WC_NONE != term->x)
     {
-#ifdef _WINDOWS
-		MSG	msg;
-        if(PeekMessage(&msg, (HWND)NULL, 0, 0, PM_NOREMOVE))
+        char from[24];
+        int fromLength = 0;
+
+        if(x > term->x)
+            fromLength = WC_menu_term_csi(from, x - term->x, 'C');
+        else if(x < term->x)
+            fromLength = WC_menu_term_csi(from, term->x - x, 'D');
+        if(fromLength < alongLength)
         {
-    		GetMessage(&msg, (HWND)NULL, 0, 0);
-    		TranslateMessage(&msg);
-    		DispatchMessage(&msg);
-            if(msg.message == WM_QUIT)
-                return -1;
+            memcpy(along, from, fromLength);
+            alongLength = fromLength;
         }
-#endif //_WINDOWS
-        /* how many items to draw */
-        int numItemsToDraw = WC_menu_min(numMenuItems,topItem+numVisibleItems);
-        char displayOpen[2] = " ";
-        int color;
-
-        /* get time now to calculate elapsed time */
-        clock_gettime(CLOCK_MONOTONIC,&thisTime);
-        /* start at the top to draw */
-        line = menuItems->y;
-
-		/* show the title if there is one to be shown */
-		if(menuItems->title)
-		{
-			int titleLengthClamped = WC_menu_min(titleLength, menuItems->width);
-			int length = ((menuItems->width + (titleLengthClamped % 2 ? 0 : 1)) / 2) - (titleLengthClamped / 2) + 1;
-			menuItems->drawFunction(line, menuItems->x, " ", length, WC_CLR_TITLE);
-			menuItems->drawFunction(line, menuItems->x + length, menuItems->title, titleLengthClamped, WC_CLR_TITLE);
-			menuItems->drawFunction(line, menuItems->x + length + titleLengthClamped, " ", 1 + WC_menu_max(0, (menuItems->width / 2) - (titleLengthClamped / 2)), WC_CLR_TITLE);
-			line += 1;
-			/* pad out the title area */
-			while(line - menuItems->y < numMenuHeaders)
-			{
-				menuItems->drawFunction(line, menuItems->x, " ", menuItems->width + 2, WC_CLR_TITLE);
-				line += 1;
-			}
-		}
-		
-		/* show the visible menu items, highlighting the selected item */
-        for(i=topItem; i<numItemsToDraw; i++)
-        {
-            char displayLength;
+    }
+    memcpy(&relative[used], along, alongLength);
+    used += alongLength;
 
-            /* pick the enabled/disabled colour */
-            if(menuItems->states && i < numMenuStates && menuItems->states[i] != WC_ENABLED)
-                color = WC_CLR_DISABLED;
-            else
-                color = WC_CLR_ITEMS;
+    if(used < length)
+    {
+        memcpy(buffer, relative, used);
+        length = used;
+    }
 
-            /* handle the item that's selected */
-            if(i == selectedItem)
-            {
-                *displayOpen = '>';
-                color = WC_CLR_SELECT;
-                /* if selected item should scroll based on time */
-                if(WC_menu_elapsedTime(startTime, thisTime) > WC_SCROLL_SPEED)
-                {
-                    /* if the item is longer than the menu width, bounce the item back and forth in the menu display */
-                    displayLength = strlen(menuItems->items[i]);
-                    if(displayLength > menuItems->width)
-                    {
-                        itemOffset += itemDirection;
-                        /* swap scroll itemDirection but hold for one frame at either end */
-                        if(itemOffset == 0 || itemOffset > displayLength - menuItems->width)
-                        {
-                            if(itemDirection)
-                                itemDirection = 0;
-                            else if(itemOffset == 0)
-                                itemDirection = 1;
-                            else
-                                itemDirection = -1;
-                        }
-                    }
-                }
-            }
-            else
+    return length;
+}
+
+/* the key an escape sequence's final part stands for, 0 if none */
+WC_INTERNAL int WC_menu_term_escape_key(const unsigned char *sequence, int length)
+{
+    switch(sequence[length - 1])
+    {
+        case 'A':
+            return WC_INPUT_KEY_UP;
+        case 'B':
+            return WC_INPUT_KEY_DOWN;
+        case 'H':
+            return WC_INPUT_KEY_HOME;
+        case 'F':
+            return WC_INPUT_KEY_END;
+        case '~':
+            /* ESC [ n ~ */
+            switch(atoi((const char*)sequence))
             {
-                *displayOpen = ' ';
+                case 1:
+                case 7:
+                    return WC_INPUT_KEY_HOME;
+                case 4:
+                case 8:
+                    return WC_INPUT_KEY_END;
+                case 5:
+                    return WC_INPUT_KEY_PAGE_UP;
+                case 6:
+                    return WC_INPUT_KEY_PAGE_DOWN;
             }
+    }
 
-            /* show 1st character of string */
-            menuItems->drawFunction(line, menuItems->x, displayOpen, 1, color);
+    return 0;
+}
 
-            if(i == selectedItem)
-                menuItems->drawFunction(line, menuItems->x+1, &menuItems->items[i][itemOffset], menuItems->width, color);
-            else
-                menuItems->drawFunction(line, menuItems->x+1, menuItems->items[i], menuItems->width, color);
-
-            /* put < on selected except the top/bottom when there are more options off-screen which then get ^ or V */
-            if(i == topItem && topItem != 0)
-                *displayOpen = '^';
-            else if(i == topItem+numVisibleItems-1 && i != numMenuItems-1)
-                *displayOpen = 'v';
-            else if(i == selectedItem)
-                *displayOpen = '<';
-            else
-                *displayOpen = ' ';
-            menuItems->drawFunction(line, menuItems->x+1+menuItems->width, displayOpen, 1, color);
-            
-            line += 1;
-        }
+/* sets up term for menuItems' menu on terminal fd */
+WC_GLOBAL int WC_menu_term_begin(WC_menuTerminal *term, MenuItems *menuItems, int fd)
+{
+    static const char start[] = "\x1b[?25l\x1b[0m\x1b[2J\x1b[H";
+    struct winsize size;
+    struct termios raw;
+
+    memset(term, 0, sizeof(WC_menuTerminal));
+    term->fd = fd;
+    term->menuItems = menuItems;
+    memcpy(term->colors, WC_gMenuTermColors, sizeof(term->colors));
+    term->foreground = term->background = WC_NONE;
+
+    /* the first frame starts with the cursor hidden, top left of a clear screen */
+    if(!WC_menu_term_put(term, start, sizeof(start) - 1))
+        return -1;
+    term->y = term->x = 0;
 
-        /* pad out the footer area, if there is one */
-        while(line < menuItems->y + numVisibleItems + numMenuFooters + numMenuHeaders)
+    /* keys as they're pressed, not echoed, and output exactly as sent */
+    if(fd >= 0 && isatty(fd))
+    {
+        if(tcgetattr(fd, &term->saved))
         {
-            menuItems->drawFunction(line, menuItems->x, " ", menuItems->width+2, WC_CLR_FOOTER);
-            line += 1;
+            WC_menu_heap_free(menuItems, term->output);
+            term->output = 0;
+            return -1;
         }
+        raw = term->saved;
+        raw.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON);
+        raw.c_oflag &= ~OPOST;
+        raw.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+        raw.c_cflag &= ~(CSIZE | PARENB);
+        raw.c_cflag |= CS8;
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+        tcsetattr(fd, TCSANOW, &raw);
+        term->isRaw = 1;
 
-        /* display the footer if there is one */
-        if(menuItems->footer)
+        if(!ioctl(fd, TIOCGWINSZ, &size) && size.ws_row && size.ws_col && WC_NONE == menuItems->sy && WC_NONE == menuItems->sx)
         {
-            int remain = footerLength - footerOffset;
-            int column = menuItems->x;
-            int length = WC_menu_min(remain, menuItems->width);
+            menuItems->sy = size.ws_row;
+            menuItems->sx = size.ws_col;
+        }
+    }
+
+    return 0;
+}
+
+/* writes what's left, puts the terminal back and frees the output */
+WC_GLOBAL void WC_menu_term_end(WC_menuTerminal *term)
+{
+    static const char reset[] = "\x1b[0m\x1b[2J\x1b[H\x1b[?25h";
+
+    if(term->fd >= 0)
+    {
+        WC_menu_term_put(term, reset, sizeof(reset) - 1);
+        WC_menu_term_flush(term);
+    }
+    if(term->isRaw)
+        tcsetattr(term->fd, TCSANOW, &term->saved);
+    term->isRaw = 0;
+    WC_menu_heap_free(term->menuItems, term->output);
+    term->output = 0;
+    term->used = term->capacity = 0;
+    if(term->menuItems && term->menuItems->drawContext == term)
+        term->menuItems->drawContext = 0;
+}
+
+/* makes WC_menu draw on and read keys from term */
+WC_GLOBAL void WC_menu_term_use(WC_menuTerminal *term)
+{
+    MenuItems *menuItems = term->menuItems;
+
+    menuItems->drawContext = term;
+    menuItems->drawBatchFunction = WC_menu_term_draw;
+    menuItems->showMenuFunction = WC_menu_term_show;
+    menuItems->readMenuEvents = WC_menu_term_read_events;
+    menuItems->waitMenuFunction = WC_menu_term_wait;
+    /* only the cells that changed are sent */
+    menuItems->useBackBuffer = 1;
+}
+
+/* encodes spans into term->output */
+WC_GLOBAL void WC_menu_term_spans(WC_menuTerminal *term, WC_menuSpan *spans, int numSpans)
+{
+    char buffer[48];
+    int i, length;
 
-            /* open the line and print as much of the footer as is visible */
-            menuItems->drawFunction(line, column++, " ", 1, WC_CLR_FOOTER);
-            menuItems->drawFunction(line, column, &menuItems->footer[footerOffset], length, WC_CLR_FOOTER);
+    for(i=0; i<numSpans; i++)
+    {
+        WC_menuSpan *span = &spans[i];
+        int color = span->color >= 0 && span->color <= WC_CLR_BUSY ? span->color : 0;
+        int foreground = term->colors[color][0], background = term->colors[color][1];
+        int textLength = 0, padding;
+
+        if(span->y != term->y || span->x != term->x)
+            WC_menu_term_put(term, buffer, WC_menu_term_move(term, buffer, span->y, span->x));
+
+        /* only the half of the colour that changed */
+        if(foreground != term->foreground && background != term->background)
+            length = sprintf(buffer, "\x1b[%d;%dm", foreground, background);
+        else if(foreground != term->foreground)
+            length = sprintf(buffer, "\x1b[%dm", foreground);
+        else if(background != term->background)
+            length = sprintf(buffer, "\x1b[%dm", background);
+        else
+            length = 0;
+        WC_menu_term_put(term, buffer, length);
+        term->foreground = foreground;
+        term->background = background;
+
+        while(textLength < span->length && span->string[textLength])
+            textLength++;
+        WC_menu_term_put(term, span->string, textLength);
+        term->y = span->y;
+        term->x = span->x + textLength;
 
-            /* fill the footer ine with the footer text by wrapping */
-            while(remain < menuItems->width)
+        /* padding wider than the sequence is erased (in the background colour) without moving the */
+        /* cursor, unless the next span starts straight after it and moving there would cost more */
+        padding = span->length - textLength;
+        if(padding > 0)
+        {
+            int next = i + 1 < numSpans && spans[i+1].y == span->y && spans[i+1].x == span->x + span->length;
+
+            length = WC_menu_term_csi(buffer, padding, 'X');
+            if(next)
+                length += WC_menu_term_csi(&buffer[length], padding, 'C');
+            if(length < padding)
             {
-                column += length;
-                length = WC_menu_min(footerLength, menuItems->width-remain);
-                menuItems->drawFunction(line, column, menuItems->footer, length, WC_CLR_FOOTER);
-                remain += footerLength;
+                WC_menu_term_put(term, buffer, length);
+                if(next)
+                    term->x += padding;
             }
-            column += length;
-            menuItems->drawFunction(line, column, " ", 1, WC_CLR_FOOTER);
+            else
+            {
+                /* (so padding is no longer than the sequences, and fits in buffer) */
+                memset(buffer, ' ', padding);
+                WC_menu_term_put(term, buffer, padding);
+                term->x += padding;
+            }
+        }
+
+        /* at the right edge the cursor waits to wrap, and terminals differ on where that leaves it */
+        if(term->x >= term->menuItems->sx)
+            term->x = WC_NONE;
+    }
+}
+
+/* writes term->output */
+WC_GLOBAL int WC_menu_term_flush(WC_menuTerminal *term)
+{
+    int sent = 0;
+
+    if(term->used)
+        term->frames++;
+    while(sent < term->used)
+    {
+        ssize_t written = write(term->fd, &term->output[sent], term->used - sent);
+
+        term->writes++;
+        if(written < 0 && EINTR == errno)
+            continue;
+        if(written < 0 && (EAGAIN == errno || EWOULDBLOCK == errno))
+        {
+            struct pollfd fds;
+
+            /* a non-blocking terminal: wait for room */
+            fds.fd = term->fd;
+            fds.events = POLLOUT;
+            fds.revents = 0;
+            poll(&fds, 1, -1);
+            continue;
+        }
+        if(written <= 0)
+        {
+            term->used = 0;
+            return 0;
         }
+        term->bytes += written;
+        sent += (int)written;
+    }
+    term->used = 0;
 
-        if(menuItems->showFunction)
-            menuItems->showFunction();
+    return 1;
+}
+
+/* turns bytes read from the terminal into keys */
+WC_GLOBAL int WC_menu_term_keys(WC_menuTerminal *term, const unsigned char *bytes, int length, int *keys)
+{
+    int i = 0, numKeys = 0;
 
-        /* calculate a new scroll position for the footer */
-        if(WC_menu_elapsedTime(startTime, thisTime) > WC_SCROLL_SPEED)
+    /* an escape sequence the last read left unfinished is finished by the start of this one */
+    if(term->numPending)
+    {
+        while(i < length && term->numPending < (int)sizeof(term->pending) && (bytes[i] < 0x40 || bytes[i] > 0x7e))
+            term->pending[term->numPending++] = bytes[i++];
+        if(i == length && term->numPending < (int)sizeof(term->pending))
+            return 0;
+        if(i < length && term->numPending < (int)sizeof(term->pending))
         {
-            footerOffset += 1;
-            clock_gettime(CLOCK_MONOTONIC,&startTime);
-            if(footerOffset == footerLength)
-                footerOffset = 0;
+            term->pending[term->numPending++] = bytes[i++];
+            if((keys[numKeys] = WC_menu_term_escape_key(&term->pending[2], term->numPending - 2)))
+                numKeys++;
         }
+        /* too long to be a key, it's dropped */
+        term->numPending = 0;
+    }
+
+    while(i < length)
+    {
+        int c = bytes[i++], key = 0;
 
-        /* handle keyboard */
-        key = menuItems->inputFunction();
-        /* this allows callbaks to "press keys" */
-        while(key)
+        if(27 == c)
         {
-            /* cursor key up/down */
-            if(key & WC_INPUT_MOTION)
+            /* ESC with nothing after it in this read is the ESC key */
+            if(i == length)
             {
-                itemOffset = 0;
-                itemDirection = 1;
-                /* cursor down */
-                if(key & WC_INPUT_KEY_DOWN)
-                {
-                    int i = WC_menu_next_item(menuItems, selectedItem, 1);
-                    if(i >= numMenuItems)
-                    {
-                        i = WC_menu_next_item(menuItems, -1, 1);
-                        if(i >= numMenuItems)
-                            return WC_ERROR_NONE_ENABLED;
-                        topItem = 0;
-                    }
-                    /* make sure newly selected item is visible */
-                    if(i - topItem >= numVisibleItems)
-                        topItem = i - numVisibleItems + 1;
-                    selectedItem = i;
-                }
-                /* cursor up */
-                if(key & WC_INPUT_KEY_UP)
-                {
-                    i = WC_menu_next_item(menuItems, selectedItem, -1);
-                    if(i < 0)
-                    {
-                        i = WC_menu_next_item(menuItems, numMenuItems, -1);
-                        if(i < 0)
-                            return WC_ERROR_NONE_ENABLED;
-                        topItem = WC_menu_max(0,numMenuItems - numVisibleItems);
-                    }
-                    if(topItem > i)
-                        topItem = i;
-                    selectedItem = i;
-                }
-                key = 0;
+                key = WC_INPUT_KEY_ESCAPE;
             }
-            /* ENTER key */
-            else if(key & WC_INPUT_SELECT)
+            else if('[' == bytes[i] || 'O' == bytes[i])
             {
-                if(menuItems->callbacks)
+                int start = ++i;
+
+                /* parameters, up to the final byte */
+                while(i < length && (bytes[i] < 0x40 || bytes[i] > 0x7e))
+                    i++;
+                if(i == length)
                 {
-                    /* see if there's a callback and that it's a function */
-                    if(selectedItem < WC_menu_len(menuItems->callbacks) && WC_NO_CALLBACK != menuItems->callbacks[selectedItem])
+                    /* finished by the next read, unless it's too long to be a key */
+                    if(length - start + 2 <= (int)sizeof(term->pending))
                     {
-                        /* the callbak return value should be 0 or a key-define */
-                        key = menuItems->callbacks[selectedItem](menuItems, selectedItem);
-                        /* re-check how many items in the menu as a callback can add/delete items */
-                        numMenuItems = WC_menu_len(menuItems->items);
-                        if(!numMenuItems)
-                            return WC_ERROR_NONE_ENABLED;
-                        numMenuStates = menuItems->states ? WC_menu_count(menuItems->states) : 0;
+                        term->numPending = length - start + 2;
+                        memcpy(term->pending, &bytes[start - 2], term->numPending);
                     }
+                    break;
                 }
-                /* test again - The callback may have altered the key, but if not then done */
-                if(key & WC_INPUT_SELECT)
-                    return selectedItem;
+                key = WC_menu_term_escape_key(&bytes[start], ++i - start);
             }
-            /* ESC key pressed exits with -1 */
-            else if(key & WC_INPUT_BACKUP)
-                return WC_ERROR_CANCEL;
             else
-                break; /* ignore other key-values */
+            {
+                key = WC_INPUT_KEY_ESCAPE;
+            }
+        }
+        else if('\r' == c || '\n' == c)
+        {
+            key = WC_INPUT_KEY_ENTER;
+        }
+        else if(127 == c || 8 == c)
+        {
+            key = WC_INPUT_KEY_BACKSPACE;
+        }
+        else if(3 == c)
+        {
+            /* ctrl-c, which raw mode doesn't turn into a signal */
+            key = WC_INPUT_KEY_ESCAPE;
+        }
+        else if(c >= ' ' && c < 127)
+        {
+            key = WC_INPUT_CHAR(c);
         }
+
+        if(key)
+            keys[numKeys++] = key;
+    }
+
+    return numKeys;
+}
+
+/* drawBatchFunction for the terminal WC_menu_term_use set up */
+WC_GLOBAL void WC_menu_term_draw(MenuItems *menuItems, WC_menuSpan *spans, int numSpans)
+{
+    if(menuItems->drawContext)
+        WC_menu_term_spans((WC_menuTerminal*)menuItems->drawContext, spans, numSpans);
+}
+
+/* showMenuFunction: the frame goes out in one write */
+WC_GLOBAL void WC_menu_term_show(MenuItems *menuItems)
+{
+    WC_menuTerminal *term = (WC_menuTerminal*)menuItems->drawContext;
+
+    if(term && term->fd >= 0)
+        WC_menu_term_flush(term);
+}
+
+/* readMenuEvents: every key waiting on the terminal */
+WC_GLOBAL int WC_menu_term_read_events(MenuItems *menuItems, int *keys, int max)
+{
+    WC_menuTerminal *term = (WC_menuTerminal*)menuItems->drawContext;
+    unsigned char bytes[WC_MENU_EVENTS];
+    struct pollfd fds;
+    ssize_t length;
+
+    if(!term || term->fd < 0 || max < 1)
+        return 0;
+    fds.fd = term->fd;
+    fds.events = POLLIN;
+    fds.revents = 0;
+    if(poll(&fds, 1, 0) < 1)
+        return 0;
+
+    /* a terminal that's gone ends the menu */
+    length = read(term->fd, bytes, WC_menu_min((int)sizeof(bytes), max));
+    if(!length || (length < 0 && EINTR != errno && EAGAIN != errno))
+    {
+        keys[0] = WC_INPUT_KEY_ESCAPE;
+        return 1;
+    }
+    if(length < 0)
+        return 0;
+
+    return WC_menu_term_keys(term, bytes, (int)length, keys);
+}
+
+/* waitMenuFunction: until there's a key on the terminal or the timeout */
+WC_GLOBAL void WC_menu_term_wait(MenuItems *menuItems, WC_time timeout)
+{
+    WC_menuTerminal *term = (WC_menuTerminal*)menuItems->drawContext;
+    struct pollfd fds;
+
+    fds.fd = term ? term->fd : 0;
+    fds.events = POLLIN;
+    fds.revents = 0;
+    poll(&fds, 1, WC_WAIT_FOREVER == timeout ? -1 : (int)((timeout + 999999) / 1000000));
+}
+#endif /* WC_MENU_TERMINAL */
+
+#ifdef WC_MENU_CURSES
+/* spaces that padding is written from, a run at a time */
+WC_CONSTANT char WC_gMenuCursesSpaces[] = "                                                                ";
+/* the colour pair stdscr was last set to, -1 after a frame as the program may draw in between */
+WC_GLOBAL int WC_gMenuCursesColor = -1;
+
+WC_GLOBAL void WC_menu_curses_use(MenuItems *menuItems)
+{
+    menuItems->drawFunction = WC_menu_curses_draw;
+    menuItems->showFunction = WC_menu_curses_show;
+    WC_gMenuCursesColor = -1;
+}
+
+/* drawFunction: the text, then the padding in runs of spaces, with no format to parse */
+WC_GLOBAL void WC_menu_curses_draw(int y, int x, char *string, int length, int color)
+{
+    int used = 0;
+
+    if(color != WC_gMenuCursesColor)
+    {
+        attrset(COLOR_PAIR(color));
+        WC_gMenuCursesColor = color;
+    }
+
+    while(used < length && string[used])
+        used++;
+    mvaddnstr(y, x, string, used);
+    for(length -= used; length > 0; length -= used)
+    {
+        used = WC_menu_min(length, (int)sizeof(WC_gMenuCursesSpaces) - 1);
+        addnstr(WC_gMenuCursesSpaces, used);
     }
 }
 
+/* showFunction: stdscr goes to the screen in one update */
+WC_GLOBAL void WC_menu_curses_show(void)
+{
+    wnoutrefresh(stdscr);
+    doupdate();
+    WC_gMenuCursesColor = -1;
+}
+#endif /* WC_MENU_CURSES */
+
 #endif /* WC_MENU_IMPLEMENTATION */
@@ -0,0 +1,731 @@
+/*
+    wcserver.h runs many wcmenu.h menus at once, one per terminal (a pty or a
+    Unix socket), as independent WC_menuState objects on one epoll thread or
+    a few, drawing with wcmenu.h's terminal backend.  Linux only.  Include
+    it where wcmenu.h would be included.
+*/
+
+#ifndef WCSERVER_H_
+#define WCSERVER_H_
+
+#ifndef WC_MENU_TERMINAL
+#define WC_MENU_TERMINAL
+#endif
+#include "wcmenu.h"
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/* most threads a server runs sessions on */
+#ifndef WC_SERVER_SHARDS_MAX
+#define WC_SERVER_SHARDS_MAX 16
+#endif
+
+/* most menu memory a session may use, unless the server says otherwise */
+#ifndef WC_SERVER_MEMORY
+#define WC_SERVER_MEMORY     (4*1024*1024)
+#endif
+
+/* bytes of input read at a time, and epoll events taken at a time */
+#define WC_SERVER_INPUT      256
+#define WC_SERVER_EVENTS     64
+
+/* what every frame ends with (hiding the cursor), so a client can tell where frames end */
+#define WC_SERVER_FRAME_END  "\x1b[?25l"
+
+/* one terminal and its menu */
+typedef struct tagWC_serverSession
+{
+        MenuItems menuItems;    /* the session's menu, set up by the server's sessionBegin */
+        WC_menuState state;     /* ... running */
+        struct tagWC_server *server;
+        struct tagWC_serverShard *shard; /* the thread the session runs on */
+        int fd;                 /* the terminal */
+        void *userData;         /* for the program */
+        size_t memory;          /* bytes of menu memory in use */
+        size_t memoryPeak;      /* the most it's used */
+        size_t memoryCap;       /* the most it may use */
+        WC_menuTerminal terminal; /* encodes its frames and decodes its keys, fd -1 as the server writes */
+        int outputSent;         /* bytes of terminal.output written */
+        int waiting;            /* 1 = the terminal hasn't taken all of the last frame */
+        int frameDue;           /* 1 = the menu changed, and a frame's waiting for the last to go */
+        WC_time deadline;       /* when the menu next needs stepping, WC_WAIT_FOREVER if never */
+        struct tagWC_serverSession *next; /* the shard's sessions */
+        struct tagWC_serverSession *prev;
+} WC_serverSession;
+
+/* a thread running sessions, and the sessions waiting to join it */
+typedef struct tagWC_serverShard
+{
+        struct tagWC_server *server;
+        int epoll;              /* the shard's sessions' terminals, and wake */
+        int wake;               /* eventfd other threads write to, to hand over sessions or stop */
+        pthread_t thread;
+        pthread_mutex_t lock;   /* guards incoming */
+        WC_serverSession *incoming; /* sessions handed to the shard, not yet started */
+        WC_serverSession *sessions; /* sessions running */
+        int numSessions;
+        WC_time deadline;       /* no session needs stepping before this, WC_WAIT_FOREVER if none ever does */
+} WC_serverShard;
+
+/* a server: sessions spread over numShards threads */
+typedef struct tagWC_server
+{
+        WC_serverShard shards[WC_SERVER_SHARDS_MAX];
+        int numShards;
+        int listenFd;           /* Unix socket new sessions connect to, -1 if none */
+        int sy, sx;             /* screen size of sockets, and of ptys that don't know theirs */
+        size_t memoryCap;       /* each session's memory cap */
+        int (*sessionBegin)(WC_serverSession *session); /* sets up session->menuItems; 0 refuses the session */
+        void (*sessionEnd)(WC_serverSession *session); /* called once the menu's done, see session->state.result */
+        void *userData;         /* for the program */
+        volatile int quit;      /* 1 = stop */
+        unsigned long nextShard;/* where the next session goes */
+        long numOpened;         /* sessions started */
+        long numClosed;         /* sessions ended */
+        long numRefused;        /* sessions sessionBegin, WC_menu_begin or memory turned away (counted in numClosed too if running) */
+} WC_server;
+
+/*--------------------------------------------------------------------------*\
+  internal functions used by the server
+\*--------------------------------------------------------------------------*/
+/* allocation functions counting a session's memory against its cap */
+WC_INTERNAL void *WC_server_heap_alloc(void *context, size_t size);
+WC_INTERNAL void *WC_server_heap_resize(void *context, void *ptr, size_t size);
+WC_INTERNAL void WC_server_heap_free(void *context, void *ptr);
+/* drawBatchFunction: encodes a frame's spans into the session's terminal output */
+WC_INTERNAL void WC_server_draw(MenuItems *menuItems, WC_menuSpan *spans, int numSpans);
+/* inputFunction, never called as keys arrive through epoll */
+WC_INTERNAL int WC_server_no_input(void);
+/* writes what output the terminal takes; 0 if the terminal's gone */
+WC_INTERNAL int WC_server_flush(WC_serverSession *session);
+/* renders a frame if one's due and the last has been written, and writes it; 0 if the terminal's gone */
+/* or the frame didn't fit in the session's memory */
+WC_INTERNAL int WC_server_frame(WC_serverSession *session);
+/* notes when the session's menu next needs stepping */
+WC_INTERNAL void WC_server_schedule(WC_serverSession *session);
+/* turns bytes read from the terminal into keys and steps the menu with them */
+WC_INTERNAL void WC_server_keys(WC_serverSession *session, const unsigned char *bytes, int length, WC_time now);
+/* hands a new session on fd to the next shard; 0 if out of memory */
+WC_INTERNAL int WC_server_hand_over(WC_server *server, int fd);
+/* starts sessions handed to the shard */
+WC_INTERNAL void WC_server_take_incoming(WC_serverShard *shard);
+/* sets up and begins a session's menu on its shard; 0 if it can't run */
+WC_INTERNAL int WC_server_start(WC_serverSession *session);
+/* ends a session's menu, closes its terminal and frees it */
+WC_INTERNAL void WC_server_close(WC_serverSession *session);
+/* accepts every connection waiting on the listening socket */
+WC_INTERNAL void WC_server_accept(WC_server *server);
+/* a shard's loop: terminals, timers and frames until the server stops */
+WC_INTERNAL void *WC_server_shard_loop(void *arg);
+
+/*--------------------------------------------------------------------------*\
+  user callable functions
+\*--------------------------------------------------------------------------*/
+/*
+   sets up a server running sessions on numShards threads (1 to
+   WC_SERVER_SHARDS_MAX).  Fill in sessionBegin (and sessionEnd, sy, sx,
+   memoryCap, userData as needed) before WC_server_run.  Returns 0 if
+   it can't
+*/
+WC_GLOBAL int WC_server_init(WC_server *server, int numShards);
+/* listens for sessions on a Unix socket at path; 0 if it can't */
+WC_GLOBAL int WC_server_listen(WC_server *server, const char *path);
+/*
+   adds a session on terminal fd, a pty (put in raw mode here) or a
+   connected socket.  Can be called from any thread, before or while the
+   server runs.  The server closes fd when the session ends.  0 if out of
+   memory
+*/
+WC_GLOBAL int WC_server_add(WC_server *server, int fd);
+/* runs the shards (numShards-1 threads, and this one) until WC_server_stop */
+WC_GLOBAL void WC_server_run(WC_server *server);
+/* makes WC_server_run return, from any thread */
+WC_GLOBAL void WC_server_stop(WC_server *server);
+/* ends every session and frees what the server has, after WC_server_run returns */
+WC_GLOBAL void WC_server_free(WC_server *server);
+
+/*--------------------------------------------------------------------------*\
+  implementation
+\*--------------------------------------------------------------------------*/
+
+/* counts size bytes against the session's cap */
+WC_INTERNAL void *WC_server_heap_alloc(void *context, size_t size)
+{
+    WC_serverSession *session = (WC_serverSession*)context;
+    WC_menuArenaBlock *block;
+
+    if(session->memory + size > session->memoryCap)
+        return 0;
+    block = (WC_menuArenaBlock*)malloc(sizeof(WC_menuArenaBlock) + size);
+    if(!block)
+        return 0;
+    block->capacity = size;
+    session->memory += size;
+    session->memoryPeak = WC_menu_max(session->memoryPeak, session->memory);
+
+    return block + 1;
+}
+
+/* realloc, counting the difference against the session's cap */
+WC_INTERNAL void *WC_server_heap_resize(void *context, void *ptr, size_t size)
+{
+    WC_serverSession *session = (WC_serverSession*)context;
+    WC_menuArenaBlock *block;
+    size_t old;
+
+    if(!ptr)
+        return WC_server_heap_alloc(context, size);
+    block = (WC_menuArenaBlock*)ptr - 1;
+    old = block->capacity;
+    if(size > old && session->memory + (size - old) > session->memoryCap)
+        return 0;
+    block = (WC_menuArenaBlock*)realloc(block, sizeof(WC_menuArenaBlock) + size);
+    if(!block)
+        return 0;
+    block->capacity = size;
+    session->memory = session->memory - old + size;
+    session->memoryPeak = WC_menu_max(session->memoryPeak, session->memory);
+
+    return block + 1;
+}
+
+/* gives the block's bytes back to the session */
+WC_INTERNAL void WC_server_heap_free(void *context, void *ptr)
+{
+    WC_serverSession *session = (WC_serverSession*)context;
+    WC_menuArenaBlock *block;
+
+    if(!ptr)
+        return;
+    block = (WC_menuArenaBlock*)ptr - 1;
+    session->memory -= block->capacity;
+    free(block);
+}
+
+/* drawBatchFunction: encodes a frame's spans into the session's terminal output */
+WC_INTERNAL void WC_server_draw(MenuItems *menuItems, WC_menuSpan *spans, int numSpans)
+{
+    WC_serverSession *session = (WC_serverSession*)menuItems->drawContext;
+
+    WC_menu_term_spans(&session->terminal, spans, numSpans);
+}
+
+/* inputFunction, never called as keys arrive through epoll */
+WC_INTERNAL int WC_server_no_input(void)
+{
+    return 0;
+}
+
+/* writes what output the terminal takes; 0 if the terminal's gone */
+WC_INTERNAL int WC_server_flush(WC_serverSession *session)
+{
+    WC_menuTerminal *terminal = &session->terminal;
+    struct epoll_event event;
+
+    while(session->outputSent < terminal->used)
+    {
+        ssize_t sent = write(session->fd, &terminal->output[session->outputSent], terminal->used - session->outputSent);
+
+        if(sent < 0 && EINTR == errno)
+            continue;
+        if(sent < 0 && (EAGAIN == errno || EWOULDBLOCK == errno))
+        {
+            /* wait for room, then carry on */
+            if(!session->waiting)
+            {
+                session->waiting = 1;
+                event.events = EPOLLIN | EPOLLOUT;
+                event.data.ptr = session;
+                epoll_ctl(session->shard->epoll, EPOLL_CTL_MOD, session->fd, &event);
+            }
+            return 1;
+        }
+        if(sent <= 0)
+            return 0;
+        session->outputSent += (int)sent;
+        terminal->bytes += sent;
+        terminal->writes++;
+    }
+
+    /* all written, so the output starts over and there's no need to hear when there's room */
+    if(terminal->used)
+        terminal->frames++;
+    terminal->used = session->outputSent = 0;
+    if(session->waiting)
+    {
+        session->waiting = 0;
+        event.events = EPOLLIN;
+        event.data.ptr = session;
+        epoll_ctl(session->shard->epoll, EPOLL_CTL_MOD, session->fd, &event);
+    }
+
+    return 1;
+}
+
+/* renders a frame if one's due and the last has been written, and writes it; 0 if the terminal's gone */
+/* or the frame didn't fit in the session's memory */
+WC_INTERNAL int WC_server_frame(WC_serverSession *session)
+{
+    int used = session->terminal.used;
+
+    /* a terminal that's behind gets the latest frame once it catches up, not every one in between */
+    if(!session->frameDue || session->waiting)
+        return 1;
+    session->frameDue = 0;
+
+    WC_menu_render(&session->state);
+    if(session->terminal.used == used)
+        return 1;
+    WC_menu_term_put(&session->terminal, WC_SERVER_FRAME_END, sizeof(WC_SERVER_FRAME_END) - 1);
+    /* the back-buffer thinks the cells left out were sent, so the screen would stay wrong: the session ends */
+    if(session->terminal.dropped)
+    {
+        __atomic_fetch_add(&session->server->numRefused, 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    return WC_server_flush(session);
+}
+
+/* notes when the session's menu next needs stepping */
+WC_INTERNAL void WC_server_schedule(WC_serverSession *session)
+{
+    WC_serverShard *shard = session->shard;
+
+    session->deadline = WC_menu_next_deadline(&session->state);
+    if(WC_WAIT_FOREVER != session->deadline && (WC_WAIT_FOREVER == shard->deadline || session->deadline < shard->deadline))
+        shard->deadline = session->deadline;
+}
+
+/* turns bytes read from the terminal into keys and steps the menu with them */
+WC_INTERNAL void WC_server_keys(WC_serverSession *session, const unsigned char *bytes, int length, WC_time now)
+{
+    int keys[WC_SERVER_INPUT];
+    int numKeys = WC_menu_term_keys(&session->terminal, bytes, length, keys);
+
+    /* every key's acted on, and one frame shows the lot */
+    if(numKeys)
+    {
+        WC_menu_step_keys(&session->state, keys, numKeys, now);
+        session->frameDue = 1;
+    }
+}
+
+/* hands a new session on fd to the next shard; 0 if out of memory */
+WC_INTERNAL int WC_server_hand_over(WC_server *server, int fd)
+{
+    WC_serverShard *shard = &server->shards[__atomic_fetch_add(&server->nextShard, 1, __ATOMIC_RELAXED) % server->numShards];
+    WC_serverSession *session = (WC_serverSession*)calloc(1, sizeof(WC_serverSession));
+    unsigned long long one = 1;
+
+    if(!session)
+        return 0;
+    session->server = server;
+    session->shard = shard;
+    session->fd = fd;
+    session->memoryCap = server->memoryCap;
+
+    pthread_mutex_lock(&shard->lock);
+    session->next = shard->incoming;
+    shard->incoming = session;
+    pthread_mutex_unlock(&shard->lock);
+    if(write(shard->wake, &one, sizeof(one)) < 0)
+    {
+        /* the counter's full, so the shard's waking up anyway */
+    }
+
+    return 1;
+}
+
+/* starts sessions handed to the shard */
+WC_INTERNAL void WC_server_take_incoming(WC_serverShard *shard)
+{
+    WC_serverSession *session, *next;
+
+    pthread_mutex_lock(&shard->lock);
+    session = shard->incoming;
+    shard->incoming = 0;
+    pthread_mutex_unlock(&shard->lock);
+
+    for(; session; session = next)
+    {
+        next = session->next;
+        if(!WC_server_start(session))
+        {
+            __atomic_fetch_add(&shard->server->numRefused, 1, __ATOMIC_RELAXED);
+            close(session->fd);
+            free(session);
+        }
+    }
+}
+
+/* sets up and begins a session's menu on its shard; 0 if it can't run */
+WC_INTERNAL int WC_server_start(WC_serverSession *session)
+{
+    WC_server *server = session->server;
+    WC_serverShard *shard = session->shard;
+    MenuItems *menuItems = &session->menuItems;
+    struct epoll_event event;
+    struct winsize size;
+    struct termios termios;
+
+    /* a pty is put in raw mode, so keys come as they're pressed, and knows its size */
+    WC_menuInit(menuItems);
+    menuItems->sy = server->sy;
+    menuItems->sx = server->sx;
+    if(isatty(session->fd))
+    {
+        if(!tcgetattr(session->fd, &termios))
+        {
+            cfmakeraw(&termios);
+            tcsetattr(session->fd, TCSANOW, &termios);
+        }
+        if(!ioctl(session->fd, TIOCGWINSZ, &size) && size.ws_row && size.ws_col)
+        {
+            menuItems->sy = size.ws_row;
+            menuItems->sx = size.ws_col;
+        }
+    }
+    fcntl(session->fd, F_SETFL, fcntl(session->fd, F_GETFL) | O_NONBLOCK);
+
+    /* everything the menu allocates counts against the session's cap */
+    menuItems->mallocFunction = WC_server_heap_alloc;
+    menuItems->reallocFunction = WC_server_heap_resize;
+    menuItems->freeFunction = WC_server_heap_free;
+    menuItems->allocContext = session;
+    menuItems->inputFunction = WC_server_no_input;
+    menuItems->drawContext = session;
+    menuItems->drawBatchFunction = WC_server_draw;
+    /* only the cells that changed go down the wire, and the first frame clears the screen */
+    menuItems->useBackBuffer = 1;
+    if(WC_menu_term_begin(&session->terminal, menuItems, -1))
+        return 0;
+
+    if(!server->sessionBegin || !server->sessionBegin(session))
+    {
+        WC_menu_term_end(&session->terminal);
+        return 0;
+    }
+    /* the program's settings for these would break the session */
+    menuItems->allocContext = session;
+    menuItems->drawContext = session;
+    menuItems->drawBatchFunction = WC_server_draw;
+    menuItems->useBackBuffer = 1;
+    if(WC_menu_begin(menuItems, &session->state))
+    {
+        WC_menu_end(&session->state);
+        WC_menu_term_end(&session->terminal);
+        WC_menu_cleanup(menuItems);
+        return 0;
+    }
+
+    event.events = EPOLLIN;
+    event.data.ptr = session;
+    if(epoll_ctl(shard->epoll, EPOLL_CTL_ADD, session->fd, &event))
+    {
+        WC_menu_end(&session->state);
+        WC_menu_term_end(&session->terminal);
+        WC_menu_cleanup(menuItems);
+        return 0;
+    }
+    session->next = shard->sessions;
+    session->prev = 0;
+    if(shard->sessions)
+        shard->sessions->prev = session;
+    shard->sessions = session;
+    shard->numSessions++;
+    __atomic_fetch_add(&server->numOpened, 1, __ATOMIC_RELAXED);
+
+    session->frameDue = 1;
+    WC_server_schedule(session);
+    if(!WC_server_frame(session))
+        WC_server_close(session);
+
+    return 1;
+}
+
+/* ends a session's menu, closes its terminal and frees it */
+WC_INTERNAL void WC_server_close(WC_serverSession *session)
+{
+    WC_serverShard *shard = session->shard;
+    static const char reset[] = "\x1b[0m\x1b[2J\x1b[H\x1b[?25h";
+
+    if(session->server->sessionEnd)
+        session->server->sessionEnd(session);
+
+    /* put the terminal back as it was, if it's still there to take it */
+    if(write(session->fd, reset, sizeof(reset) - 1) < 0)
+    {
+    }
+    epoll_ctl(shard->epoll, EPOLL_CTL_DEL, session->fd, NULL);
+    close(session->fd);
+
+    WC_menu_end(&session->state);
+    WC_menu_term_end(&session->terminal);
+    WC_menu_cleanup(&session->menuItems);
+
+    if(session->prev)
+        session->prev->next = session->next;
+    else
+        shard->sessions = session->next;
+    if(session->next)
+        session->next->prev = session->prev;
+    shard->numSessions--;
+    __atomic_fetch_add(&session->server->numClosed, 1, __ATOMIC_RELAXED);
+    free(session);
+}
+
+/* accepts every connection waiting on the listening socket */
+WC_INTERNAL void WC_server_accept(WC_server *server)
+{
+    int fd;
+
+    while((fd = accept(server->listenFd, NULL, NULL)) >= 0)
+    {
+        if(!WC_server_hand_over(server, fd))
+            close(fd);
+    }
+}
+
+/* a shard's loop: terminals, timers and frames until the server stops */
+WC_INTERNAL void *WC_server_shard_loop(void *arg)
+{
+    WC_serverShard *shard = (WC_serverShard*)arg;
+    WC_server *server = shard->server;
+    struct epoll_event events[WC_SERVER_EVENTS];
+    while(!server->quit)
+    {
+        WC_serverSession *session, *next;
+        WC_time now = WC_menu_now();
+        int i, numEvents, timeout = -1;
+
+        /* sleep until a terminal has something or the soonest menu needs stepping */
+        if(WC_WAIT_FOREVER != shard->deadline)
+            timeout = (int)((WC_menu_max(0, shard->deadline - now) + 999999) / 1000000);
+        numEvents = epoll_wait(shard->epoll, events, WC_SERVER_EVENTS, timeout);
+        now = WC_menu_now();
+
+        for(i=0; i<numEvents; i++)
+        {
+            void *ptr = events[i].data.ptr;
+
+            if(ptr == shard)
+            {
+                unsigned long long count;
+
+                if(read(shard->wake, &count, sizeof(count)) < 0)
+                {
+                }
+                WC_server_take_incoming(shard);
+                continue;
+            }
+            if(ptr == &server->listenFd)
+            {
+                WC_server_accept(server);
+                continue;
+            }
+
+            session = (WC_serverSession*)ptr;
+            if(events[i].events & EPOLLOUT)
+            {
+                if(!WC_server_flush(session))
+                {
+                    WC_server_close(session);
+                    continue;
+                }
+            }
+            if(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+            {
+                unsigned char bytes[WC_SERVER_INPUT];
+                ssize_t length;
+
+                /* everything waiting is acted on before the frame is drawn */
+                while((length = read(session->fd, bytes, sizeof(bytes))) > 0)
+                    WC_server_keys(session, bytes, (int)length, now);
+                /* the other end's gone (a pty reads EIO once it's closed) */
+                if(!length || (length < 0 && EAGAIN != errno && EWOULDBLOCK != errno && EINTR != errno))
+                {
+                    WC_server_close(session);
+                    continue;
+                }
+            }
+            if(WC_MENU_PENDING != session->state.result)
+            {
+                WC_server_flush(session);
+                WC_server_close(session);
+                continue;
+            }
+            if(!WC_server_frame(session))
+            {
+                WC_server_close(session);
+                continue;
+            }
+            WC_server_schedule(session);
+        }
+
+        /* menus whose footer or long item scrolls, or whose queue or callbacks need looking at */
+        if(WC_WAIT_FOREVER == shard->deadline || shard->deadline > now)
+            continue;
+        shard->deadline = WC_WAIT_FOREVER;
+        for(session = shard->sessions; session; session = next)
+        {
+            next = session->next;
+            if(WC_WAIT_FOREVER == session->deadline)
+                continue;
+            if(session->deadline <= now)
+            {
+                WC_menu_step(&session->state, 0, now);
+                session->frameDue = 1;
+                if(WC_MENU_PENDING != session->state.result || !WC_server_frame(session))
+                {
+                    WC_server_close(session);
+                    continue;
+                }
+            }
+            WC_server_schedule(session);
+        }
+    }
+
+    return 0;
+}
+
+/* sets up a server running sessions on numShards threads */
+WC_GLOBAL int WC_server_init(WC_server *server, int numShards)
+{
+    int i;
+
+    memset(server, 0, sizeof(WC_server));
+    server->listenFd = -1;
+    server->sy = 24;
+    server->sx = 80;
+    server->memoryCap = WC_SERVER_MEMORY;
+    server->numShards = WC_menu_max(1, WC_menu_min(numShards, WC_SERVER_SHARDS_MAX));
+
+    for(i=0; i<server->numShards; i++)
+    {
+        WC_serverShard *shard = &server->shards[i];
+        struct epoll_event event;
+
+        shard->server = server;
+        shard->epoll = epoll_create1(EPOLL_CLOEXEC);
+        shard->wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        pthread_mutex_init(&shard->lock, NULL);
+        if(shard->epoll < 0 || shard->wake < 0)
+        {
+            server->numShards = i + 1;
+            WC_server_free(server);
+            return 0;
+        }
+        event.events = EPOLLIN;
+        event.data.ptr = shard;
+        epoll_ctl(shard->epoll, EPOLL_CTL_ADD, shard->wake, &event);
+    }
+
+    return 1;
+}
+
+/* listens for sessions on a Unix socket at path */
+WC_GLOBAL int WC_server_listen(WC_server *server, const char *path)
+{
+    struct sockaddr_un address;
+    struct epoll_event event;
+    int fd;
+
+    if(strlen(path) >= sizeof(address.sun_path))
+        return 0;
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd < 0)
+        return 0;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    unlink(path);
+    if(bind(fd, (struct sockaddr*)&address, sizeof(address)) || listen(fd, SOMAXCONN))
+    {
+        close(fd);
+        return 0;
+    }
+
+    /* the first shard accepts, and hands sessions round the rest */
+    server->listenFd = fd;
+    event.events = EPOLLIN;
+    event.data.ptr = &server->listenFd;
+    epoll_ctl(server->shards[0].epoll, EPOLL_CTL_ADD, fd, &event);
+
+    return 1;
+}
+
+/* adds a session on terminal fd */
+WC_GLOBAL int WC_server_add(WC_server *server, int fd)
+{
+    return WC_server_hand_over(server, fd);
+}
+
+/* runs the shards until WC_server_stop */
+WC_GLOBAL void WC_server_run(WC_server *server)
+{
+    int i;
+
+    for(i=1; i<server->numShards; i++)
+        pthread_create(&server->shards[i].thread, NULL, WC_server_shard_loop, &server->shards[i]);
+    WC_server_shard_loop(&server->shards[0]);
+    for(i=1; i<server->numShards; i++)
+        pthread_join(server->shards[i].thread, NULL);
+}
+
+/* makes WC_server_run return */
+WC_GLOBAL void WC_server_stop(WC_server *server)
+{
+    unsigned long long one = 1;
+    int i;
+
+    server->quit = 1;
+    for(i=0; i<server->numShards; i++)
+    {
+        if(write(server->shards[i].wake, &one, sizeof(one)) < 0)
+        {
+        }
+    }
+}
+
+/* ends every session and frees what the server has */
+WC_GLOBAL void WC_server_free(WC_server *server)
+{
+    int i;
+
+    for(i=0; i<server->numShards; i++)
+    {
+        WC_serverShard *shard = &server->shards[i];
+        WC_serverSession *session;
+
+        /* sessions never started just have their terminal closed */
+        while((session = shard->incoming))
+        {
+            shard->incoming = session->next;
+            close(session->fd);
+            free(session);
+        }
+        while(shard->sessions)
+            WC_server_close(shard->sessions);
+        if(shard->epoll >= 0)
+            close(shard->epoll);
+        if(shard->wake >= 0)
+            close(shard->wake);
+        pthread_mutex_destroy(&shard->lock);
+    }
+    if(server->listenFd >= 0)
+        close(server->listenFd);
+    server->listenFd = -1;
+    server->numShards = 0;
+}
+
+#endif /* WCSERVER_H_ */
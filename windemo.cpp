@@ -2,6 +2,7 @@
     windemo.cpp uses wcmenu.h to implement a menu for Windows GUI
     by Stefan Wessels, February 2017.
 */
+#define WC_MENU_STATS
 #include "wcmenu.h"
 #include <stdio.h>
 
@@ -31,6 +32,7 @@ public:
 	unsigned int nRawKeyState;
 	HFONT		hFont;
 	int 		fontWidth;
+	MenuItems*	pMenuItems;
 
 private:
 
@@ -45,7 +47,8 @@ public:
 		szMainMenu(NULL),
 		szWindowName(NULL),
 		lpfnWndProc(NULL),
-		nExitCode(0)
+		nExitCode(0),
+		pMenuItems(NULL)
 		{;}
 
 	~WinApp() {;}
@@ -91,6 +94,22 @@ LRESULT CALLBACK MainWndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 				case VK_DOWN:
 					theApp.nRawKeyState |= WC_INPUT_KEY_DOWN;
 				break;
+
+				case VK_PRIOR:
+					theApp.nRawKeyState |= WC_INPUT_KEY_PAGE_UP;
+				break;
+
+				case VK_NEXT:
+					theApp.nRawKeyState |= WC_INPUT_KEY_PAGE_DOWN;
+				break;
+
+				case VK_HOME:
+					theApp.nRawKeyState |= WC_INPUT_KEY_HOME;
+				break;
+
+				case VK_END:
+					theApp.nRawKeyState |= WC_INPUT_KEY_END;
+				break;
 			}
 			break;
 
@@ -112,6 +131,22 @@ LRESULT CALLBACK MainWndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 				case VK_DOWN:
 					theApp.nRawKeyState &= ~WC_INPUT_KEY_DOWN;
 				break;
+
+				case VK_PRIOR:
+					theApp.nRawKeyState &= ~WC_INPUT_KEY_PAGE_UP;
+				break;
+
+				case VK_NEXT:
+					theApp.nRawKeyState &= ~WC_INPUT_KEY_PAGE_DOWN;
+				break;
+
+				case VK_HOME:
+					theApp.nRawKeyState &= ~WC_INPUT_KEY_HOME;
+				break;
+
+				case VK_END:
+					theApp.nRawKeyState &= ~WC_INPUT_KEY_END;
+				break;
 			}
 			break;
 
@@ -232,6 +267,7 @@ COLORREF COLOR_BLUE		= RGB(0x00, 0x00, 0xff);
 COLORREF COLOR_YELLOW	= RGB(0xff, 0xff, 0x00);
 COLORREF COLOR_CYAN		= RGB(0x00, 0xff, 0xff);
 COLORREF COLOR_WHITE	= RGB(0xff, 0xff, 0xff);
+COLORREF COLOR_BLACK	= RGB(0x00, 0x00, 0x00);
 
 struct
 {
@@ -245,6 +281,7 @@ struct
         { COLOR_WHITE, 	COLOR_BLUE },
         { COLOR_WHITE, 	COLOR_GREEN },
         { COLOR_CYAN, 	COLOR_BLUE },
+        { COLOR_BLACK, 	COLOR_YELLOW },
 };
 
 /* app specific user structure pointed to by userData_ptr */
@@ -278,43 +315,35 @@ WC_GLOBAL char *makeString(char *format, ... )
 /* toggle a menu item between 1 (on) and 0 (off) and turn on/off other menu option based on the toggle */
 WC_GLOBAL int change(MenuItems *menuItems, int selectedItem)
 {
-    int i, value = 1 - atoi(menuItems->items[selectedItem]);
+    int value = 1 - atoi(menuItems->items[selectedItem]);
+    char buffer[16];
 
-    /* if you know the menu will be changed, it's easier to "clone" the memory */
-    /* before calling menu, otherwise this needs to be in every callback */
-    if(!menuItems->selfOwnsMemory)
-        WC_menu_take_ownership(menuItems);
-
-    free(menuItems->items[selectedItem]);
-    menuItems->items[selectedItem] = makeString("%ld", value);
-    for(i=selectedItem+1; i<selectedItem+3; i++)
-        menuItems->states[i] = value ? WC_ENABLED : WC_DISABLED;
+    /* these copy just what they change, so the menu's text and arrays stay the app's */
+    sprintf(buffer, "%d", value);
+    WC_menu_set_item(menuItems, selectedItem, buffer);
+    WC_menu_set_states(menuItems, selectedItem+1, selectedItem+2, value ? WC_ENABLED : WC_DISABLED);
     return WC_INPUT_KEY_DOWN;
 }
 
 /* update a variable stored in the menuItens class based on selecting the option */
 WC_GLOBAL int increment(MenuItems *menuItems, int selectedItem)
 {
-    if(!menuItems->selfOwnsMemory)
-        WC_menu_take_ownership(menuItems);
+    char buffer[32];
 
-    free(menuItems->items[selectedItem]);
-    menuItems->items[selectedItem] = makeString("Value: %d", ++((UserData*)menuItems->userData_ptr)->value);
+    sprintf(buffer, "Value: %d", ++((UserData*)menuItems->userData_ptr)->value);
+    WC_menu_set_item(menuItems, selectedItem, buffer);
     return 0;
 }
 
 /* add more options to the menu */
 WC_GLOBAL int append(MenuItems *menuItems, int selectedItem)
 {
-    int length;
-
-    if(!menuItems->selfOwnsMemory)
-        WC_menu_take_ownership(menuItems);
+    int length = WC_menu_len(menuItems->items);
+    char buffer[32];
 
-    length = WC_menu_len(menuItems->items);
-    menuItems->items = (char**)realloc(menuItems->items,(length+2)*sizeof(char*));
-    menuItems->items[length] = makeString("New Item %d",length);
-    menuItems->items[length+1] = 0;
+    /* copies the text, and keeps the states and callbacks in step */
+    sprintf(buffer, "New Item %d", length);
+    WC_menu_insert_item(menuItems, length, buffer, WC_ENABLED, WC_NO_CALLBACK);
 
     return 0;
 }
@@ -324,15 +353,8 @@ WC_GLOBAL int remove(MenuItems *menuItems, int selectedItem)
 {
     int length = WC_menu_len(menuItems->items);
 
-    if(!menuItems->selfOwnsMemory)
-        WC_menu_take_ownership(menuItems);
-
     if(length > ((UserData*)menuItems->userData_ptr)->length)
-    {
-        free(menuItems->items[length-1]);
-        menuItems->items = (char**)realloc(menuItems->items,length*sizeof(char*));
-        menuItems->items[length-1] = 0;
-    }
+        WC_menu_remove_item(menuItems, length-1);
     return 0;
 }
 
@@ -387,28 +409,15 @@ WC_GLOBAL void demo_draw(int y, int x, char *string, int length, int color)
 /* 
  * force a windows redraw/update.  this is needed to keep the message
  * pump working, otherwise the whole menu system stalls out.  I could
- * fix this with a peekmessage, which I should do in future.
+ * fix this with a peekmessage, which I should do in future.  It also
+ * shows the frames drawn so far and what one takes, from the menu's stats.
  */
 WC_GLOBAL void demo_show(void)
 {
-	static unsigned long count = 0;
-	static unsigned long second = 0;
-	static unsigned long fps = 0;
-	static struct timespec oldTime = {0,0};
-	struct timespec nowTime;
-
-	clock_gettime(CLOCK_MONOTONIC, &nowTime);
-	unsigned long elapsed = WC_menu_elapsedTime(oldTime, nowTime);
-	oldTime = nowTime;
-	second += elapsed;
-	if(second > WC_BILLION)
-	{
-		fps = count;
-		second = 0;
-		count = 0;
-	}
+	WC_menuStats stats;
 
-	char *str = makeString("%05ld %05ld", count++, fps);
+	WC_menu_get_stats(theApp.pMenuItems, &stats);
+	char *str = makeString("%05ld frames %7.1fus", stats.frames, stats.frames ? stats.renderTime / 1e3 / stats.frames : 0.0);
 	HDC hDC = GetDC(theApp.hWnd);
 	TextOut(hDC, 1 * theApp.fontWidth, 1 * theApp.fontWidth, str, strlen(str));
 	ReleaseDC(theApp.hWnd, hDC);
@@ -419,6 +428,7 @@ WC_GLOBAL void demo_show(void)
 void WinApp::Run(void)
 {
     MenuItems menuItems;
+    WC_menuIntern labels;
     UserData userData;
     RECT rect;
     const int colsPerScreen = 80;
@@ -464,7 +474,7 @@ void WinApp::Run(void)
 
     /* these are all optional */
     /* comment out anything here to see how it affects the menu */
-	/* menuItems.showFunction = demo_show; // Add this for rough FPS */ 
+	/* menuItems.showFunction = demo_show; // Add this for a frame count and time */ 
 
     /*menuItems.y=2; */
     menuItems.x=2;
@@ -477,6 +487,9 @@ void WinApp::Run(void)
     menuItems.footer_height=0;
     menuItems.callbacks = callbacks;
     menuItems.userData_ptr = (void*)&userData;
+    /* share the text callbacks set, so toggling "1"/"0" allocates nothing after the 1st time */
+    WC_menu_intern_init(&labels);
+    menuItems.intern = &labels;
 
     /* add the tunable variable to the class */
     userData.value = 10;
@@ -489,10 +502,13 @@ void WinApp::Run(void)
    InvalidateRect(theApp.hWnd, NULL, true);
 
     /* show and run the menu */
+    theApp.pMenuItems = &menuItems;
     item = WC_menu(&menuItems);
+    theApp.pMenuItems = NULL;
 
     /* clean up the self-owned memory if needed */
     WC_menu_cleanup(&menuItems);
+    WC_menu_intern_free(&labels);
 
     /* clean up the font */
 	DeleteObject(theApp.hFont);